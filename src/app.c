@@ -0,0 +1,652 @@
+// The setup screen: UI state, input handling and the per-frame update. The
+// console's video mode, network and controller setup stay in main.c, so the
+// host replay (src/host/replay.c) drives exactly this code.
+#include "app.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "detect.h"
+#include "send_cmd.h"
+#include "cmd_queue.h"
+#include "damage.h"
+#include "telemetry.h"
+#include "profiler.h"
+#include "upload.h"
+#include "devstate.h"
+#include "devconfig.h"
+#include "memstat.h"
+#include "audio_stream.h"
+#include "session.h"
+
+#define IDLE_WAIT_MS      1000        // Longest sleep when nothing is dirty; discovery changes wake us sooner
+#define STATUS_SHOW_MS    2500        // How long a command result stays on screen
+#define DIAG_REFRESH_MS   500         // Diagnostics page update rate
+#define HUD_REFRESH_MS    500         // Profiler HUD update rate
+#define UPLOAD_REFRESH_MS 250         // Upload progress update rate
+
+static ui_state_t ui = { .selected_idx = -1, .dev_display = DEVSTATE_UNKNOWN, .dev_mode = -1, .dev_image = -1 };
+static Uint32 status_until = 0;       // 0 = keep until replaced
+static Uint32 diag_next = 0;          // Next diagnostics refresh while the page is open
+static Uint32 hud_next = 0;           // Next profiler HUD refresh while it is shown
+static Uint32 upload_next = 0;        // Next progress line while an upload runs
+static uint32_t clock_ms = 0;         // Caller's clock as of the latest call
+static app_config_t config;
+static bool running = true;
+static SDL_Renderer* renderer = NULL;
+static ui_state_t drawn;              // As on screen
+static bool drawn_valid = false;
+static const detect_snapshot_t* units = NULL;
+static uint32_t state_gen = 0;
+static uint32_t state_ip = 0;
+static int group_wanted = 0;          // Units the latest group command was for; only CMD_GROUP_MAX go out
+static int upload_wanted = 0;         // Units found for the latest upload; only UPLOAD_UNITS_MAX get it
+
+// Rebuild device bar state from the discovery snapshot. When several units
+// share an ID the bar shows the one with the lowest IP.
+static void update_devices(const detect_snapshot_t* units) {
+    memset(ui.device_present, 0, sizeof(ui.device_present));
+    memset(ui.device_ip, 0, sizeof(ui.device_ip));
+
+    for (int id = 1; id <= DEVICE_MAX + 1; ++id) {   // 1-4 plus XL (ID 5) in slot 4
+        int count;
+        const type_d_unit_t* u = detect_snapshot_by_id(units, (uint8_t)id, &count);
+        if (count == 0) continue;
+        ui.device_present[id-1] = 1;
+        ui.device_ip[id-1] = u->ip;
+    }
+    // Track if XL (ID 5) and EXP (ID 6) are present
+    int count;
+    ui.xl_found = ui.device_present[4] != 0;
+    detect_snapshot_by_id(units, 6, &count);
+    ui.exp_found = count > 0;
+
+    // Auto-select first detected device if none selected (now up to 5 slots)
+    if (ui.selected_idx == -1) {
+        for (int i = 0; i < DEVICE_BAR_SLOTS; i++) {
+            if (ui.device_present[i]) {
+                ui.selected_idx = i;
+                break;
+            }
+        }
+    }
+
+    // Sticky selected_idx safeguard
+    static int last_valid_selected_idx = -1;
+    if (ui.selected_idx >= 0 && ui.selected_idx < DEVICE_BAR_SLOTS && ui.device_present[ui.selected_idx]) {
+        last_valid_selected_idx = ui.selected_idx;
+    } else {
+        if (last_valid_selected_idx >= 0 && ui.device_present[last_valid_selected_idx]) {
+            ui.selected_idx = last_valid_selected_idx;
+        } else {
+            ui.selected_idx = -1;
+            last_valid_selected_idx = -1;
+        }
+    }
+}
+
+// Unit the A button talks to: the selected one, else the first discovered
+static uint32_t target_unit(const detect_snapshot_t* units) {
+    if (ui.selected_idx >= 0 && ui.device_present[ui.selected_idx])
+        return ui.device_ip[ui.selected_idx];
+    int n;
+    const type_d_unit_t* list = detect_snapshot_units(units, &n);
+    return n > 0 ? list[0].ip : 0;
+}
+
+// Device state is not in a session trace, and whatever the replaying host
+// has cached would make two replays draw differently: a replay has none
+static bool unit_state(uint32_t ip, devstate_t* s) {
+    if (!config.replay) return devstate_get(ip, s);
+    memset(s, 0, sizeof(*s));
+    return false;
+}
+
+static bool redundant(uint32_t ip, const char* cmd) {
+    return !config.replay && devstate_redundant(ip, cmd);
+}
+
+// Live state of the target unit for the device bar and menu
+static void update_device_state(uint32_t ip) {
+    devstate_t s;
+    unit_state(ip, &s);
+    ui.dev_display = s.known ? s.display : DEVSTATE_UNKNOWN;
+    ui.dev_mode = s.known ? s.mode : -1;
+    ui.dev_image = s.known ? s.image : -1;
+}
+
+// Worst unit first: discovery loss, then failed commands, then slow HTTP
+static int diag_row_cmp(const void* a, const void* b) {
+    const telemetry_report_t* x = &((const ui_diag_row_t*)a)->t;
+    const telemetry_report_t* y = &((const ui_diag_row_t*)b)->t;
+    uint32_t lx = telemetry_loss_permille(x), ly = telemetry_loss_permille(y);
+    if (lx != ly) return lx < ly ? 1 : -1;
+    if (x->command_failures != y->command_failures) return x->command_failures < y->command_failures ? 1 : -1;
+    uint32_t hx = x->metric[TELEM_HTTP_RTT].p95_us, hy = y->metric[TELEM_HTTP_RTT].p95_us;
+    if (hx != hy) return hx < hy ? 1 : -1;
+    return (x->ip > y->ip) - (x->ip < y->ip);
+}
+
+// Every tracked unit is ranked; ui_set_diagnostics() keeps the worst, so the
+// rows are frame scratch
+static void refresh_diagnostics(const detect_snapshot_t* units) {
+    ui_diag_row_t* rows = (ui_diag_row_t*)mem_frame_alloc(sizeof(ui_diag_row_t) * TELEMETRY_UNITS);
+    if (!rows) return;   // Tried again on the next refresh
+    int n, count = 0;
+    const type_d_unit_t* list = detect_snapshot_units(units, &n);
+    for (int i = 0; i < n && count < TELEMETRY_UNITS; ++i) {
+        if (telemetry_get(list[i].ip, &rows[count].t)) {
+            rows[count].id = list[i].id;
+            rows[count].firmware = list[i].info.firmware;
+            count++;
+        }
+    }
+    qsort(rows, count, sizeof(rows[0]), diag_row_cmp);
+    telemetry_report_t all;
+    telemetry_get_all(&all);
+    // The host's heap, the malloc probe and its audio device say nothing
+    // about the console
+    mem_report_t mem;
+    audio_stats_t audio;
+    if (config.replay) {
+        memset(&mem, 0, sizeof(mem));
+        memset(&audio, 0, sizeof(audio));
+    } else {
+        mem_report(&mem, true);
+        audio_stream_stats(&audio);
+    }
+    ui_set_diagnostics(rows, count, n, &all, &mem, &audio);
+    ui.diag_serial++;
+}
+
+static void refresh_hud(void) {
+    // Host timings would differ from run to run; the replay measures its own
+    profiler_summary_t summary;
+    if (config.replay)
+        memset(&summary, 0, sizeof(summary));
+    else
+        profiler_summarize(&summary);
+    ui_set_profile(&summary);
+    ui.hud_serial++;
+}
+
+static void set_status(int kind, Uint32 show_ms, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(ui.status, sizeof(ui.status), fmt, ap);
+    va_end(ap);
+    ui.status_kind = kind;
+    status_until = show_ms ? clock_ms + show_ms : 0;
+}
+
+// " of N" when the latest upload left units out, else empty
+static const char* upload_of(int sent) {
+    static char of[16];
+    of[0] = 0;
+    if (upload_wanted > sent)
+        snprintf(of, sizeof(of), " of %d", upload_wanted);
+    return of;
+}
+
+// Every file the platform lists to every detected unit (up to UPLOAD_UNITS_MAX)
+static void start_upload(const detect_snapshot_t* units) {
+    static char names[UPLOAD_FILES_MAX][UPLOAD_PATH_MAX];
+    const char* paths[UPLOAD_FILES_MAX];
+    int file_count = config.list_uploads ? config.list_uploads(names, UPLOAD_FILES_MAX) : 0;
+    for (int i = 0; i < file_count; ++i)
+        paths[i] = names[i];
+
+    int n;
+    const type_d_unit_t* list = detect_snapshot_units(units, &n);
+    uint32_t ips[UPLOAD_UNITS_MAX];
+    int unit_count = 0;
+    for (int i = 0; i < n && unit_count < UPLOAD_UNITS_MAX; ++i)
+        ips[unit_count++] = list[i].ip;
+
+    if (file_count == 0)
+        set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "Upload: no files in media\\upload");
+    else if (unit_count == 0)
+        set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "Upload: no units found");
+    else if (!upload_start(ips, unit_count, paths, file_count))
+        set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "Upload: busy or unreadable");
+    else {
+        upload_wanted = n;
+        set_status(UI_STATUS_PENDING, 0, "Upload: %d files to %d%s units...",
+                   file_count, unit_count, upload_of(unit_count));
+        upload_next = clock_ms + UPLOAD_REFRESH_MS;
+    }
+}
+
+static int profile_waiting(const devconfig_status_t* st) {
+    int waiting = 0;
+    for (int i = 0; i < st->count; ++i)
+        if (st->units[i].state == DEVCONFIG_WAITING) waiting++;
+    return waiting;
+}
+
+// Outcome of a profile sync, once no unit is syncing any more. Units not on
+// the network yet are synced when they turn up, so they are not a failure.
+static void show_profile_result(void) {
+    devconfig_status_t st;
+    devconfig_status(&st);
+    if (st.active) return;
+    int waiting = profile_waiting(&st);
+    if (waiting > 0)
+        set_status(UI_STATUS_PENDING, STATUS_SHOW_MS, "Profile: %d/%d units set, waiting for %d",
+                   st.done, st.count, waiting);
+    else
+        set_status(st.done == st.count ? UI_STATUS_OK : UI_STATUS_FAIL, STATUS_SHOW_MS,
+                   "Profile: %d/%d units set, %d commands", st.done, st.count, st.commands);
+}
+
+static void show_upload_progress(void) {
+    upload_status_t st;
+    upload_status(&st);
+    uint64_t acked = 0;
+    for (int i = 0; i < st.unit_count; ++i) acked += st.units[i].bytes_acked;
+    uint64_t all = st.bytes_total * (uint64_t)st.unit_count;
+    unsigned pct = all ? (unsigned)(acked * 100 / all) : 0;
+    unsigned kbps = st.elapsed_ms ? (unsigned)(acked * 1000 / 1024 / st.elapsed_ms) : 0;
+    if (st.active) {
+        set_status(UI_STATUS_PENDING, 0, "Upload %u%%  %u KB/s", pct, kbps);
+        return;
+    }
+    int ok = 0;
+    for (int i = 0; i < st.unit_count; ++i)
+        if (st.units[i].state == UPLOAD_DONE) ok++;
+    set_status(ok == st.unit_count ? UI_STATUS_OK : UI_STATUS_FAIL, STATUS_SHOW_MS,
+               "Upload: %d/%d%s units OK, %d files, %u KB/s",
+               ok, st.unit_count, upload_of(st.unit_count), st.file_count, kbps);
+}
+
+// When an input event happened, on the telemetry_now_us() clock. SDL stamps
+// events in milliseconds as they are queued; a press waiting in the queue
+// counts against the latency.
+static uint64_t event_time_us(const SDL_Event* e) {
+    uint64_t now = telemetry_now_us();
+    uint64_t age_us = (uint64_t)(Uint32)(SDL_GetTicks() - e->common.timestamp) * 1000;
+    return age_us < now ? now - age_us : now;
+}
+
+// Press to acknowledgement when the command came from input, else queue to completion
+static unsigned result_ms(uint32_t ack_us, uint32_t elapsed_ms) {
+    return ack_us ? (unsigned)((ack_us + 500) / 1000) : (unsigned)elapsed_ms;
+}
+
+static const char* unit_label(uint8_t id) {
+    static const char* labels[] = {"?", "1", "2", "3", "4", "XL", "EXP"};
+    return id < sizeof(labels)/sizeof(labels[0]) ? labels[id] : "?";
+}
+
+// Group summary: success count, the units that failed and the slowest reply
+static void handle_group_result(const cmd_result_t* res, const char* name,
+                                const detect_snapshot_t* units) {
+    char of[16] = "";
+    if (group_wanted > res->unit_count)
+        snprintf(of, sizeof(of), " of %d", group_wanted);
+    if (res->ok) {
+        set_status(UI_STATUS_OK, STATUS_SHOW_MS, "%s x%d%s: OK (%u ms)",
+                   name, res->unit_count, of, result_ms(res->ack_us, res->elapsed_ms));
+        return;
+    }
+    char failed[24] = "";
+    size_t len = 0;
+    for (int i = 0; i < res->unit_count && len < sizeof(failed) - 1; ++i) {
+        if (res->units[i].ok) continue;
+        const type_d_unit_t* u = detect_snapshot_find(units, res->units[i].ip);
+        len += snprintf(failed + len, sizeof(failed) - len, "%s%s", len ? "," : "", unit_label(u ? u->id : 0));
+    }
+    set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "%s: %d/%d%s OK, failed %s",
+               name, res->ok_count, res->unit_count, of, failed);
+}
+
+static void handle_cmd_result(const cmd_result_t* res, const detect_snapshot_t* units) {
+    const char* name = (res->tag >= 0 && res->tag < MENU_ITEM_COUNT) ? menu_items[res->tag] : res->cmd;
+    if (res->unit_count > 0) {
+        for (int i = 0; i < res->unit_count; ++i)
+            devstate_note_command(res->units[i].ip, res->cmd, res->units[i].ok);
+    } else {
+        devstate_note_command(res->ip, res->cmd, res->ok);
+    }
+    if (res->unit_count > 0)
+        handle_group_result(res, name, units);
+    else if (res->ok)
+        set_status(UI_STATUS_OK, STATUS_SHOW_MS, "%s: OK (%u ms)", name, result_ms(res->ack_us, res->elapsed_ms));
+    else
+        set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "%s: %s", name, res->timed_out ? "timed out" : "failed");
+}
+
+// Commands are queued for the workers; in a replay their outcome is already
+// in the trace and arrives through cmd_queue_post()
+static bool submit(uint32_t ip, const char* cmd, int tag, const SDL_Event* event) {
+    return config.replay || cmd_queue_submit(ip, cmd, NULL, SEND_CMD_TIMEOUT_MS, tag, event_time_us(event));
+}
+
+static bool submit_group(const uint32_t* ips, int count, const char* cmd, int tag, const SDL_Event* event) {
+    return config.replay ||
+           cmd_queue_submit_group(ips, count, cmd, NULL, SEND_CMD_TIMEOUT_MS, tag, event_time_us(event));
+}
+
+void app_handle_event(const SDL_Event* event, uint32_t now) {
+    clock_ms = now;
+    int n;
+    const type_d_unit_t* detected = detect_snapshot_units(units, &n);
+    const cmd_result_t* res = cmd_queue_result(event);
+    if (res) {
+        session_record_result(now, res);
+        handle_cmd_result(res, units);
+        cmd_queue_release(event);
+        return;
+    }
+    if (event->type == upload_event_type()) {
+        show_upload_progress();
+        return;
+    }
+    if (event->type == devconfig_event_type()) {
+        show_profile_result();
+        return;
+    }
+
+    if (event->type == SDL_QUIT) running = false;
+    if (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_ESCAPE)
+        running = false;
+
+    if (event->type == SDL_CONTROLLERBUTTONDOWN) {
+        session_record_button(now, event->cbutton.button);
+        if (event->cbutton.button == SDL_CONTROLLER_BUTTON_B) {
+            if (ui.about_visible) {
+                ui.about_visible = false;
+            } else if (ui.diag_visible) {
+                ui.diag_visible = false;
+            } else {
+                running = false;
+            }
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_BACK) {
+            // Toggle About overlay on SELECT (BACK) button press
+            ui.about_visible = !ui.about_visible;
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_START) {
+            // Frame profiler HUD, drawn over every page
+            ui.hud_visible = !ui.hud_visible;
+            if (ui.hud_visible) refresh_hud();
+            hud_next = now + HUD_REFRESH_MS;
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_RIGHTSHOULDER && ui.hud_visible &&
+                   !config.replay) {
+            // Black button: write the ring as a Chrome trace and the session
+            // so far for the host replay
+            int n = profiler_dump(PROFILER_DUMP_PATH);
+            int records = session_save(SESSION_PATH);
+            if (n >= 0 && records >= 0)
+                set_status(UI_STATUS_OK, STATUS_SHOW_MS, "Trace: %d events, session %d records", n, records);
+            else
+                set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "Trace: write failed");
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_LEFTSHOULDER && !ui.about_visible) {
+            // White button: push media\upload to the units, or stop a push in progress
+            upload_status_t st;
+            upload_status(&st);
+            if (st.active) {
+                upload_cancel(false);
+                set_status(UI_STATUS_PENDING, 0, "Upload: stopping...");
+            } else {
+                start_upload(units);
+            }
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_RIGHTSTICK && !ui.about_visible) {
+            // Right stick click: make every unit's current settings the rig profile
+            int saved = devconfig_capture();
+            if (saved > 0)
+                set_status(UI_STATUS_OK, STATUS_SHOW_MS, "Profile: saved %d units", saved);
+            else
+                set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, saved < 0 ? "Profile: write failed" : "Profile: no unit state yet");
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_LEFTSTICK && !ui.about_visible) {
+            // Left stick click: bring every unit back to the profile
+            // The result comes with devconfig_event_type() once the present
+            // units are done; with none present no sync runs to send it
+            if (!devconfig_restore()) {
+                set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "Profile: none saved");
+            } else {
+                devconfig_status_t st;
+                devconfig_status(&st);
+                int waiting = profile_waiting(&st);
+                if (waiting == st.count)
+                    set_status(UI_STATUS_PENDING, STATUS_SHOW_MS, "Profile: waiting for %d units", waiting);
+                else
+                    set_status(UI_STATUS_PENDING, 0, "Profile: syncing...");
+            }
+        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_Y && !ui.about_visible) {
+            // Latency and loss per unit; filled in by the main loop
+            ui.diag_visible = !ui.diag_visible;
+            if (ui.diag_visible) refresh_diagnostics(units);
+            diag_next = now + DIAG_REFRESH_MS;
+        } else if (!ui.about_visible && !ui.diag_visible) {
+            // Only allow normal navigation when About overlay is NOT visible
+            if (ui.focus_row == 0) {
+                // Menu navigation
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_A) {
+                    if (menu_cmds[ui.menu_selected]) {
+                        uint32_t target_ip = target_unit(units);
+                        const char* name = menu_items[ui.menu_selected];
+                        // Nothing to send when the unit already shows what was asked for
+                        if (target_ip && redundant(target_ip, menu_cmds[ui.menu_selected])) {
+                            set_status(UI_STATUS_OK, STATUS_SHOW_MS, "%s: already set", name);
+                        } else if (target_ip) {
+                            // Queued for the worker; the result arrives as an event
+                            if (submit(target_ip, menu_cmds[ui.menu_selected], ui.menu_selected, event))
+                                set_status(UI_STATUS_PENDING, 0, "%s...", name);
+                            else
+                                set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "%s: busy", name);
+                        }
+                    }
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_X) {
+                    // Same command to every detected unit, in parallel. One
+                    // group holds CMD_GROUP_MAX units (the lowest IDs); the
+                    // status line says when that is not all of them.
+                    if (menu_cmds[ui.menu_selected] && n > 0) {
+                        const char* cmd = menu_cmds[ui.menu_selected];
+                        uint32_t ips[CMD_GROUP_MAX];
+                        int count = 0, wanted = 0, skipped = 0;
+                        for (int i = 0; i < n; ++i) {
+                            if (redundant(detected[i].ip, cmd)) {
+                                skipped++;
+                                continue;
+                            }
+                            if (count < CMD_GROUP_MAX) ips[count++] = detected[i].ip;
+                            wanted++;
+                        }
+                        const char* name = menu_items[ui.menu_selected];
+                        char of[16] = "";
+                        if (wanted > count)
+                            snprintf(of, sizeof(of), " of %d", wanted);
+                        if (count == 0) {
+                            set_status(UI_STATUS_OK, STATUS_SHOW_MS, "%s: already set on all", name);
+                        } else if (!submit_group(ips, count, cmd, ui.menu_selected, event)) {
+                            set_status(UI_STATUS_FAIL, STATUS_SHOW_MS, "%s: busy", name);
+                        } else {
+                            group_wanted = wanted;
+                            if (skipped)
+                                set_status(UI_STATUS_PENDING, 0, "%s x%d%s, %d already set...", name, count, of, skipped);
+                            else
+                                set_status(UI_STATUS_PENDING, 0, "%s x%d%s...", name, count, of);
+                        }
+                    }
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_LEFT) {
+                    int col = ui.menu_selected % MENU_COLS;
+                    int row = ui.menu_selected / MENU_COLS;
+                    if (col == 0) {
+                        int last_in_row = (row + 1) * MENU_COLS - 1;
+                        if (last_in_row >= MENU_ITEM_COUNT) last_in_row = MENU_ITEM_COUNT - 1;
+                        ui.menu_selected = last_in_row;
+                    } else {
+                        ui.menu_selected--;
+                    }
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_RIGHT) {
+                    int col = ui.menu_selected % MENU_COLS;
+                    int row = ui.menu_selected / MENU_COLS;
+                    int last_in_row = (row + 1) * MENU_COLS - 1;
+                    if (last_in_row >= MENU_ITEM_COUNT) last_in_row = MENU_ITEM_COUNT - 1;
+                    if (col == MENU_COLS - 1 || ui.menu_selected == last_in_row) {
+                        ui.menu_selected = row * MENU_COLS;
+                    } else {
+                        ui.menu_selected++;
+                    }
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_UP) {
+                    int col = ui.menu_selected % MENU_COLS;
+                    int row = ui.menu_selected / MENU_COLS;
+                    if (row == 0) {
+                        int last_row = (MENU_ITEM_COUNT - 1) / MENU_COLS;
+                        int dest = last_row * MENU_COLS + col;
+                        if (dest >= MENU_ITEM_COUNT) dest = MENU_ITEM_COUNT - 1;
+                        ui.menu_selected = dest;
+                    } else {
+                        ui.menu_selected -= MENU_COLS;
+                    }
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_DOWN) {
+                    int col = ui.menu_selected % MENU_COLS;
+                    int row = ui.menu_selected / MENU_COLS;
+                    int last_row = (MENU_ITEM_COUNT - 1) / MENU_COLS;
+
+                    if (row == last_row) {
+                        // Move focus to device bar only if already on last menu row
+                        ui.focus_row = 1;
+                    } else {
+                        // Move down normally in menu
+                        int dest = ui.menu_selected + MENU_COLS;
+                        if (dest >= MENU_ITEM_COUNT) {
+                            dest = (last_row * MENU_COLS) + col;
+                            if (dest >= MENU_ITEM_COUNT)
+                                dest = MENU_ITEM_COUNT - 1;
+                        }
+                        ui.menu_selected = dest;
+                    }
+                }
+            } else if (ui.focus_row == 1) {
+                // Device bar navigation
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_UP) {
+                    ui.focus_row = 0;
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_LEFT) {
+                    int orig = ui.highlight_idx;
+                    do {
+                        ui.highlight_idx = (ui.highlight_idx - 1 + DEVICE_BAR_SLOTS) % DEVICE_BAR_SLOTS;
+                    } while (!ui.device_present[ui.highlight_idx] && ui.highlight_idx != orig);
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_DPAD_RIGHT) {
+                    int orig = ui.highlight_idx;
+                    do {
+                        ui.highlight_idx = (ui.highlight_idx + 1) % DEVICE_BAR_SLOTS;
+                    } while (!ui.device_present[ui.highlight_idx] && ui.highlight_idx != orig);
+                }
+                if (event->cbutton.button == SDL_CONTROLLER_BUTTON_A) {
+                    if (ui.device_present[ui.highlight_idx]) {
+                        ui.selected_idx = ui.highlight_idx;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void app_init(SDL_Renderer* r, const ui_assets_t* assets, const app_config_t* cfg, uint32_t now) {
+    renderer = r;
+    config = *cfg;
+    clock_ms = now;
+    running = true;
+    drawn_valid = false;
+    state_gen = devstate_generation() - 1;   // Read once on the first pass
+    state_ip = 0;
+    ui_init(renderer, assets);
+    if (!config.replay) session_record_start(now);
+}
+
+void app_shutdown(void) {
+    detect_snapshot_release(units);
+    units = NULL;
+    ui_shutdown();
+}
+
+bool app_running(void) {
+    return running;
+}
+
+void app_update(uint32_t now) {
+    clock_ms = now;
+    // Device state is only rebuilt when discovery published a change
+    if (!units || detect_snapshot_generation(units) != detect_generation()) {
+        uint64_t t0 = profiler_begin();
+        const detect_snapshot_t* fresh = detect_snapshot_acquire();
+        if (fresh) {
+            detect_snapshot_release(units);
+            units = fresh;
+            update_devices(units);
+            session_record_units(now, units);
+        }
+        profiler_end(PROF_DETECT, t0);
+    }
+    // Cached unit state, re-read when it changed or another unit is targeted
+    uint32_t target_ip = units ? target_unit(units) : 0;
+    if (state_gen != devstate_generation() || state_ip != target_ip) {
+        state_gen = devstate_generation();
+        state_ip = target_ip;
+        update_device_state(target_ip);
+    }
+    if (status_until && SDL_TICKS_PASSED(now, status_until)) {
+        ui.status_kind = UI_STATUS_NONE;
+        ui.status[0] = 0;
+        status_until = 0;
+    }
+    if (ui.diag_visible && SDL_TICKS_PASSED(now, diag_next)) {
+        refresh_diagnostics(units);
+        diag_next = now + DIAG_REFRESH_MS;
+    }
+    if (ui.hud_visible && SDL_TICKS_PASSED(now, hud_next)) {
+        refresh_hud();
+        hud_next = now + HUD_REFRESH_MS;
+    }
+    if (upload_next && SDL_TICKS_PASSED(now, upload_next)) {
+        upload_status_t st;
+        upload_status(&st);
+        upload_next = st.active ? now + UPLOAD_REFRESH_MS : 0;
+        if (st.active) show_upload_progress();
+    }
+}
+
+// Nothing to repaint: sleep until input, a command result, a discovery
+// change or the status line expiring
+int app_idle_ms(uint32_t now) {
+    ui_damage(drawn_valid ? &drawn : NULL, &ui);
+    if (damage_pending()) return -1;
+    int wait = IDLE_WAIT_MS;
+    if (status_until && (int)(status_until - now) < wait)
+        wait = (int)(status_until - now);
+    if (ui.diag_visible && (int)(diag_next - now) < wait)
+        wait = (int)(diag_next - now);
+    if (ui.hud_visible && (int)(hud_next - now) < wait)
+        wait = (int)(hud_next - now);
+    if (upload_next && (int)(upload_next - now) < wait)
+        wait = (int)(upload_next - now);
+    return wait < 0 ? 0 : wait;
+}
+
+// Recomposite only the dirty rects; the caller pushes just those to the screen
+const SDL_Rect* app_render(int* count) {
+    ui_damage(drawn_valid ? &drawn : NULL, &ui);
+    *count = 0;
+    if (!damage_pending()) return NULL;
+    const SDL_Rect* dirty = damage_rects(count);
+    for (int i = 0; i < *count; ++i) {
+        SDL_RenderSetClipRect(renderer, &dirty[i]);
+        ui_render(&ui);
+    }
+    SDL_RenderSetClipRect(renderer, NULL);
+    return dirty;
+}
+
+void app_frame_done(void) {
+    damage_clear();
+    drawn = ui;
+    drawn_valid = true;
+}
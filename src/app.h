@@ -0,0 +1,67 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "ui.h"
+#include "upload.h"
+
+typedef struct {
+    /**
+     * Fills names with the files the White button pushes to the units.
+     * NULL leaves uploads off.
+     *
+     * @return Number of files
+     */
+    int  (*list_uploads)(char names[][UPLOAD_PATH_MAX], int max);
+    bool replay;                      // Nothing goes out: commands complete from the trace, no files are written
+} app_config_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets up the UI on renderer and, unless replaying, starts recording the
+ * session (see session.h). The services it reads (discovery, device state,
+ * command queue) are started by the caller.
+ *
+ * @param now SDL_GetTicks() or the replay clock; every other call takes the same clock
+ */
+void app_init(SDL_Renderer* renderer, const ui_assets_t* assets, const app_config_t* cfg, uint32_t now);
+void app_shutdown(void);
+
+/**
+ * @return false once the user asked to exit
+ */
+bool app_running(void);
+
+/**
+ * Takes in a new discovery snapshot, the target unit's state and expired
+ * timers. First thing every frame.
+ */
+void app_update(uint32_t now);
+
+/**
+ * @return -1 if there is something to draw, else how long the loop may sleep
+ *         waiting for input before the next timer is due
+ */
+int app_idle_ms(uint32_t now);
+
+void app_handle_event(const SDL_Event* event, uint32_t now);
+
+/**
+ * Redraws the rects that changed since the last frame.
+ *
+ * @return The rects to present, valid until app_frame_done(); *count is 0
+ *         if nothing changed
+ */
+const SDL_Rect* app_render(int* count);
+
+/**
+ * Call once the rects from app_render() are on screen.
+ */
+void app_frame_done(void);
+
+#ifdef __cplusplus
+}
+#endif
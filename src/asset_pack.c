@@ -0,0 +1,87 @@
+#include "asset_pack.h"
+#include "memstat.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+
+struct asset_pack {
+    uint8_t*                  data;   // Whole file
+    uint32_t                  size;
+    const asset_pack_entry_t* index;
+    uint32_t                  count;
+};
+
+static bool check_index(const asset_pack_t* p) {
+    for (uint32_t i = 0; i < p->count; ++i) {
+        const asset_pack_entry_t* e = &p->index[i];
+        if (e->offset > p->size || e->size > p->size - e->offset) return false;
+        if ((uint64_t)e->pitch * e->h > e->size || e->pitch < (uint32_t)e->w * 4) return false;
+        if (e->name[ASSET_PACK_NAME_MAX - 1] != 0) return false;
+    }
+    return true;
+}
+
+asset_pack_t* asset_pack_open(const char* path, SDL_atomic_t* progress) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    asset_pack_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, ASSET_PACK_MAGIC, 4) != 0 ||
+        hdr.version != ASSET_PACK_VERSION || hdr.size < sizeof(hdr) ||
+        hdr.count > (hdr.size - sizeof(hdr)) / sizeof(asset_pack_entry_t)) {
+        debugPrint("[asset_pack] %s is not a version %d pack\n", path, ASSET_PACK_VERSION);
+        fclose(f);
+        return NULL;
+    }
+
+    asset_pack_t* p = (asset_pack_t*)mem_calloc(MEM_UI, 1, sizeof(*p));
+    uint8_t* data = p ? (uint8_t*)mem_alloc(MEM_UI, hdr.size) : NULL;
+    if (!data) {
+        debugPrint("[asset_pack] Out of memory for %u bytes\n", (unsigned)hdr.size);
+        mem_free(p);
+        fclose(f);
+        return NULL;
+    }
+    memcpy(data, &hdr, sizeof(hdr));
+
+    // Sequential chunks keep the drive streaming while reporting progress
+    uint32_t got = sizeof(hdr);
+    while (got < hdr.size) {
+        uint32_t want = SDL_min(hdr.size - got, ASSET_PACK_READ_CHUNK);
+        size_t n = fread(data + got, 1, want, f);
+        if (n == 0) break;
+        got += (uint32_t)n;
+        if (progress) SDL_AtomicSet(progress, (int)((uint64_t)got * 1000 / hdr.size));
+    }
+    fclose(f);
+
+    p->data = data;
+    p->size = hdr.size;
+    p->index = (const asset_pack_entry_t*)(data + sizeof(hdr));
+    p->count = hdr.count;
+    if (got != hdr.size || !check_index(p)) {
+        debugPrint("[asset_pack] %s is truncated or corrupt\n", path);
+        asset_pack_close(p);
+        return NULL;
+    }
+    return p;
+}
+
+const asset_pack_entry_t* asset_pack_find(const asset_pack_t* pack, const char* name, int screen_w, int screen_h) {
+    for (uint32_t i = 0; i < pack->count; ++i) {
+        const asset_pack_entry_t* e = &pack->index[i];
+        if (e->screen_w == screen_w && e->screen_h == screen_h && strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+SDL_Surface* asset_pack_surface(const asset_pack_t* pack, const asset_pack_entry_t* e) {
+    return SDL_CreateRGBSurfaceWithFormatFrom(pack->data + e->offset, e->w, e->h, 32, (int)e->pitch, e->format);
+}
+
+void asset_pack_close(asset_pack_t* pack) {
+    if (!pack) return;
+    mem_free(pack->data);
+    mem_free(pack);
+}
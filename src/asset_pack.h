@@ -0,0 +1,67 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+
+// Pre-baked startup assets: images already decoded and scaled for a screen
+// mode, plus the static strings already rasterized, so startup is one
+// sequential read instead of JPEG/PNG decoding and font rendering.
+//
+// Layout (little endian):
+//   asset_pack_header_t
+//   asset_pack_entry_t[count]          index
+//   pixel data, each entry ASSET_PACK_ALIGN aligned
+#define ASSET_PACK_MAGIC      "TDPK"
+#define ASSET_PACK_VERSION    1
+#define ASSET_PACK_NAME_MAX   24
+#define ASSET_PACK_ALIGN      16
+#define ASSET_PACK_FORMAT     SDL_PIXELFORMAT_ARGB8888   // Framebuffer format in 32 bpp modes
+#define ASSET_PACK_READ_CHUNK (256 * 1024)               // Progress granularity while streaming
+
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint32_t count;                   // Index entries
+    uint32_t size;                    // Whole file, for a one-shot read
+} asset_pack_header_t;
+
+typedef struct {
+    char     name[ASSET_PACK_NAME_MAX];
+    uint16_t screen_w, screen_h;      // Mode it was baked for
+    uint16_t w, h;
+    uint32_t pitch;
+    uint32_t format;                  // SDL_PIXELFORMAT_*
+    uint32_t offset;                  // From the start of the file
+    uint32_t size;
+} asset_pack_entry_t;
+
+typedef struct asset_pack asset_pack_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reads a pack into memory in ASSET_PACK_READ_CHUNK pieces and checks its index.
+ *
+ * @param progress Optional; set to the fraction read so far in permille
+ * @return         NULL if the file is missing or malformed
+ */
+asset_pack_t* asset_pack_open(const char* path, SDL_atomic_t* progress);
+
+/**
+ * Finds an entry baked for a screen_w x screen_h mode.
+ */
+const asset_pack_entry_t* asset_pack_find(const asset_pack_t* pack, const char* name, int screen_w, int screen_h);
+
+/**
+ * Wraps an entry's pixels in a surface without copying. The surface must be
+ * freed before the pack is closed.
+ */
+SDL_Surface* asset_pack_surface(const asset_pack_t* pack, const asset_pack_entry_t* e);
+
+void asset_pack_close(asset_pack_t* pack);
+
+#ifdef __cplusplus
+}
+#endif
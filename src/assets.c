@@ -0,0 +1,248 @@
+#include "assets.h"
+#include "asset_pack.h"
+#include "compose.h"
+#include "memstat.h"
+#include <stdio.h>
+#include <string.h>
+#include <SDL_image.h>
+#include <hal/debug.h>
+
+const char* const asset_names[ASSET_COUNT] = {
+    "bg", "td", "title", "exit_left", "exit_b", "exit_right"
+};
+
+static char load_dir[256];
+static int load_w, load_h;
+static SDL_Thread* loader = NULL;
+static SDL_atomic_t progress;         // Permille
+static SDL_atomic_t done;
+
+// Loader results, handed over in assets_load_finish()
+static asset_pack_t* pack = NULL;
+static SDL_Surface* surfaces[ASSET_COUNT];
+static TTF_Font* title_font = NULL;
+static TTF_Font* exit_font = NULL;
+static void* font_data = NULL;        // Both fonts read from this one copy of font.ttf
+
+// SCALEX/SCALEY for a mode other than the current screen
+static int scale(int v, int screen, int ref) {
+    return (int)((float)v * screen / (float)ref);
+}
+
+static SDL_Surface* load_image(const char* dir, const char* name, const char* const* exts) {
+    char path[512];
+    for (; *exts; ++exts) {
+        snprintf(path, sizeof(path), "%s" ASSETS_SEP "img" ASSETS_SEP "%s.%s", dir, name, *exts);
+        SDL_Surface* s = (strcmp(*exts, "bmp") == 0) ? SDL_LoadBMP(path) : IMG_Load(path);
+        if (s) return s;
+    }
+    return NULL;
+}
+
+// SDL_BlitScaled() between formats scales and converts pixel by pixel.
+// Converting once at the source size and scaling with the compositor does the
+// same in a fraction of the time; a premultiplied blend over black is the
+// flattening. False if the compositor cannot take the surfaces.
+static bool fit_composited(SDL_Surface* src, SDL_Surface* out, bool opaque) {
+    if (!comp_supported(out)) return false;
+    SDL_Surface* conv = SDL_ConvertSurfaceFormat(src, ASSET_PACK_FORMAT, 0);
+    if (!conv) return false;
+    // A colour key has become alpha in the conversion
+    bool blend = opaque && (src->format->Amask || SDL_GetColorKey(src, NULL) == 0);
+    bool ok = !blend || comp_premultiply(conv);
+    ok = ok && comp_blit_scaled(conv, out, NULL, blend);
+    SDL_FreeSurface(conv);
+    return ok;
+}
+
+// Converts to ASSET_PACK_FORMAT at w x h, so drawing is a 1:1 copy. An
+// opaque result is flattened onto black, as ui_render() would have drawn it.
+static SDL_Surface* fit(SDL_Surface* src, int w, int h, bool opaque) {
+    if (!src) return NULL;
+    SDL_Surface* out = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, ASSET_PACK_FORMAT);
+    if (out) {
+        if (opaque)
+            SDL_FillRect(out, NULL, SDL_MapRGBA(out->format, 0, 0, 0, 255));
+        if (!fit_composited(src, out, opaque)) {
+            if (!opaque) SDL_SetSurfaceBlendMode(src, SDL_BLENDMODE_NONE);
+            if (SDL_BlitScaled(src, NULL, out, NULL) != 0) {
+                SDL_FreeSurface(out);
+                out = NULL;
+            }
+        }
+    }
+    SDL_FreeSurface(src);
+    return out;
+}
+
+static SDL_Surface* render_text(TTF_Font* font, const char* text, SDL_Color c) {
+    SDL_Surface* s = font ? TTF_RenderText_Blended(font, text, c) : NULL;
+    if (!s || s->format->format == ASSET_PACK_FORMAT) return s;
+    SDL_Surface* out = SDL_ConvertSurfaceFormat(s, ASSET_PACK_FORMAT, 0);
+    SDL_FreeSurface(s);
+    return out;
+}
+
+void assets_render_loose(const char* dir, int screen_w, int screen_h,
+                         TTF_Font* tfont, TTF_Font* efont, SDL_Surface* out[ASSET_COUNT]) {
+    static const char* const bg_exts[] = {"jpg", "png", "bmp", NULL};
+    static const char* const td_exts[] = {"png", "jpg", "bmp", NULL};
+
+    out[ASSET_BG] = fit(load_image(dir, "bg", bg_exts), screen_w, screen_h, true);
+    SDL_AtomicSet(&progress, 500);
+    out[ASSET_TD] = fit(load_image(dir, "TD", td_exts),
+                        scale(64, screen_w, SCREEN_WIDTH_DEF), scale(64, screen_h, SCREEN_HEIGHT_DEF), false);
+    SDL_AtomicSet(&progress, 700);
+
+    out[ASSET_TITLE]      = render_text(tfont, "Type D Setup", (SDL_Color){255,255,255,255});
+    out[ASSET_EXIT_LEFT]  = render_text(efont, "Press ",       (SDL_Color){220,220,220,255});
+    out[ASSET_EXIT_B]     = render_text(efont, "B",            (SDL_Color){255,0,0,255});
+    out[ASSET_EXIT_RIGHT] = render_text(efont, " to exit",     (SDL_Color){220,220,220,255});
+}
+
+static void open_fonts(void) {
+    char path[512];
+    size_t size = 0;
+    snprintf(path, sizeof(path), "%s" ASSETS_SEP ASSETS_FONT_PATH, load_dir);
+    font_data = SDL_LoadFile(path, &size);
+    if (!font_data) {
+        debugPrint("[assets] Cannot read %s\n", path);
+        return;
+    }
+    title_font = TTF_OpenFontRW(SDL_RWFromConstMem(font_data, (int)size), 1, load_h / 18);
+    exit_font = TTF_OpenFontRW(SDL_RWFromConstMem(font_data, (int)size), 1, load_h / 32);
+}
+
+static bool take_from_pack(void) {
+    for (int i = 0; i < ASSET_COUNT; ++i) {
+        const asset_pack_entry_t* e = asset_pack_find(pack, asset_names[i], load_w, load_h);
+        surfaces[i] = e ? asset_pack_surface(pack, e) : NULL;
+        if (!surfaces[i]) {
+            debugPrint("[assets] Pack has no %s for %dx%d\n", asset_names[i], load_w, load_h);
+            return false;
+        }
+    }
+    return true;
+}
+
+static int loader_thread(void* arg) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s" ASSETS_SEP ASSETS_PACK_NAME, load_dir);
+
+    pack = asset_pack_open(path, &progress);
+    if (pack && !take_from_pack()) {
+        for (int i = 0; i < ASSET_COUNT; ++i) {
+            if (surfaces[i]) SDL_FreeSurface(surfaces[i]);
+            surfaces[i] = NULL;
+        }
+        asset_pack_close(pack);
+        pack = NULL;
+    }
+    // The menu labels and HUD still draw with the fonts, so they are opened either way
+    open_fonts();
+    if (!pack)
+        assets_render_loose(load_dir, load_w, load_h, title_font, exit_font, surfaces);
+
+    SDL_AtomicSet(&progress, 1000);
+    SDL_AtomicSet(&done, 1);
+    return 0;
+}
+
+void assets_load_start(const char* dir, int screen_w, int screen_h) {
+    snprintf(load_dir, sizeof(load_dir), "%s", dir);
+    load_w = screen_w;
+    load_h = screen_h;
+    SDL_AtomicSet(&progress, 0);
+    SDL_AtomicSet(&done, 0);
+    loader = SDL_CreateThread(loader_thread, "assets", NULL);
+    if (!loader) {
+        debugPrint("[assets] No loader thread, loading inline\n");
+        loader_thread(NULL);
+    }
+}
+
+int assets_load_progress(void) {
+    return SDL_AtomicGet(&progress);
+}
+
+bool assets_load_done(void) {
+    return SDL_AtomicGet(&done) != 0;
+}
+
+static SDL_Texture* to_texture(SDL_Renderer* r, SDL_Surface* s, SDL_Rect* rect) {
+    if (!s) return NULL;
+    SDL_Texture* t = mem_texture_from_surface(MEM_UI, r, s);
+    if (rect) {
+        rect->w = s->w;
+        rect->h = s->h;
+    }
+    return t;
+}
+
+bool assets_load_finish(SDL_Renderer* r, ui_assets_t* out) {
+    if (loader) {
+        SDL_WaitThread(loader, NULL);
+        loader = NULL;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->title_font = title_font;
+    out->exit_font = exit_font;
+    out->bg = to_texture(r, surfaces[ASSET_BG], NULL);
+    out->td = to_texture(r, surfaces[ASSET_TD], NULL);
+    out->title = to_texture(r, surfaces[ASSET_TITLE], &out->title_rect);
+    out->exit_left = to_texture(r, surfaces[ASSET_EXIT_LEFT], &out->exit_left_rect);
+    out->exit_b = to_texture(r, surfaces[ASSET_EXIT_B], &out->exit_b_rect);
+    out->exit_right = to_texture(r, surfaces[ASSET_EXIT_RIGHT], &out->exit_right_rect);
+    // The background was flattened when it was baked
+    if (out->bg) SDL_SetTextureBlendMode(out->bg, SDL_BLENDMODE_NONE);
+
+    out->title_rect.x = (load_w - out->title_rect.w) / 2;
+    out->title_rect.y = scale(50, load_h, SCREEN_HEIGHT_DEF);
+
+    if (out->exit_left && out->exit_b && out->exit_right) {
+        int total_w = out->exit_left_rect.w + out->exit_b_rect.w + out->exit_right_rect.w;
+        int x = load_w - total_w - scale(20, load_w, SCREEN_WIDTH_DEF);
+        int y = load_h - out->exit_left_rect.h - scale(20, load_h, SCREEN_HEIGHT_DEF);
+        out->exit_left_rect.x = x;
+        out->exit_b_rect.x = x + out->exit_left_rect.w;
+        out->exit_right_rect.x = out->exit_b_rect.x + out->exit_b_rect.w;
+        out->exit_left_rect.y = out->exit_b_rect.y = out->exit_right_rect.y = y;
+    }
+
+    // Textures hold their own copies; the pack and surfaces can go
+    for (int i = 0; i < ASSET_COUNT; ++i) {
+        if (surfaces[i]) SDL_FreeSurface(surfaces[i]);
+        surfaces[i] = NULL;
+    }
+    bool from_pack = (pack != NULL);
+    asset_pack_close(pack);
+    pack = NULL;
+    return from_pack;
+}
+
+void assets_free(ui_assets_t* a) {
+    SDL_Texture* textures[] = {a->bg, a->td, a->title, a->exit_left, a->exit_b, a->exit_right};
+    for (size_t i = 0; i < SDL_arraysize(textures); ++i)
+        mem_texture_destroy(MEM_UI, textures[i]);
+    if (a->title_font) TTF_CloseFont(a->title_font);
+    if (a->exit_font) TTF_CloseFont(a->exit_font);
+    memset(a, 0, sizeof(*a));
+    title_font = exit_font = NULL;
+    SDL_free(font_data);
+    font_data = NULL;
+}
+
+void assets_draw_splash(SDL_Renderer* r, int screen_w, int screen_h, int permille) {
+    int w = scale(240, screen_w, SCREEN_WIDTH_DEF), h = scale(6, screen_h, SCREEN_HEIGHT_DEF);
+    SDL_Rect frame = {(screen_w - w) / 2 - 2, screen_h / 2 - h / 2 - 2, w + 4, h + 4};
+    SDL_Rect bar = {frame.x + 2, frame.y + 2, (int)((int64_t)w * SDL_max(0, SDL_min(permille, 1000)) / 1000), h};
+
+    SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(r, 0, 0, 0, 255);
+    SDL_RenderFillRect(r, NULL);
+    SDL_SetRenderDrawColor(r, 80, 255, 100, 255);
+    SDL_RenderDrawRect(r, &frame);
+    SDL_SetRenderDrawColor(r, 0, 220, 0, 255);
+    SDL_RenderFillRect(r, &bar);
+}
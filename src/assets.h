@@ -0,0 +1,84 @@
+#pragma once
+#include <stdbool.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "ui.h"
+
+#ifndef ASSETS_DIR
+#define ASSETS_DIR         "D:\\media"
+#endif
+#ifndef ASSETS_SEP
+#define ASSETS_SEP         "\\"
+#endif
+#define ASSETS_PACK_NAME   "typed.pak"
+#define ASSETS_FONT_PATH   "font" ASSETS_SEP "font.ttf"
+
+// Startup images and strings, in pack order
+typedef enum {
+    ASSET_BG = 0,                     // Scaled to the screen
+    ASSET_TD,                         // Scaled to the logo rect
+    ASSET_TITLE,
+    ASSET_EXIT_LEFT,
+    ASSET_EXIT_B,
+    ASSET_EXIT_RIGHT,
+    ASSET_COUNT
+} asset_id_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const char* const asset_names[ASSET_COUNT];
+
+/**
+ * Starts loading the startup assets on a background thread: typed.pak when
+ * it has the screen mode, otherwise the loose images and font. Only
+ * surfaces and fonts are made off the main thread; textures are created by
+ * assets_load_finish(). Loads synchronously if no thread can be started.
+ *
+ * @param dir Media directory (ASSETS_DIR on the console)
+ */
+void assets_load_start(const char* dir, int screen_w, int screen_h);
+
+/**
+ * @return Load progress in permille
+ */
+int assets_load_progress(void);
+
+/**
+ * @return true once the loader has finished
+ */
+bool assets_load_done(void);
+
+/**
+ * Waits for the loader, turns its surfaces into textures and lays out the
+ * title and exit prompt the way ui_render() expects.
+ *
+ * @return true if the images and strings came from the pack
+ */
+bool assets_load_finish(SDL_Renderer* r, ui_assets_t* out);
+
+/**
+ * Destroys textures and fonts from assets_load_finish().
+ */
+void assets_free(ui_assets_t* a);
+
+/**
+ * Decodes, scales and rasterizes every startup asset from the loose files,
+ * in ASSET_PACK_FORMAT. Used when there is no pack, and by the host tool
+ * that bakes one, so both produce the same pixels.
+ *
+ * @param out Filled with a surface per asset_id_t, NULL where loading failed
+ */
+void assets_render_loose(const char* dir, int screen_w, int screen_h,
+                         TTF_Font* title_font, TTF_Font* exit_font, SDL_Surface* out[ASSET_COUNT]);
+
+/**
+ * Draws the loading screen: black with a progress bar, no fonts or images,
+ * so it can be shown before anything is loaded.
+ */
+void assets_draw_splash(SDL_Renderer* r, int screen_w, int screen_h, int permille);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,199 @@
+#include "audio_stream.h"
+#include "memstat.h"
+#include "wav.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+#include <SDL.h>
+
+#define GAIN_SHIFT       15           // Q15 fixed-point gain
+
+// Single producer (reader thread) / single consumer (audio callback).
+// Positions only ever grow; masking gives the ring offset. Whole stereo
+// frames go in, so the decoder can write samples straight into it.
+static int16_t ring_samples[AUDIO_RING_BYTES / sizeof(int16_t)];
+static uint8_t* const ring = (uint8_t*)ring_samples;
+static SDL_atomic_t write_pos;
+static SDL_atomic_t read_pos;
+
+static SDL_atomic_t underruns;
+static SDL_atomic_t underrun_bytes;
+static SDL_atomic_t min_fill;
+static SDL_atomic_t file_bytes;       // decoder.bytes_read, published for audio_stream_stats()
+
+static FILE* audio_file = NULL;
+static wav_decoder_t decoder;         // Reader thread only, once started
+static int32_t gain_q15 = 1 << GAIN_SHIFT;
+static SDL_Thread* reader = NULL;
+static SDL_sem* space = NULL;         // Posted by the callback after it frees ring space
+static int running = 0;
+static bool audio_open = false;
+static int held_bytes = 0;            // Ring and device buffer, as told to memstat
+
+static uint32_t ring_fill(void) {
+    return (uint32_t)SDL_AtomicGet(&write_pos) - (uint32_t)SDL_AtomicGet(&read_pos);
+}
+
+// Decodes up to len bytes of output into the ring at off, looping at the end
+static uint32_t decode_into(uint32_t off, uint32_t len) {
+    int frames = wav_decode(&decoder, (int16_t*)(ring + off), (int)(len / WAV_OUT_FRAME_BYTES), true);
+    return (uint32_t)frames * WAV_OUT_FRAME_BYTES;
+}
+
+// Fill as much free space as there is, one chunk at a time
+static void ring_refill(void) {
+    while (1) {
+        uint32_t w = (uint32_t)SDL_AtomicGet(&write_pos);
+        uint32_t free_bytes = AUDIO_RING_BYTES - ring_fill();
+        if (free_bytes < AUDIO_DECODE_CHUNK) return;
+
+        uint32_t off = w & (AUDIO_RING_BYTES - 1);
+        uint32_t first = AUDIO_RING_BYTES - off;
+        if (first > AUDIO_DECODE_CHUNK) first = AUDIO_DECODE_CHUNK;
+        uint32_t got = decode_into(off, first);
+        if (got == first && first < AUDIO_DECODE_CHUNK)
+            got += decode_into(0, AUDIO_DECODE_CHUNK - first);
+        SDL_AtomicSet(&file_bytes, (int)decoder.bytes_read);
+        if (got == 0) return;
+
+        // Data must be visible before the consumer sees the new position
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&write_pos, (int)(w + (uint32_t)got));
+    }
+}
+
+static int reader_func(void* data) {
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+    while (running) {
+        ring_refill();
+        SDL_SemWaitTimeout(space, 100);
+    }
+    return 0;
+}
+
+// Saturating integer gain, no floats in the callback
+static void apply_gain(int16_t* samples, int count) {
+    int32_t g = gain_q15;
+    for (int i = 0; i < count; i++) {
+        int32_t v = (samples[i] * g) >> GAIN_SHIFT;
+        if (v < -32768) v = -32768;
+        else if (v > 32767) v = 32767;
+        samples[i] = (int16_t)v;
+    }
+}
+
+static void audio_callback(void* userdata, Uint8* stream, int len) {
+    uint32_t r = (uint32_t)SDL_AtomicGet(&read_pos);
+    uint32_t avail = (uint32_t)SDL_AtomicGet(&write_pos) - r;
+    SDL_MemoryBarrierAcquire();
+
+    if (avail < (uint32_t)SDL_AtomicGet(&min_fill))
+        SDL_AtomicSet(&min_fill, (int)avail);
+
+    uint32_t take = avail < (uint32_t)len ? avail : (uint32_t)len;
+    uint32_t off = r & (AUDIO_RING_BYTES - 1);
+    uint32_t first = AUDIO_RING_BYTES - off;
+    if (first > take) first = take;
+    memcpy(stream, ring + off, first);
+    memcpy(stream + first, ring, take - first);
+
+    if (take < (uint32_t)len) {
+        SDL_memset(stream + take, 0, len - take);
+        SDL_AtomicAdd(&underruns, 1);
+        SDL_AtomicAdd(&underrun_bytes, (int)(len - take));
+    }
+
+    SDL_AtomicSet(&read_pos, (int)(r + take));
+    SDL_SemPost(space);
+
+    apply_gain((int16_t*)stream, (int)(take / sizeof(int16_t)));
+}
+
+bool audio_stream_start(const char* path, float volume) {
+    if (running) return true;
+
+    audio_file = fopen(path, "rb");
+    if (!audio_file) return false;
+    wav_info_t info;
+    if (!wav_parse(audio_file, &info)) {
+        debugPrint("[audio] Not playing %s\n", path);
+        fclose(audio_file);
+        audio_file = NULL;
+        return false;
+    }
+    wav_decoder_init(&decoder, audio_file, &info);
+    debugPrint("[audio] %s: %s, %u ch, %u Hz\n", path,
+               info.format == WAV_FORMAT_IMA_ADPCM ? "IMA ADPCM" : "PCM", info.channels, (unsigned)info.rate);
+
+    if (volume < 0.f) volume = 0.f;
+    gain_q15 = (int32_t)(volume * (1 << GAIN_SHIFT) + 0.5f);
+
+    SDL_AtomicSet(&write_pos, 0);
+    SDL_AtomicSet(&read_pos, 0);
+    SDL_AtomicSet(&underruns, 0);
+    SDL_AtomicSet(&underrun_bytes, 0);
+    SDL_AtomicSet(&min_fill, AUDIO_RING_BYTES);
+    SDL_AtomicSet(&file_bytes, 0);
+
+    // Prefill so the first callbacks never hit the disk
+    ring_refill();
+
+    space = SDL_CreateSemaphore(0);
+    running = 1;
+    reader = space ? SDL_CreateThread(reader_func, "audio_reader", NULL) : NULL;
+    if (!reader) {
+        debugPrint("[audio] Reader thread failed: %s\n", SDL_GetError());
+        audio_stream_stop();
+        return false;
+    }
+
+    SDL_AudioSpec spec = {0};
+    spec.freq = 44100;
+    spec.format = AUDIO_S16LSB;
+    spec.channels = 2;
+    spec.samples = 2048;
+    spec.callback = audio_callback;
+    if (SDL_OpenAudio(&spec, NULL) != 0) {
+        debugPrint("[audio] SDL_OpenAudio failed: %s\n", SDL_GetError());
+        audio_stream_stop();
+        return false;
+    }
+    audio_open = true;
+    held_bytes = AUDIO_RING_BYTES + (int)sizeof(decoder) + (int)spec.size;
+    mem_note_fixed(MEM_AUDIO, held_bytes);
+    SDL_PauseAudio(0);
+    return true;
+}
+
+void audio_stream_stop(void) {
+    if (audio_open) {
+        SDL_CloseAudio();
+        audio_open = false;
+        mem_note_fixed(MEM_AUDIO, -held_bytes);
+        held_bytes = 0;
+    }
+    running = 0;
+    if (reader) {
+        SDL_SemPost(space);
+        SDL_WaitThread(reader, NULL);
+        reader = NULL;
+    }
+    if (space) {
+        SDL_DestroySemaphore(space);
+        space = NULL;
+    }
+    if (audio_file) {
+        fclose(audio_file);
+        audio_file = NULL;
+    }
+}
+
+void audio_stream_stats(audio_stats_t* out) {
+    out->playing = audio_open;
+    out->underruns = (uint32_t)SDL_AtomicGet(&underruns);
+    out->underrun_bytes = (uint32_t)SDL_AtomicGet(&underrun_bytes);
+    out->fill_bytes = ring_fill();
+    out->capacity_bytes = AUDIO_RING_BYTES;
+    out->min_fill_bytes = (uint32_t)SDL_AtomicGet(&min_fill);
+    out->file_bytes = (uint32_t)SDL_AtomicGet(&file_bytes);
+}
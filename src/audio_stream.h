@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AUDIO_RING_BYTES   (128 * 1024)   // Power of two; ~0.75 s of 44.1 kHz stereo S16
+#define AUDIO_DECODE_CHUNK (16 * 1024)    // Output bytes decoded per step
+
+typedef struct {
+    bool     playing;          // Started and not stopped
+    uint32_t underruns;        // Callbacks that found less data than they needed
+    uint32_t underrun_bytes;   // Silence inserted because of underruns
+    uint32_t fill_bytes;       // Currently buffered
+    uint32_t capacity_bytes;
+    uint32_t min_fill_bytes;   // Lowest level seen by the callback since start
+    uint32_t file_bytes;       // Read from disk since start; a quarter of the output for IMA ADPCM
+} audio_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opens a WAV file, prefills the ring buffer and starts looping playback. The
+ * file may be 8 or 16 bit PCM or IMA ADPCM, mono or stereo, at any rate
+ * wav_parse() accepts; a reader thread decodes it to 44.1 kHz stereo S16
+ * ahead of the audio callback, which never touches the disk. A file that is
+ * not one of those is refused rather than played as noise.
+ *
+ * @param path   File to play
+ * @param volume Linear gain, 0.0 to 1.0
+ * @return       true if playback started
+ */
+bool audio_stream_start(const char* path, float volume);
+
+/**
+ * Stops playback, the reader thread and closes the file.
+ */
+void audio_stream_stop(void);
+
+/**
+ * Snapshot of the stream counters. Safe to call from any thread.
+ */
+void audio_stream_stats(audio_stats_t* out);
+
+#ifdef __cplusplus
+}
+#endif
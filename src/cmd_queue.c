@@ -0,0 +1,344 @@
+#include "cmd_queue.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+#include "send_cmd.h"
+#include "telemetry.h"
+#include "memstat.h"
+
+// Group completion plus the count of units still in flight. res comes first
+// so the pointer handed to the main loop frees the whole block.
+typedef struct {
+    cmd_result_t res;
+    int          outstanding;
+} cmd_group_t;
+
+typedef struct {
+    uint32_t      ip;
+    char          cmd[CMD_CODE_MAX];
+    char          param[CMD_PARAM_MAX];
+    int           tag;
+    Uint32        submitted;
+    Uint32        deadline;
+    uint64_t      input_us;         // Controller event time, 0 if none
+    cmd_group_t*  group;            // Shared completion for group commands, else NULL
+    int           group_slot;
+} cmd_job_t;
+
+static cmd_job_t jobs[CMD_QUEUE_DEPTH];   // FIFO, oldest first
+static int job_count = 0;
+static uint32_t busy_ip[CMD_QUEUE_WORKERS];   // Unit each worker is talking to, 0 = idle
+static SDL_mutex* lock = NULL;
+static SDL_cond* wake = NULL;
+static SDL_Thread* workers[CMD_QUEUE_WORKERS];
+static Uint32 event_type = 0;
+static int running = 0;
+
+static void push_result(cmd_result_t* res) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = event_type;
+    e.user.data1 = res;
+    if (SDL_PushEvent(&e) != 1)
+        mem_free(res);
+}
+
+// Microseconds from the input to a send_cmd timestamp, 0 if either is missing
+static uint32_t since_input(const cmd_job_t* job, uint64_t at_us) {
+    if (!job->input_us || !at_us || at_us < job->input_us) return 0;
+    return (uint32_t)SDL_min(at_us - job->input_us, (uint64_t)UINT32_MAX);
+}
+
+// req is NULL for a job that expired in the queue
+static void post_result(const cmd_job_t* job, const send_cmd_req_t* req, bool timed_out) {
+    Uint32 elapsed = SDL_GetTicks() - job->submitted;
+    bool ok = req && req->ok;
+    uint32_t wire_us = req ? since_input(job, req->sent_us) : 0;
+    uint32_t ack_us = req ? since_input(job, req->acked_us) : 0;
+    if (wire_us) telemetry_record(job->ip, TELEM_INPUT_WIRE, wire_us);
+    if (ack_us) telemetry_record(job->ip, TELEM_INPUT_ACK, ack_us);
+
+    if (job->group) {
+        cmd_result_t* res = &job->group->res;
+        cmd_unit_result_t* u = &res->units[job->group_slot];
+        u->ip = job->ip;
+        u->ok = ok;
+        u->timed_out = timed_out;
+        u->elapsed_ms = elapsed;
+        u->wire_us = wire_us;
+        u->ack_us = ack_us;
+
+        // Last unit to finish publishes the aggregate
+        SDL_LockMutex(lock);
+        if (ok) res->ok_count++;
+        if (timed_out) res->timed_out = true;
+        if (elapsed > res->elapsed_ms) res->elapsed_ms = elapsed;
+        if (wire_us > res->wire_us) res->wire_us = wire_us;
+        if (ack_us > res->ack_us) res->ack_us = ack_us;
+        bool last = (--job->group->outstanding == 0);
+        SDL_UnlockMutex(lock);
+        if (last) {
+            res->ok = (res->ok_count == res->unit_count);
+            push_result(res);
+        }
+        return;
+    }
+
+    cmd_result_t* res = (cmd_result_t*)mem_calloc(MEM_NET, 1, sizeof(cmd_result_t));
+    if (!res) return;
+    res->ip = job->ip;
+    strncpy(res->cmd, job->cmd, sizeof(res->cmd));
+    res->cmd[sizeof(res->cmd) - 1] = 0;
+    res->tag = job->tag;
+    res->ok = ok;
+    res->ok_count = ok ? 1 : 0;
+    res->timed_out = timed_out;
+    res->elapsed_ms = elapsed;
+    res->wire_us = wire_us;
+    res->ack_us = ack_us;
+    push_result(res);
+}
+
+static void format_ip(uint32_t ip, char* out, size_t size) {
+    // detect_ipstr() uses a static buffer owned by the UI thread
+    snprintf(out, size, "%u.%u.%u.%u",
+        (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+}
+
+static bool ip_busy(uint32_t ip) {
+    for (int i = 0; i < CMD_QUEUE_WORKERS; ++i) {
+        if (busy_ip[i] == ip) return true;
+    }
+    return false;
+}
+
+// Pops the oldest job for a unit no other worker is serving, plus the jobs
+// queued behind it for the same unit so they share one pipelined write.
+// Keeps per-unit order while different units run in parallel. Caller holds lock.
+static int take_batch(cmd_job_t* batch) {
+    int n = 0;
+    uint32_t ip = 0;
+    for (int i = 0; i < job_count && n < SEND_CMD_PIPELINE_MAX; ) {
+        if (n == 0 && ip_busy(jobs[i].ip)) {
+            ++i;
+            continue;
+        }
+        if (n > 0 && jobs[i].ip != ip) {
+            ++i;
+            continue;
+        }
+        ip = jobs[i].ip;
+        batch[n++] = jobs[i];
+        memmove(&jobs[i], &jobs[i + 1], (job_count - i - 1) * sizeof(cmd_job_t));
+        job_count--;
+    }
+    return n;
+}
+
+static void run_batch(cmd_job_t* batch, int n) {
+    send_cmd_req_t reqs[SEND_CMD_PIPELINE_MAX];
+    cmd_job_t* live[SEND_CMD_PIPELINE_MAX];
+    int count = 0;
+    Uint32 now = SDL_GetTicks();
+    Uint32 deadline = now;
+
+    for (int i = 0; i < n; ++i) {
+        if (SDL_TICKS_PASSED(now, batch[i].deadline)) {
+            post_result(&batch[i], NULL, true);
+            continue;
+        }
+        // The batch shares one connection, so it runs to the latest deadline
+        if (count == 0 || !SDL_TICKS_PASSED(deadline, batch[i].deadline))
+            deadline = batch[i].deadline;
+        reqs[count].cmd_hex = batch[i].cmd;
+        reqs[count].hex_arg = batch[i].param[0] ? batch[i].param : NULL;
+        live[count++] = &batch[i];
+    }
+    if (count == 0) return;
+
+    char ipstr[16];
+    format_ip(batch[0].ip, ipstr, sizeof(ipstr));
+    send_cmd_pipeline(ipstr, reqs, count, deadline - now);
+
+    bool expired = SDL_TICKS_PASSED(SDL_GetTicks(), deadline);
+    for (int i = 0; i < count; ++i)
+        post_result(live[i], &reqs[i], !reqs[i].ok && expired);
+}
+
+static int worker_func(void* data) {
+    int self = (int)(intptr_t)data;
+    cmd_job_t batch[SEND_CMD_PIPELINE_MAX];
+    while (1) {
+        SDL_LockMutex(lock);
+        int n = 0;
+        while (running && (n = take_batch(batch)) == 0) {
+            // Idle: close keep-alive connections nobody has used for a while
+            if (SDL_CondWaitTimeout(wake, lock, SEND_CMD_IDLE_MS) == SDL_MUTEX_TIMEDOUT && self == 0) {
+                SDL_UnlockMutex(lock);
+                send_cmd_pool_evict_idle();
+                SDL_LockMutex(lock);
+            }
+        }
+        if (!running) {
+            SDL_UnlockMutex(lock);
+            break;
+        }
+        busy_ip[self] = batch[0].ip;
+        SDL_UnlockMutex(lock);
+
+        run_batch(batch, n);
+
+        // Jobs for this unit may have been skipped while it was busy
+        SDL_LockMutex(lock);
+        busy_ip[self] = 0;
+        if (job_count > 0) SDL_CondBroadcast(wake);
+        SDL_UnlockMutex(lock);
+    }
+    return 0;
+}
+
+static bool register_event_type(void) {
+    if (event_type) return true;
+    event_type = SDL_RegisterEvents(1);
+    if (event_type == (Uint32)-1) {
+        event_type = 0;
+        debugPrint("[cmd_queue] No free SDL event type\n");
+        return false;
+    }
+    return true;
+}
+
+bool cmd_queue_start(void) {
+    if (running) return true;
+    if (!register_event_type()) return false;
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    if (!lock || !wake) {
+        cmd_queue_stop();
+        return false;
+    }
+    job_count = 0;
+    memset(busy_ip, 0, sizeof(busy_ip));
+    running = 1;
+    for (int i = 0; i < CMD_QUEUE_WORKERS; ++i) {
+        workers[i] = SDL_CreateThread(worker_func, "cmd_queue", (void*)(intptr_t)i);
+        if (!workers[i]) {
+            debugPrint("[cmd_queue] Worker thread failed: %s\n", SDL_GetError());
+            cmd_queue_stop();
+            return false;
+        }
+    }
+    return true;
+}
+
+void cmd_queue_stop(void) {
+    if (lock) {
+        SDL_LockMutex(lock);
+        running = 0;
+        SDL_CondBroadcast(wake);
+        SDL_UnlockMutex(lock);
+    }
+    running = 0;
+    for (int i = 0; i < CMD_QUEUE_WORKERS; ++i) {
+        if (workers[i]) {
+            SDL_WaitThread(workers[i], NULL);
+            workers[i] = NULL;
+        }
+    }
+    send_cmd_pool_flush();
+
+    // Group completions still referenced by dropped jobs
+    for (int i = 0; i < job_count; ++i) {
+        cmd_group_t* g = jobs[i].group;
+        if (!g) continue;
+        for (int j = i + 1; j < job_count; ++j) {
+            if (jobs[j].group == g) jobs[j].group = NULL;
+        }
+        mem_free(g);
+    }
+    job_count = 0;
+
+    if (wake) SDL_DestroyCond(wake);
+    if (lock) SDL_DestroyMutex(lock);
+    wake = NULL;
+    lock = NULL;
+}
+
+// Caller holds lock and has checked there is room
+static void enqueue_locked(uint32_t ip, const char* cmd_code, const char* param, Uint32 now,
+                           unsigned int timeout_ms, int tag, uint64_t input_us, cmd_group_t* group, int slot) {
+    cmd_job_t* job = &jobs[job_count++];
+    memset(job, 0, sizeof(*job));
+    job->ip = ip;
+    strncpy(job->cmd, cmd_code, sizeof(job->cmd) - 1);
+    if (param) strncpy(job->param, param, sizeof(job->param) - 1);
+    job->tag = tag;
+    job->submitted = now;
+    job->deadline = now + timeout_ms;
+    job->input_us = input_us;
+    job->group = group;
+    job->group_slot = slot;
+}
+
+bool cmd_queue_submit(uint32_t ip, const char* cmd_code, const char* param, unsigned int timeout_ms, int tag,
+                      uint64_t input_us) {
+    if (!lock || !cmd_code) return false;
+
+    SDL_LockMutex(lock);
+    if (!running || job_count == CMD_QUEUE_DEPTH) {
+        SDL_UnlockMutex(lock);
+        return false;
+    }
+    enqueue_locked(ip, cmd_code, param, SDL_GetTicks(), timeout_ms, tag, input_us, NULL, 0);
+    SDL_CondSignal(wake);
+    SDL_UnlockMutex(lock);
+    return true;
+}
+
+bool cmd_queue_submit_group(const uint32_t* ips, int count, const char* cmd_code, const char* param,
+                            unsigned int timeout_ms, int tag, uint64_t input_us) {
+    if (!lock || !cmd_code || !ips || count <= 0 || count > CMD_GROUP_MAX) return false;
+
+    cmd_group_t* group = (cmd_group_t*)mem_calloc(MEM_NET, 1, sizeof(cmd_group_t));
+    if (!group) return false;
+    strncpy(group->res.cmd, cmd_code, sizeof(group->res.cmd) - 1);
+    group->res.tag = tag;
+    group->res.unit_count = count;
+    group->outstanding = count;
+
+    SDL_LockMutex(lock);
+    if (!running || job_count + count > CMD_QUEUE_DEPTH) {
+        SDL_UnlockMutex(lock);
+        mem_free(group);
+        return false;
+    }
+    Uint32 now = SDL_GetTicks();
+    for (int i = 0; i < count; ++i)
+        enqueue_locked(ips[i], cmd_code, param, now, timeout_ms, tag, input_us, group, i);
+    SDL_CondBroadcast(wake);
+    SDL_UnlockMutex(lock);
+    return true;
+}
+
+bool cmd_queue_post(const cmd_result_t* res) {
+    if (!res || !register_event_type()) return false;
+    cmd_result_t* copy = (cmd_result_t*)mem_calloc(MEM_NET, 1, sizeof(cmd_result_t));
+    if (!copy) return false;
+    *copy = *res;
+    push_result(copy);
+    return true;
+}
+
+Uint32 cmd_queue_event_type(void) {
+    return event_type;
+}
+
+const cmd_result_t* cmd_queue_result(const SDL_Event* e) {
+    if (!event_type || e->type != event_type) return NULL;
+    return (const cmd_result_t*)e->user.data1;
+}
+
+void cmd_queue_release(const SDL_Event* e) {
+    if (cmd_queue_result(e))
+        mem_free(e->user.data1);
+}
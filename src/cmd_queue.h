@@ -0,0 +1,108 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+
+#define CMD_QUEUE_DEPTH     32      // Pending commands before submit is refused
+#define CMD_GROUP_MAX       16      // Units in one group command
+#define CMD_QUEUE_WORKERS   CMD_GROUP_MAX   // Units served in parallel: a whole group at once
+#define CMD_CODE_MAX        8
+#define CMD_PARAM_MAX       64
+
+// Outcome for one unit
+typedef struct {
+    uint32_t ip;                    // Target IPv4 address (host order)
+    bool     ok;
+    bool     timed_out;             // Deadline passed before or during the send
+    uint32_t elapsed_ms;            // Submit to completion
+    uint32_t wire_us;               // Input to request written, 0 without an input time or if never sent
+    uint32_t ack_us;                // Input to response parsed, 0 without an input time or if none came
+} cmd_unit_result_t;
+
+// Completion posted to the main loop as an SDL user event (event.user.data1)
+typedef struct {
+    uint32_t ip;                    // Target IPv4 address (host order), 0 for a group
+    char     cmd[CMD_CODE_MAX];
+    int      tag;                   // Caller cookie from cmd_queue_submit()
+    bool     ok;                    // For a group: every unit succeeded
+    bool     timed_out;
+    uint32_t elapsed_ms;            // For a group: until the slowest unit finished
+    uint32_t wire_us;               // As in cmd_unit_result_t; for a group the slowest unit
+    uint32_t ack_us;
+    int      unit_count;            // 0 for a single command, else entries in units[]
+    int      ok_count;
+    cmd_unit_result_t units[CMD_GROUP_MAX];
+} cmd_result_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts the command worker threads and registers the completion event type.
+ *
+ * @return true if the worker is running
+ */
+bool cmd_queue_start(void);
+
+/**
+ * Stops the workers. Commands still queued are dropped without a completion.
+ */
+void cmd_queue_stop(void);
+
+/**
+ * Queues a command for the unit at ip. Never blocks.
+ *
+ * @param ip         Target IPv4 address (host order, as in type_d_unit_t)
+ * @param cmd_code   Command code, e.g. "0001"
+ * @param param      Optional query parameter, or NULL
+ * @param timeout_ms Deadline measured from now; covers queueing, connect and send
+ * @param tag        Returned untouched in the completion
+ * @param input_us   telemetry_now_us() of the controller event behind the
+ *                   command, or 0; input-to-wire and input-to-ack latencies
+ *                   are measured from it
+ * @return           false if the queue is full or not running
+ */
+bool cmd_queue_submit(uint32_t ip, const char* cmd_code, const char* param, unsigned int timeout_ms, int tag,
+                      uint64_t input_us);
+
+/**
+ * Queues the same command for several units at once. Workers send to them in
+ * parallel and a single completion carrying every unit's outcome is posted
+ * when the last one finishes.
+ *
+ * @param ips        Target IPv4 addresses (host order)
+ * @param count      Number of targets (at most CMD_GROUP_MAX)
+ * @return           false if the queue cannot take every target
+ */
+bool cmd_queue_submit_group(const uint32_t* ips, int count, const char* cmd_code, const char* param,
+                            unsigned int timeout_ms, int tag, uint64_t input_us);
+
+/**
+ * Posts a completion as if a worker had finished it, without sending
+ * anything; the host replay feeds recorded outcomes through here. Works
+ * without cmd_queue_start().
+ *
+ * @return false if the event could not be allocated
+ */
+bool cmd_queue_post(const cmd_result_t* res);
+
+/**
+ * @return SDL event type used for completions (0 before cmd_queue_start)
+ */
+Uint32 cmd_queue_event_type(void);
+
+/**
+ * Returns the completion carried by an event of cmd_queue_event_type(), or NULL.
+ * The result must be released with cmd_queue_release().
+ */
+const cmd_result_t* cmd_queue_result(const SDL_Event* e);
+
+/**
+ * Frees the completion attached to an event.
+ */
+void cmd_queue_release(const SDL_Event* e);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,458 @@
+#include "compose.h"
+#include <string.h>
+#include <hal/debug.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__MMX__) && defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+typedef struct {
+    // dst = src + dst * (255 - src.a) / 255 for n pixels, src premultiplied
+    void (*over)(uint32_t* dst, const uint32_t* src, int n);
+    // The same with one premultiplied pixel and its inverse alpha
+    void (*fill)(uint32_t* dst, uint32_t src, uint32_t inv_alpha, int n);
+} comp_kernels_t;
+
+static const char* const backend_names[COMP_BACKEND_COUNT] = {"scalar", "MMX", "SSE2"};
+
+// x / 255 rounded to nearest, exact for x <= 255 * 255
+static inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// ---- Scalar -------------------------------------------------------------
+
+// Two channels per multiply: each 16-bit lane holds one channel times
+// inv_alpha, which never carries into the next lane
+static inline uint32_t over_px(uint32_t s, uint32_t d, uint32_t ia) {
+    uint32_t rb = (d & 0x00FF00FF) * ia + 0x00800080;
+    uint32_t ag = ((d >> 8) & 0x00FF00FF) * ia + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    // Premultiplied, so no channel can pass 255
+    return s + rb + ag;
+}
+
+static void scalar_over(uint32_t* d, const uint32_t* s, int n) {
+    for (int i = 0; i < n; ++i) {
+        uint32_t a = s[i] >> 24;
+        if (a == 255)
+            d[i] = s[i];
+        else if (s[i])
+            d[i] = over_px(s[i], d[i], 255 - a);
+    }
+}
+
+static void scalar_fill(uint32_t* d, uint32_t s, uint32_t ia, int n) {
+    for (int i = 0; i < n; ++i)
+        d[i] = over_px(s, d[i], ia);
+}
+
+// ---- MMX ----------------------------------------------------------------
+// The console's Pentium III has SSE but not SSE2, so its integer SIMD is
+// MMX plus the few integer instructions SSE added to it (pshufw here).
+
+#if defined(__MMX__) && defined(__SSE__)
+static inline __m64 mmx_div255(__m64 x) {
+    x = _mm_add_pi16(x, _mm_set1_pi16(128));
+    return _mm_srli_pi16(_mm_add_pi16(x, _mm_srli_pi16(x, 8)), 8);
+}
+
+static void mmx_over(uint32_t* d, const uint32_t* s, int n) {
+    const __m64 zero = _mm_setzero_si64();
+    const __m64 c255 = _mm_set1_pi16(255);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        // Clear and opaque pairs are decided without leaving the integer unit
+        if ((s[i] | s[i + 1]) == 0) continue;
+        if ((s[i] & s[i + 1]) >= 0xFF000000) {
+            d[i] = s[i];
+            d[i + 1] = s[i + 1];
+            continue;
+        }
+        __m64 sv, dv;
+        memcpy(&sv, s + i, sizeof(sv));
+        memcpy(&dv, d + i, sizeof(dv));
+        __m64 ia_lo = _mm_sub_pi16(c255, _mm_shuffle_pi16(_mm_unpacklo_pi8(sv, zero), 0xFF));
+        __m64 ia_hi = _mm_sub_pi16(c255, _mm_shuffle_pi16(_mm_unpackhi_pi8(sv, zero), 0xFF));
+        __m64 lo = mmx_div255(_mm_mullo_pi16(_mm_unpacklo_pi8(dv, zero), ia_lo));
+        __m64 hi = mmx_div255(_mm_mullo_pi16(_mm_unpackhi_pi8(dv, zero), ia_hi));
+        __m64 out = _mm_adds_pu8(_mm_packs_pu16(lo, hi), sv);
+        memcpy(d + i, &out, sizeof(out));
+    }
+    _mm_empty();
+    scalar_over(d + i, s + i, n - i);
+}
+
+static void mmx_fill(uint32_t* d, uint32_t s, uint32_t ia, int n) {
+    const __m64 zero = _mm_setzero_si64();
+    const __m64 sv = _mm_set1_pi32((int)s);
+    const __m64 iav = _mm_set1_pi16((short)ia);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m64 dv;
+        memcpy(&dv, d + i, sizeof(dv));
+        __m64 lo = mmx_div255(_mm_mullo_pi16(_mm_unpacklo_pi8(dv, zero), iav));
+        __m64 hi = mmx_div255(_mm_mullo_pi16(_mm_unpackhi_pi8(dv, zero), iav));
+        __m64 out = _mm_adds_pu8(_mm_packs_pu16(lo, hi), sv);
+        memcpy(d + i, &out, sizeof(out));
+    }
+    _mm_empty();
+    scalar_fill(d + i, s, ia, n - i);
+}
+#define MMX_KERNELS {mmx_over, mmx_fill}
+#else
+#define MMX_KERNELS {NULL, NULL}
+#endif
+
+// ---- SSE2 ---------------------------------------------------------------
+
+#if defined(__SSE2__)
+static inline __m128i sse2_div255(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Inverse alpha of two unpacked pixels, broadcast to their four channels
+static inline __m128i sse2_inv_alpha(__m128i px16) {
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px16, 0xFF), 0xFF);
+    return _mm_sub_epi16(_mm_set1_epi16(255), a);
+}
+
+static void sse2_over(uint32_t* d, const uint32_t* s, int n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int)0xFF000000);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i sv = _mm_loadu_si128((const __m128i*)(s + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sv, zero)) == 0xFFFF) continue;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(sv, amask), amask)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i*)(d + i), sv);
+            continue;
+        }
+        __m128i dv = _mm_loadu_si128((const __m128i*)(d + i));
+        __m128i ia_lo = sse2_inv_alpha(_mm_unpacklo_epi8(sv, zero));
+        __m128i ia_hi = sse2_inv_alpha(_mm_unpackhi_epi8(sv, zero));
+        __m128i lo = sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), ia_lo));
+        __m128i hi = sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), ia_hi));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), sv));
+    }
+    scalar_over(d + i, s + i, n - i);
+}
+
+static void sse2_fill(uint32_t* d, uint32_t s, uint32_t ia, int n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sv = _mm_set1_epi32((int)s);
+    const __m128i iav = _mm_set1_epi16((short)ia);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i dv = _mm_loadu_si128((const __m128i*)(d + i));
+        __m128i lo = sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), iav));
+        __m128i hi = sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), iav));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), sv));
+    }
+    scalar_fill(d + i, s, ia, n - i);
+}
+#define SSE2_KERNELS {sse2_over, sse2_fill}
+#else
+#define SSE2_KERNELS {NULL, NULL}
+#endif
+
+static const comp_kernels_t kernels[COMP_BACKEND_COUNT] = {
+    {scalar_over, scalar_fill},
+    MMX_KERNELS,
+    SSE2_KERNELS
+};
+
+// Set before the asset loader starts and left alone while it runs
+static comp_backend_t current = COMP_SCALAR;
+static bool trusted = true;           // Cleared when output disagrees with SDL's
+
+// ---- Surfaces -----------------------------------------------------------
+
+static inline uint32_t* pixel_at(SDL_Surface* s, int x, int y) {
+    return (uint32_t*)((uint8_t*)s->pixels + (size_t)y * s->pitch) + x;
+}
+
+static bool lock(SDL_Surface* s) {
+    return !SDL_MUSTLOCK(s) || SDL_LockSurface(s) == 0;
+}
+
+static void unlock(SDL_Surface* s) {
+    if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
+}
+
+// rect (NULL: all of s) within the clip rect; false if nothing is left
+static bool clip(const SDL_Surface* s, const SDL_Rect* rect, SDL_Rect* out) {
+    SDL_Rect full = rect ? *rect : (SDL_Rect){0, 0, s->w, s->h};
+    return SDL_IntersectRect(&full, &s->clip_rect, out) == SDL_TRUE;
+}
+
+static uint32_t premultiplied(SDL_Color c) {
+    return (uint32_t)c.a << 24 | div255(c.r * c.a) << 16 | div255(c.g * c.a) << 8 | div255(c.b * c.a);
+}
+
+bool comp_supported(const SDL_Surface* s) {
+    const SDL_PixelFormat* f = s ? s->format : NULL;
+    return trusted && f && f->BytesPerPixel == 4 &&
+           f->Rmask == 0x00FF0000 && f->Gmask == 0x0000FF00 && f->Bmask == 0x000000FF &&
+           (f->Amask == 0 || f->Amask == 0xFF000000);
+}
+
+bool comp_fill(SDL_Surface* dst, const SDL_Rect* rect, SDL_Color c) {
+    if (!comp_supported(dst)) return false;
+    SDL_Rect r;
+    if (c.a == 0 || !clip(dst, rect, &r)) return true;
+    if (!lock(dst)) return false;
+    uint32_t px = premultiplied(c);
+    for (int y = r.y; y < r.y + r.h; ++y) {
+        uint32_t* row = pixel_at(dst, r.x, y);
+        if (c.a == 255) {
+            for (int x = 0; x < r.w; ++x) row[x] = px;
+        } else {
+            kernels[current].fill(row, px, 255 - c.a, r.w);
+        }
+    }
+    unlock(dst);
+    return true;
+}
+
+bool comp_premultiply(SDL_Surface* s) {
+    if (!comp_supported(s)) return false;
+    if (!lock(s)) return false;
+    for (int y = 0; y < s->h; ++y) {
+        uint32_t* row = pixel_at(s, 0, y);
+        for (int x = 0; x < s->w; ++x) {
+            uint32_t p = row[x], a = p >> 24;
+            if (a == 255) continue;
+            row[x] = a << 24 | div255(((p >> 16) & 0xFF) * a) << 16 |
+                     div255(((p >> 8) & 0xFF) * a) << 8 | div255((p & 0xFF) * a);
+        }
+    }
+    unlock(s);
+    return true;
+}
+
+bool comp_blit(SDL_Surface* src, SDL_Surface* dst, int x, int y) {
+    if (!comp_supported(src) || !comp_supported(dst)) return false;
+    SDL_Rect r, at = {x, y, src->w, src->h};
+    if (!clip(dst, &at, &r)) return true;
+    if (!lock(src)) return false;
+    if (!lock(dst)) {
+        unlock(src);
+        return false;
+    }
+    for (int row = 0; row < r.h; ++row)
+        kernels[current].over(pixel_at(dst, r.x, r.y + row), pixel_at(src, r.x - x, r.y - y + row), r.w);
+    unlock(dst);
+    unlock(src);
+    return true;
+}
+
+bool comp_blit_scaled(SDL_Surface* src, SDL_Surface* dst, const SDL_Rect* dstrect, bool blend) {
+    if (!comp_supported(src) || !comp_supported(dst)) return false;
+    SDL_Rect full = dstrect ? *dstrect : (SDL_Rect){0, 0, dst->w, dst->h};
+    SDL_Rect r;
+    if (src->w <= 0 || src->h <= 0 || !clip(dst, &full, &r)) return true;
+
+    // Blended rows are sampled into a line buffer first
+    uint32_t* line = blend ? SDL_malloc((size_t)r.w * sizeof(uint32_t)) : NULL;
+    if (blend && !line) return false;
+    if (!lock(src)) {
+        SDL_free(line);
+        return false;
+    }
+    if (!lock(dst)) {
+        unlock(src);
+        SDL_free(line);
+        return false;
+    }
+
+    // 16.16 steps through the source, sampling at destination pixel centres
+    uint32_t step_x = (uint32_t)(((uint64_t)src->w << 16) / (uint32_t)full.w);
+    uint32_t step_y = (uint32_t)(((uint64_t)src->h << 16) / (uint32_t)full.h);
+    uint32_t x0 = (uint32_t)((uint64_t)(r.x - full.x) * step_x + step_x / 2);
+    int prev_sy = -1;
+    for (int y = r.y; y < r.y + r.h; ++y) {
+        int sy = (int)(((uint64_t)(y - full.y) * step_y + step_y / 2) >> 16);
+        uint32_t* out = pixel_at(dst, r.x, y);
+        if (sy == prev_sy && !blend) {
+            memcpy(out, pixel_at(dst, r.x, y - 1), (size_t)r.w * sizeof(uint32_t));
+            continue;
+        }
+        if (sy != prev_sy) {
+            const uint32_t* in = pixel_at(src, 0, sy);
+            uint32_t* to = blend ? line : out;
+            uint32_t pos = x0;
+            for (int x = 0; x < r.w; ++x, pos += step_x)
+                to[x] = in[pos >> 16];
+            prev_sy = sy;
+        }
+        if (blend) kernels[current].over(out, line, r.w);
+    }
+
+    unlock(dst);
+    unlock(src);
+    SDL_free(line);
+    return true;
+}
+
+// ---- Backend choice and self-check --------------------------------------
+
+// Deterministic noise, so a failing check can be reproduced
+static uint32_t check_rand(uint32_t* seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+// Valid premultiplied pixel, with clear and opaque ones common enough to
+// take the kernels' shortcuts
+static uint32_t check_premultiplied(uint32_t* seed) {
+    uint32_t pick = check_rand(seed) & 3;
+    uint32_t a = pick == 0 ? 0 : pick == 1 ? 255 : check_rand(seed) & 0xFF;
+    uint32_t px = a << 24;
+    for (int shift = 0; shift < 24; shift += 8)
+        px |= (check_rand(seed) % (a + 1)) << shift;
+    return px;
+}
+
+// Bit for bit against the scalar kernels, at every tail length
+static bool check_kernels(void) {
+    if (current == COMP_SCALAR) return true;
+    uint32_t src[COMP_CHECK_W], want[COMP_CHECK_W], got[COMP_CHECK_W];
+    uint32_t seed = 1;
+    for (int row = 0; row < COMP_CHECK_H; ++row) {
+        int n = COMP_CHECK_W - row;
+        for (int i = 0; i < COMP_CHECK_W; ++i) {
+            src[i] = check_premultiplied(&seed);
+            want[i] = got[i] = check_rand(&seed) ^ (check_rand(&seed) << 8);
+        }
+        kernels[COMP_SCALAR].over(want, src, n);
+        kernels[current].over(got, src, n);
+        if (memcmp(want, got, sizeof(want)) != 0) return false;
+
+        SDL_Color c = {(Uint8)check_rand(&seed), (Uint8)check_rand(&seed),
+                       (Uint8)check_rand(&seed), (Uint8)check_rand(&seed)};
+        kernels[COMP_SCALAR].fill(want, premultiplied(c), 255 - c.a, n);
+        kernels[current].fill(got, premultiplied(c), 255 - c.a, n);
+        if (memcmp(want, got, sizeof(want)) != 0) return false;
+    }
+    return true;
+}
+
+// Colour channels of two XRGB8888 surfaces of the same size
+static bool check_close(SDL_Surface* a, SDL_Surface* b) {
+    for (int y = 0; y < a->h; ++y) {
+        const uint32_t* pa = pixel_at(a, 0, y);
+        const uint32_t* pb = pixel_at(b, 0, y);
+        for (int x = 0; x < a->w; ++x) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                int d = (int)((pa[x] >> shift) & 0xFF) - (int)((pb[x] >> shift) & 0xFF);
+                if (d > COMP_CHECK_TOLERANCE || d < -COMP_CHECK_TOLERANCE) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// A fill and a straight-alpha blit onto a noisy screen, done by SDL and by us
+static bool check_against_sdl(void) {
+    SDL_Surface* ours = SDL_CreateRGBSurfaceWithFormat(0, COMP_CHECK_W, COMP_CHECK_H, 32, SDL_PIXELFORMAT_RGB888);
+    SDL_Surface* theirs = SDL_CreateRGBSurfaceWithFormat(0, COMP_CHECK_W, COMP_CHECK_H, 32, SDL_PIXELFORMAT_RGB888);
+    SDL_Surface* src = SDL_CreateRGBSurfaceWithFormat(0, COMP_CHECK_W, COMP_CHECK_H, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Surface* premul = NULL;
+    SDL_Renderer* r = theirs ? SDL_CreateSoftwareRenderer(theirs) : NULL;
+    bool ok = false;
+    if (!ours || !theirs || !src || !r || SDL_MUSTLOCK(ours) || SDL_MUSTLOCK(theirs) || SDL_MUSTLOCK(src))
+        goto done;
+
+    uint32_t seed = 7;
+    for (int y = 0; y < COMP_CHECK_H; ++y) {
+        for (int x = 0; x < COMP_CHECK_W; ++x) {
+            *pixel_at(ours, x, y) = *pixel_at(theirs, x, y) = check_rand(&seed) & 0x00FFFFFF;
+            *pixel_at(src, x, y) = check_rand(&seed) ^ (check_rand(&seed) << 8);
+        }
+    }
+
+    // The overlay panel's fill
+    SDL_Color c = {200, 120, 40, 180};
+    comp_fill(ours, NULL, c);
+    SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(r, c.r, c.g, c.b, c.a);
+    SDL_RenderFillRect(r, NULL);
+    SDL_RenderPresent(r);     // Flushes the software renderer's command queue
+    if (!check_close(ours, theirs)) goto done;
+
+    // Text and sprites are straight alpha until comp_premultiply()
+    premul = SDL_ConvertSurface(src, src->format, 0);
+    if (!premul) goto done;
+    comp_premultiply(premul);
+    comp_blit(premul, ours, 0, 0);
+    SDL_SetSurfaceBlendMode(src, SDL_BLENDMODE_BLEND);
+    if (SDL_BlitSurface(src, NULL, theirs, NULL) != 0) goto done;
+    ok = check_close(ours, theirs);
+
+done:
+    if (r) SDL_DestroyRenderer(r);
+    if (premul) SDL_FreeSurface(premul);
+    if (src) SDL_FreeSurface(src);
+    if (theirs) SDL_FreeSurface(theirs);
+    if (ours) SDL_FreeSurface(ours);
+    return ok;
+}
+
+bool comp_init(void) {
+    current = COMP_SCALAR;
+    for (int b = COMP_BACKEND_COUNT - 1; b > COMP_SCALAR; --b) {
+        if (comp_backend_available((comp_backend_t)b)) {
+            current = (comp_backend_t)b;
+            break;
+        }
+    }
+    trusted = true;
+    bool ok = comp_self_check();
+    if (!ok && current != COMP_SCALAR && !check_kernels()) {
+        debugPrint("[compose] %s kernels disagree with scalar\n", backend_names[current]);
+        current = COMP_SCALAR;
+        ok = comp_self_check();
+    }
+    if (!ok) {
+        // Callers see every surface as unsupported and keep to SDL's blitters
+        debugPrint("[compose] Output differs from SDL's, compositor disabled\n");
+        trusted = false;
+    } else {
+        debugPrint("[compose] %s kernels\n", backend_names[current]);
+    }
+    return ok;
+}
+
+bool comp_self_check(void) {
+    return check_kernels() && check_against_sdl();
+}
+
+comp_backend_t comp_backend(void) {
+    return current;
+}
+
+const char* comp_backend_name(comp_backend_t b) {
+    return b < COMP_BACKEND_COUNT ? backend_names[b] : "?";
+}
+
+bool comp_backend_available(comp_backend_t b) {
+    switch (b) {
+    case COMP_SCALAR: return true;
+    case COMP_MMX:    return kernels[b].over && SDL_HasMMX() && SDL_HasSSE();
+    case COMP_SSE2:   return kernels[b].over && SDL_HasSSE2();
+    default:          return false;
+    }
+}
+
+bool comp_set_backend(comp_backend_t b) {
+    if (!comp_backend_available(b)) return false;
+    current = b;
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+
+#define COMP_CHECK_W         67       // Self-check surface; odd so every kernel has a tail
+#define COMP_CHECK_H         9
+#define COMP_CHECK_TOLERANCE 3        // Per channel against SDL, which rounds with >> 8 and truncates
+
+// Software compositing on 32 bpp surfaces with alpha in the top byte and
+// red, green, blue below it (ARGB8888, XRGB8888). Sources for comp_blit()
+// and blended comp_blit_scaled() are premultiplied: every colour channel is
+// already scaled by alpha, so a pixel lands as
+//
+//   dst = src + dst * (255 - src.a) / 255
+//
+// rounded to nearest. comp_fill() does the same with a straight-alpha colour,
+// which is what SDL_RenderFillRect does under SDL_BLENDMODE_BLEND.
+
+typedef enum {
+    COMP_SCALAR = 0,
+    COMP_MMX,                         // MMX with the SSE integer extensions (pshufw), 2 pixels a step
+    COMP_SSE2,                        // 4 pixels a step
+    COMP_BACKEND_COUNT
+} comp_backend_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Picks the widest kernels the build and CPU support and checks them against
+ * the scalar ones and against SDL's own blending. Until this is called the
+ * scalar kernels are used, and SIMD kernels that disagree with them are
+ * dropped. If the output still differs from SDL's, comp_supported() turns
+ * every surface down from then on and callers keep to the SDL path.
+ *
+ * @return false if the self-check failed
+ */
+bool comp_init(void);
+
+comp_backend_t comp_backend(void);
+const char* comp_backend_name(comp_backend_t b);
+
+/**
+ * @return true if b was compiled in and the CPU can run it
+ */
+bool comp_backend_available(comp_backend_t b);
+
+/**
+ * Switches kernels, for the bench. Does not re-run the self-check.
+ *
+ * @return false if b is not available
+ */
+bool comp_set_backend(comp_backend_t b);
+
+/**
+ * Compares the current kernels bit for bit against the scalar ones, and the
+ * fill and blit against SDL_RenderFillRect and SDL_BlitSurface within
+ * COMP_CHECK_TOLERANCE.
+ */
+bool comp_self_check(void);
+
+/**
+ * @return true if s has a layout the kernels handle
+ */
+bool comp_supported(const SDL_Surface* s);
+
+/**
+ * Blends a straight-alpha colour over a rect of dst, clipped to its clip rect.
+ *
+ * @param rect Area to fill, NULL for the whole surface
+ * @return false if dst is not supported
+ */
+bool comp_fill(SDL_Surface* dst, const SDL_Rect* rect, SDL_Color c);
+
+/**
+ * Scales the colour channels of s by its alpha in place.
+ */
+bool comp_premultiply(SDL_Surface* s);
+
+/**
+ * Blends all of a premultiplied src onto dst with its top left at x, y,
+ * clipped to dst's clip rect.
+ */
+bool comp_blit(SDL_Surface* src, SDL_Surface* dst, int x, int y);
+
+/**
+ * Nearest-neighbour scale of all of src into dstrect, clipped to dst's clip
+ * rect. Destination rows that sample the same source row are copied from the
+ * row above.
+ *
+ * @param dstrect Target area, NULL for the whole surface
+ * @param blend   Blend a premultiplied src; false copies it, alpha included
+ */
+bool comp_blit_scaled(SDL_Surface* src, SDL_Surface* dst, const SDL_Rect* dstrect, bool blend);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+#include "damage.h"
+
+static SDL_Rect screen = {0, 0, 0, 0};
+static SDL_Rect rects[DAMAGE_MAX_RECTS];
+static int rect_count = 0;
+
+void damage_init(int screen_w, int screen_h) {
+    screen = (SDL_Rect){0, 0, screen_w, screen_h};
+    damage_add_all();
+}
+
+void damage_add_all(void) {
+    rects[0] = screen;
+    rect_count = 1;
+}
+
+void damage_add(SDL_Rect rc) {
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(&rc, &screen, &clipped)) return;
+
+    // Fold into any rect it touches; repeat since the union can reach others
+    for (int i = 0; i < rect_count; ++i) {
+        if (SDL_HasIntersection(&rects[i], &clipped)) {
+            SDL_UnionRect(&rects[i], &clipped, &clipped);
+            rects[i] = rects[--rect_count];
+            i = -1;
+        }
+    }
+
+    if (rect_count == DAMAGE_MAX_RECTS) {
+        for (int i = 0; i < rect_count; ++i)
+            SDL_UnionRect(&rects[i], &clipped, &clipped);
+        rect_count = 0;
+    }
+    rects[rect_count++] = clipped;
+}
+
+bool damage_pending(void) {
+    return rect_count > 0;
+}
+
+const SDL_Rect* damage_rects(int* count) {
+    if (count) *count = rect_count;
+    return rects;
+}
+
+void damage_clear(void) {
+    rect_count = 0;
+}
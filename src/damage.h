@@ -0,0 +1,45 @@
+#pragma once
+#include <stdbool.h>
+#include <SDL.h>
+
+#define DAMAGE_MAX_RECTS 16   // Beyond this, rects are merged into their bounding box
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets the screen bounds dirty rects are clipped to and marks the whole screen dirty.
+ */
+void damage_init(int screen_w, int screen_h);
+
+/**
+ * Marks a region dirty. Overlapping regions are merged.
+ */
+void damage_add(SDL_Rect rc);
+
+/**
+ * Marks the whole screen dirty.
+ */
+void damage_add_all(void);
+
+/**
+ * @return true if anything needs to be redrawn
+ */
+bool damage_pending(void);
+
+/**
+ * Returns the current dirty rects (valid until the next damage_* call).
+ *
+ * @param count Receives the number of rects
+ */
+const SDL_Rect* damage_rects(int* count);
+
+/**
+ * Clears all dirty rects after they have been recomposited and presented.
+ */
+void damage_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,22 +1,99 @@
 #include "detect.h"
+#include "telemetry.h"
+#include "memstat.h"
+#include <stdbool.h>
 #include <lwip/sockets.h>
+#include <lwip/netif.h>
 #include <string.h>
-#include <stdlib.h>
 #include <stdio.h>
 #include <hal/debug.h>
 #include <SDL.h>
 
 #define DETECT_DISCOVER_PORT   50501
 #define DETECT_ANNOUNCE_PORT   50502
-#define DETECT_BROADCAST       "255.255.255.255"
+#ifndef DETECT_BROADCAST
+#define DETECT_BROADCAST       "255.255.255.255"   // Host builds point this at a mock responder
+#endif
 #define DETECT_DISCOVER_MSG    "TYPE_D_DISCOVER?"
 #define DETECT_REPLY_PREFIX    "TYPE_D_ID:"
-#define DETECT_TIMEOUT_MS      5000
+#define DETECT_TIMEOUT_MS      5000   // Drop a unit after this long without a reply
+#define DETECT_PROBE_MIN_MS    100    // Probe interval at boot and after a change
+#define DETECT_PROBE_MAX_MS    4000   // Steady-state interval once the set is stable
+#define DETECT_REPLY_GRACE_MS  250    // Replies to a probe are expected within this
+#define DETECT_WAIT_MAX_MS     250    // Longest select() so detect_stop() is noticed
+#define DETECT_UNICAST_BURST   8      // Unicast probes that may go back to back after an idle spell
+#define DETECT_REPROBE_AFTER_MS 2000  // Silence before a unit that missed a round is re-probed
+#define DETECT_REPROBE_GAP_MS  1000   // Least time between two re-probes of one unit
+#define DETECT_SWEEP_REPEAT_MS 30000  // From the start of one sweep to the next
+#define DETECT_REPLY_LATE_MS   1000   // Oldest probe round a late reply is still credited to
+#define DETECT_ROUND_HISTORY   16     // Probe rounds whose send times are kept
 
-static type_d_unit_t units[TYPE_D_MAX_UNITS];
+// Open-addressing index from IP to unit position, linear probing.
+// Slots hold position + 1 so zero means empty; kept at most half full.
+typedef struct {
+    int32_t *slots;
+    int      bits;
+} ip_index_t;
+
+struct detect_snapshot {
+    SDL_atomic_t  refs;
+    uint32_t      generation;
+    int           count;
+    int           id_start[257];   // Units with ID i are [id_start[i], id_start[i+1])
+    ip_index_t    index;
+    type_d_unit_t units[];         // Sorted by ID, then IP
+};
+
+// Working registry, owned by the detect thread
+static type_d_unit_t *units = NULL;
 static int unit_count = 0;
+static int unit_cap = 0;
+static ip_index_t unit_index = {NULL, 0};
 static int running = 0;
 static SDL_Thread *detect_thread = NULL;
+static uint32_t probe_seq = 0;        // Latest probe round, for telemetry
+static uint32_t round_sent_us[DETECT_ROUND_HISTORY];   // Broadcast time of each recent round, by sequence
+
+// Probe state shared by the strategies, owned by the detect thread
+typedef struct {
+    int      sock;
+    uint32_t now;                     // SDL_GetTicks() of this pass of the loop
+    uint32_t round;                   // Start of the latest probe round
+    uint32_t local_ip, netmask;       // Host order; 0 until the interface has an address
+    int      tokens;                  // Unicast budget, in thousandths of a probe
+    int      reprobe_pos;             // Next unit to consider for a re-probe, -1 when done
+    uint32_t reprobe_at;              // When this round's broadcast replies are in
+    uint32_t reprobe_round;           // Round the current walk started in
+    uint32_t reprobe_done;            // When the latest walk over the units finished
+    uint32_t sweep_base;              // Network address of the /24 being swept
+    uint32_t sweep_host;              // Next host part to probe, 0 when no sweep is running
+    uint32_t sweep_next;              // Start of the next sweep
+    uint32_t sweep_sent_us[256];      // By host part, as in type_d_unit_t.unicast_us
+    uint32_t sweep_seq[256];          // Probe round of each, as in type_d_unit_t.unicast_seq
+} probe_ctx_t;
+
+typedef struct {
+    // Called at the start of every probe round; may be NULL
+    void (*round)(probe_ctx_t *c);
+    // Sends paced unicast probes while c->tokens last; true if more are
+    // waiting for budget. May be NULL.
+    bool (*pump)(probe_ctx_t *c);
+} strategy_ops_t;
+
+static const char *const strategy_names[DETECT_STRATEGY_COUNT] = {
+    "limited broadcast", "subnet broadcast", "unicast re-probe", "unicast sweep"
+};
+static SDL_atomic_t strategy_mask = {DETECT_STRATEGIES_ALL};
+static SDL_atomic_t unicast_pps = {DETECT_UNICAST_PPS};
+static SDL_atomic_t strategy_sent[DETECT_STRATEGY_COUNT];
+static SDL_atomic_t sweep_passes;
+
+// Latest snapshot; swapped and referenced under snap_lock so a reader never
+// takes a reference to one that is being freed
+static detect_snapshot_t *current = NULL;
+static SDL_SpinLock snap_lock = 0;
+static SDL_atomic_t generation;
+static Uint32 event_type = 0;
 
 // Utility: IP to string (host order)
 const char *detect_ipstr(uint32_t ip) {
@@ -30,35 +107,493 @@ const char *detect_ipstr(uint32_t ip) {
     return buf;
 }
 
-static void add_or_update_unit(uint32_t ip, uint8_t id) {
-    // Update existing or add new unit
+static uint32_t ip_hash(uint32_t ip, int bits) {
+    return (ip * 0x9E3779B1u) >> (32 - bits);   // Fibonacci hashing, top bits
+}
+
+// Smallest table that keeps count entries at most half full
+static int index_bits_for(int count) {
+    int bits = 4;
+    while ((1 << bits) < count * 2) bits++;
+    return bits;
+}
+
+static int index_find(const ip_index_t *x, const type_d_unit_t *list, uint32_t ip) {
+    if (!x->slots) return -1;
+    uint32_t mask = (1u << x->bits) - 1;
+    for (uint32_t h = ip_hash(ip, x->bits); ; h = (h + 1) & mask) {
+        int32_t v = x->slots[h];
+        if (v == 0) return -1;
+        if (list[v - 1].ip == ip) return v - 1;
+    }
+}
+
+static void index_put(ip_index_t *x, const type_d_unit_t *list, int pos) {
+    uint32_t mask = (1u << x->bits) - 1;
+    uint32_t h = ip_hash(list[pos].ip, x->bits);
+    while (x->slots[h] != 0) h = (h + 1) & mask;
+    x->slots[h] = pos + 1;
+}
+
+// Fills x (slots already sized for bits) from list
+static void index_build(ip_index_t *x, const type_d_unit_t *list, int count) {
+    memset(x->slots, 0, sizeof(int32_t) << x->bits);
+    for (int i = 0; i < count; ++i)
+        index_put(x, list, i);
+}
+
+// Grows the working index if count units need it, then rebuilds it.
+// Never shrinks, so a rebuild after pruning cannot fail.
+static bool registry_reindex(int count) {
+    int bits = index_bits_for(count);
+    if (!unit_index.slots || bits > unit_index.bits) {
+        int32_t *slots = (int32_t *)mem_alloc(MEM_DETECT, sizeof(int32_t) << bits);
+        if (!slots) return false;
+        mem_free(unit_index.slots);
+        unit_index.slots = slots;
+        unit_index.bits = bits;
+    }
+    index_build(&unit_index, units, unit_count);
+    return true;
+}
+
+static void registry_free(void) {
+    mem_free(units);
+    mem_free(unit_index.slots);
+    units = NULL;
+    unit_index.slots = NULL;
+    unit_index.bits = 0;
+    unit_count = unit_cap = 0;
+}
+
+// Latest reply onto a unit's entry. Status from an earlier version 2 reply is
+// kept if this one is an announce without it.
+static void unit_note_reply(type_d_unit_t *u, const detect_reply_t *r, uint32_t now) {
+    u->last_seen = now;
+    if (r->version >= 2) {
+        u->info = *r;
+        u->status_seen = now ? now : 1;
+    } else if (u->info.version < 2) {
+        u->info = *r;
+    } else {
+        u->info.id = r->id;
+    }
+}
+
+// Returns true if the unit is new or its ID changed. O(1) per reply.
+static bool add_or_update_unit(uint32_t ip, const detect_reply_t *r) {
+    uint8_t id = r->id;
+    uint32_t now = SDL_GetTicks();
+    int pos = index_find(&unit_index, units, ip);
+    if (pos >= 0) {
+        bool changed = units[pos].id != id;
+        units[pos].id = id;
+        unit_note_reply(&units[pos], r, now);
+        return changed;
+    }
+    if (unit_count == DETECT_UNITS_LIMIT) {
+        debugPrint("[detect] Registry full, ignoring %s\n", detect_ipstr(ip));
+        return false;
+    }
+    if (unit_count == unit_cap) {
+        int cap = unit_cap ? unit_cap * 2 : 8;
+        type_d_unit_t *grown = (type_d_unit_t *)mem_realloc(MEM_DETECT, units, sizeof(type_d_unit_t) * cap);
+        if (!grown) return false;
+        units = grown;
+        unit_cap = cap;
+    }
+    memset(&units[unit_count], 0, sizeof(units[0]));
+    units[unit_count].ip = ip;
+    units[unit_count].id = id;
+    units[unit_count].found = now;
+    unit_note_reply(&units[unit_count], r, now);
+    unit_count++;
+    // Grow the index once it would pass half full, else just insert
+    if (!unit_index.slots || unit_count * 2 > (1 << unit_index.bits)) {
+        if (!registry_reindex(unit_count)) {
+            unit_count--;
+            return false;
+        }
+    } else {
+        index_put(&unit_index, units, unit_count - 1);
+    }
+    return true;
+}
+
+static void snapshot_release(detect_snapshot_t *snap) {
+    if (snap && SDL_AtomicDecRef(&snap->refs))
+        mem_free(snap);
+}
+
+// Immutable copy of the registry: units sorted by ID (counting sort) then IP,
+// with its own IP index, all in one allocation
+static detect_snapshot_t *snapshot_build(uint32_t gen) {
+    int bits = index_bits_for(unit_count);
+    size_t units_size = sizeof(type_d_unit_t) * unit_count;
+    detect_snapshot_t *snap = (detect_snapshot_t *)mem_alloc(MEM_DETECT,
+        sizeof(detect_snapshot_t) + units_size + (sizeof(int32_t) << bits));
+    if (!snap) return NULL;
+    SDL_AtomicSet(&snap->refs, 1);
+    snap->generation = gen;
+    snap->count = unit_count;
+
+    memset(snap->id_start, 0, sizeof(snap->id_start));
+    for (int i = 0; i < unit_count; ++i)
+        snap->id_start[units[i].id + 1]++;
+    for (int id = 0; id < 256; ++id)
+        snap->id_start[id + 1] += snap->id_start[id];
+    int fill[256];
+    memcpy(fill, snap->id_start, sizeof(fill));
+    for (int i = 0; i < unit_count; ++i) {
+        // Insertion sort by IP within the ID's range; duplicates are rare
+        int lo = snap->id_start[units[i].id];
+        int j = fill[units[i].id]++;
+        while (j > lo && snap->units[j - 1].ip > units[i].ip) {
+            snap->units[j] = snap->units[j - 1];
+            j--;
+        }
+        snap->units[j] = units[i];
+    }
+
+    snap->index.slots = (int32_t *)((uint8_t *)snap->units + units_size);
+    snap->index.bits = bits;
+    index_build(&snap->index, snap->units, unit_count);
+    return snap;
+}
+
+// Publish the working registry to readers; bump the generation if it changed
+static void publish(bool changed) {
+    uint32_t gen = (uint32_t)SDL_AtomicGet(&generation) + (changed ? 1 : 0);
+    detect_snapshot_t *snap = snapshot_build(gen);
+    if (!snap) {
+        debugPrint("[detect] Out of memory publishing %d units\n", unit_count);
+        return;
+    }
+    SDL_AtomicLock(&snap_lock);
+    detect_snapshot_t *old = current;
+    current = snap;
+    SDL_AtomicUnlock(&snap_lock);
+    snapshot_release(old);
+
+    if (!changed) return;
+    SDL_AtomicAdd(&generation, 1);
+    if (event_type) {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = event_type;
+        SDL_PushEvent(&e);
+    }
+}
+
+// Drops units not heard from for DETECT_TIMEOUT_MS; returns true if any went
+static bool prune_units(uint32_t now) {
+    int dst = 0;
+    for (int i = 0; i < unit_count; ++i) {
+        if (now - units[i].last_seen <= DETECT_TIMEOUT_MS) {
+            if (dst != i)
+                units[dst] = units[i];
+            dst++;
+        }
+    }
+    bool pruned = dst != unit_count;
+    unit_count = dst;
+    // Positions moved, so the index is rebuilt (rare: only when a unit leaves)
+    if (pruned) registry_reindex(unit_count);
+    return pruned;
+}
+
+// A unit that answered the previous probe but not the latest one
+static bool unit_missing(uint32_t prev_probe, uint32_t last_probe) {
     for (int i = 0; i < unit_count; ++i) {
-        if (units[i].ip == ip) {
-            units[i].id = id;
-            units[i].last_seen = SDL_GetTicks();
-            return;
+        uint32_t seen = units[i].last_seen;
+        if ((int32_t)(seen - prev_probe) >= 0 && (int32_t)(seen - last_probe) < 0)
+            return true;
+    }
+    return false;
+}
+
+// Decimal digits at *p, advancing past them; false if there are none.
+// Saturates rather than wrapping.
+static bool parse_uint(const char **p, const char *end, uint32_t *out) {
+    const char *s = *p;
+    uint32_t v = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s)
+        v = (v < 100000000u) ? v * 10 + (uint32_t)(*s - '0') : 0xFFFFFFFFu;
+    if (s == *p) return false;
+    *p = s;
+    *out = v;
+    return true;
+}
+
+// "1.4.2" as 0x010402; missing parts count as 0
+static uint32_t parse_firmware(const char *p, const char *end) {
+    uint32_t version = 0;
+    for (int part = 0; part < 3; ++part) {
+        uint32_t v = 0;
+        if (p < end && parse_uint(&p, end, &v) && v > 255) v = 255;
+        version |= v << (16 - 8 * part);
+        if (p >= end || *p != '.') break;
+        p++;
+    }
+    return version;
+}
+
+static bool key_is(const char *key, size_t len, const char *name) {
+    return strlen(name) == len && memcmp(key, name, len) == 0;
+}
+
+void detect_parse_status(const char *buf, int len, detect_reply_t *out) {
+    const char *p = buf, *end = buf + len;
+    while (p < end) {
+        const char *field_end = memchr(p, '&', (size_t)(end - p));
+        if (!field_end) field_end = end;
+        const char *eq = memchr(p, '=', (size_t)(field_end - p));
+        if (eq) {
+            size_t klen = (size_t)(eq - p);
+            const char *v = eq + 1;
+            uint32_t n;
+            if (key_is(p, klen, "fw")) {
+                out->firmware = parse_firmware(v, field_end);
+            } else if (parse_uint(&v, field_end, &n)) {
+                // Every other known key is a number
+                if (key_is(p, klen, "display"))
+                    out->display = n ? 1 : 0;
+                else if (key_is(p, klen, "img"))
+                    out->image = (int16_t)(n > 32767 ? 32767 : n);
+                else if (key_is(p, klen, "mode"))
+                    out->mode = (int8_t)(n > 127 ? 127 : n);
+                else if (key_is(p, klen, "cap"))
+                    out->caps = (uint8_t)n;
+                else if (key_is(p, klen, "v"))
+                    out->version = (uint8_t)(n > 255 ? 255 : n);
+            }
         }
+        p = field_end + 1;
+    }
+}
+
+bool detect_parse_reply(const char *buf, int len, detect_reply_t *out) {
+    size_t plen = strlen(DETECT_REPLY_PREFIX);
+    if (len < (int)plen || memcmp(buf, DETECT_REPLY_PREFIX, plen) != 0) return false;
+    const char *p = buf + plen, *end = buf + len;
+
+    // Like atoi(): leading blanks and a plus sign are skipped, no digits is ID 0
+    uint32_t id = 0;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p < end && *p == '+') p++;
+    parse_uint(&p, end, &id);
+    memset(out, 0, sizeof(*out));
+    out->id = (uint8_t)id;
+    out->version = 1;
+    out->display = -1;
+    out->mode = -1;
+    out->image = -1;
+    out->caps = (id == 5) ? DETECT_CAP_XL : (id == 6) ? DETECT_CAP_EXP : 0;
+
+    if (p < end && *p == ';') {
+        out->version = 2;
+        detect_parse_status(p + 1, (int)(end - p - 1), out);
+        if (out->version < 2) out->version = 2;
     }
-    if (unit_count < TYPE_D_MAX_UNITS) {
-        units[unit_count].ip = ip;
-        units[unit_count].id = id;
-        units[unit_count].last_seen = SDL_GetTicks();
-        unit_count++;
+    return true;
+}
+
+// ---- Strategies ----------------------------------------------------------
+
+// Low bits of the microsecond clock, never 0 so 0 can mean "not sent"
+static uint32_t stamp_us(void) {
+    uint32_t us = (uint32_t)telemetry_now_us();
+    return us ? us : 1;
+}
+
+static bool send_probe(probe_ctx_t *c, detect_strategy_t s, uint32_t ip) {
+    struct sockaddr_in to = {0};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(DETECT_DISCOVER_PORT);
+    to.sin_addr.s_addr = htonl(ip);
+    int len = (int)strlen(DETECT_DISCOVER_MSG);
+    if (sendto(c->sock, DETECT_DISCOVER_MSG, len, 0, (struct sockaddr *)&to, sizeof(to)) != len)
+        return false;
+    SDL_AtomicAdd(&strategy_sent[s], 1);
+    return true;
+}
+
+static bool take_token(probe_ctx_t *c) {
+    if (c->tokens < 1000) return false;
+    c->tokens -= 1000;
+    return true;
+}
+
+// Address and netmask of the default interface, host order. Read without the
+// lwIP core lock: both are single words, and a stale pair only misdirects
+// one round.
+static void read_subnet(probe_ctx_t *c) {
+    struct netif *n = netif_default;
+    if (!n || !netif_is_up(n)) {
+        c->local_ip = c->netmask = 0;
+        return;
     }
+    c->local_ip = ntohl(ip4_addr_get_u32(netif_ip4_addr(n)));
+    c->netmask = ntohl(ip4_addr_get_u32(netif_ip4_netmask(n)));
+    if (!c->local_ip) c->netmask = 0;
 }
 
-//static void prune_units(void) {
-//    uint32_t now = SDL_GetTicks();
-//    int dst = 0;
-//    for (int i = 0; i < unit_count; ++i) {
-//        if (now - units[i].last_seen <= DETECT_TIMEOUT_MS) {
-//            if (dst != i)
-//                units[dst] = units[i];
-//            dst++;
-//        }
-//    }
-//    unit_count = dst;
-//}
+static void limited_round(probe_ctx_t *c) {
+    send_probe(c, DETECT_LIMITED_BROADCAST, ntohl(inet_addr(DETECT_BROADCAST)));
+}
+
+static void subnet_round(probe_ctx_t *c) {
+    uint32_t bcast = (c->local_ip & c->netmask) | ~c->netmask;
+    // Nothing to add on a /32 or where the subnet broadcast is the limited one
+    if (!c->netmask || c->netmask == 0xFFFFFFFFu || bcast == ntohl(inet_addr(DETECT_BROADCAST)))
+        return;
+    send_probe(c, DETECT_SUBNET_BROADCAST, bcast);
+}
+
+// Re-probes start at c->reprobe_at, once the broadcast replies are in. A walk
+// the budget has not finished carries on where it is, so the units at the end
+// of the list are not starved by fast rounds, and goes round again for the
+// units before it.
+static void reprobe_round(probe_ctx_t *c) {
+    if (c->reprobe_pos < 0) {
+        c->reprobe_pos = 0;
+        c->reprobe_round = c->round;
+    }
+}
+
+// Known units whose replies to this round's broadcasts have not arrived,
+// probably because the network dropped them
+static bool reprobe_pump(probe_ctx_t *c) {
+    if (c->reprobe_pos < 0 || (c->reprobe_pos == 0 && (int32_t)(c->now - c->reprobe_at) < 0))
+        return false;
+    for (; c->reprobe_pos < unit_count; c->reprobe_pos++) {
+        type_d_unit_t *u = &units[c->reprobe_pos];
+        if ((int32_t)(u->last_seen - c->round) >= 0 || c->now - u->last_seen < DETECT_REPROBE_AFTER_MS)
+            continue;
+        if (u->reprobed && c->now - u->reprobed < DETECT_REPROBE_GAP_MS) continue;
+        if (!take_token(c)) return true;
+        if (send_probe(c, DETECT_UNICAST_REPROBE, u->ip)) {
+            u->reprobed = c->now ? c->now : 1;
+            u->unicast_us = stamp_us();
+            u->unicast_seq = probe_seq;
+        }
+    }
+    if (c->reprobe_round != c->round) {
+        c->reprobe_pos = 0;
+        c->reprobe_round = c->round;
+        return true;
+    }
+    c->reprobe_pos = -1;
+    c->reprobe_done = c->now;
+    return false;
+}
+
+// The /24 holding the interface address, or the whole subnet if smaller
+static void sweep_round(probe_ctx_t *c) {
+    if (c->sweep_host || !c->netmask || (int32_t)(c->now - c->sweep_next) < 0) return;
+    c->sweep_base = c->local_ip & (c->netmask | 0xFFFFFF00u);
+    c->sweep_host = 1;
+    c->sweep_next = c->now + DETECT_SWEEP_REPEAT_MS;
+}
+
+static bool sweep_pump(probe_ctx_t *c) {
+    if (!c->sweep_host) return false;
+    uint32_t bcast_host = ~(c->netmask | 0xFFFFFF00u);
+    for (; c->sweep_host < bcast_host; c->sweep_host++) {
+        uint32_t ip = c->sweep_base | c->sweep_host;
+        // Units already known are kept by the broadcasts and re-probes
+        if (ip == c->local_ip || index_find(&unit_index, units, ip) >= 0) continue;
+        if (!take_token(c)) return true;
+        if (send_probe(c, DETECT_UNICAST_SWEEP, ip)) {
+            c->sweep_sent_us[c->sweep_host] = stamp_us();
+            c->sweep_seq[c->sweep_host] = probe_seq;
+        }
+    }
+    c->sweep_host = 0;
+    SDL_AtomicAdd(&sweep_passes, 1);
+    return false;
+}
+
+// In detect_strategy_t order, which is also the order unicast budget is handed out
+static const strategy_ops_t strategies[DETECT_STRATEGY_COUNT] = {
+    {limited_round, NULL},
+    {subnet_round,  NULL},
+    {reprobe_round, reprobe_pump},
+    {sweep_round,   sweep_pump},
+};
+
+// Send time of the unicast probe to ip in round seq, 0 if there was none
+static uint32_t unicast_sent_us(probe_ctx_t *c, const type_d_unit_t *u, uint32_t ip, uint32_t seq) {
+    if (u && u->unicast_us && u->unicast_seq == seq)
+        return u->unicast_us;
+    // Indexed by host part, as sweep_pump() stores it: on a network smaller
+    // than a /24, sweep_base keeps the subnet bits
+    uint32_t mask = c->netmask | 0xFFFFFF00u;
+    if ((ip & mask) != c->sweep_base || c->sweep_seq[ip & ~mask] != seq) return 0;
+    return c->sweep_sent_us[ip & ~mask];
+}
+
+// Credits a reply from ip to the probe round it most likely answers and
+// records the round trip. Replies carry no sequence, so a known unit's reply
+// goes to the oldest round since its last credited one that is at most
+// DETECT_REPLY_LATE_MS old: a reply slower than the probe interval then
+// still counts for its own round rather than taking the next one's. A new
+// unit is credited to the latest round; a reply with every round already
+// answered is a duplicate.
+static void credit_reply(probe_ctx_t *c, uint32_t ip) {
+    int pos = index_find(&unit_index, units, ip);
+    type_d_unit_t *u = pos >= 0 ? &units[pos] : NULL;
+    uint32_t now_us = stamp_us();
+    uint32_t seq = probe_seq;
+    if (u && u->answered) {
+        if ((int32_t)(probe_seq - u->answered) <= 0) return;
+        uint32_t oldest = probe_seq - DETECT_ROUND_HISTORY + 1;
+        seq = (int32_t)(u->answered + 1 - oldest) > 0 ? u->answered + 1 : oldest;
+        for (; (int32_t)(seq - probe_seq) < 0; ++seq)
+            if (now_us - round_sent_us[seq % DETECT_ROUND_HISTORY] <= DETECT_REPLY_LATE_MS * 1000u) break;
+    }
+    // Timed from whichever probe of that round went out last: an unanswered
+    // sweep probe is older than the round by the time its unit turns up
+    uint32_t sent = round_sent_us[seq % DETECT_ROUND_HISTORY];
+    uint32_t unicast = unicast_sent_us(c, u, ip, seq);
+    if (unicast && (int32_t)(unicast - sent) > 0) sent = unicast;
+    if (u) u->answered = seq;
+    telemetry_discovery_reply(ip, seq, now_us - sent);
+}
+
+// A unit re-probed this round that answered neither the broadcasts nor the
+// re-probe. Units that answer only unicast would look missing to
+// unit_missing() whenever the broadcasts come round first.
+static bool reprobe_unanswered(const probe_ctx_t *c) {
+    for (int i = 0; i < unit_count; ++i) {
+        uint32_t sent = units[i].reprobed;
+        if (sent && (int32_t)(sent - c->round) >= 0 && (int32_t)(units[i].last_seen - sent) < 0)
+            return true;
+    }
+    return false;
+}
+
+// Reads every queued datagram on sock. Returns true if anything was parsed;
+// *changed is set when the unit table changed. Replies to our probes (as
+// opposed to announces) feed the round-trip telemetry.
+static bool drain_socket(probe_ctx_t *c, int sock, bool is_reply, bool *changed) {
+    bool seen = false;
+    while (1) {
+        struct sockaddr_in from;
+        socklen_t fromlen = sizeof(from);
+        char buf[DETECT_REPLY_MAX];
+        detect_reply_t reply;
+        int len = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
+        if (len <= 0) break;   // Non-blocking: nothing left
+        if (detect_parse_reply(buf, len, &reply)) {
+            uint32_t ip = ntohl(from.sin_addr.s_addr);
+            *changed |= add_or_update_unit(ip, &reply);
+            if (is_reply && probe_seq) credit_reply(c, ip);
+            seen = true;
+        }
+    }
+    return seen;
+}
 
 static int detect_thread_func(void *data) {
     int sock1 = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP); // 50501 (discovery/reply)
@@ -68,6 +603,10 @@ static int detect_thread_func(void *data) {
     int yes = 1;
     setsockopt(sock1, SOL_SOCKET, SO_BROADCAST, &yes, sizeof(yes));
     setsockopt(sock2, SOL_SOCKET, SO_BROADCAST, &yes, sizeof(yes));
+    setsockopt(sock1, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    setsockopt(sock2, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    ioctlsocket(sock1, FIONBIO, &yes);
+    ioctlsocket(sock2, FIONBIO, &yes);
 
     // Bind both sockets
     struct sockaddr_in addr1 = {0}, addr2 = {0};
@@ -76,45 +615,122 @@ static int detect_thread_func(void *data) {
     bind(sock1, (struct sockaddr*)&addr1, sizeof(addr1));
     bind(sock2, (struct sockaddr*)&addr2, sizeof(addr2));
 
-    struct sockaddr_in broadcast_addr = {0};
-    broadcast_addr.sin_family = AF_INET;
-    broadcast_addr.sin_port = htons(DETECT_DISCOVER_PORT);
-    broadcast_addr.sin_addr.s_addr = inet_addr(DETECT_BROADCAST);
+    // About 2 KB, so static rather than on the thread's stack
+    static probe_ctx_t ctx;
+    probe_ctx_t *c = &ctx;
+    memset(c, 0, sizeof(*c));
+    c->sock = sock1;
+    c->reprobe_pos = -1;
+    c->tokens = DETECT_UNICAST_BURST * 1000;
+
+    // Probe cadence: DETECT_PROBE_MIN_MS at boot and after any change,
+    // doubling up to DETECT_PROBE_MAX_MS while the set of units is stable
+    uint32_t interval = DETECT_PROBE_MIN_MS;
+    uint32_t now = SDL_GetTicks();
+    uint32_t next_probe = now;
+    uint32_t last_probe = now - DETECT_PROBE_MAX_MS;
+    uint32_t prev_probe = last_probe;
+    uint32_t refilled = now;
+    c->sweep_next = now;
+    bool checked = true;    // Missing-unit check done for last_probe
 
     while (running) {
-        // Send discover packet
-        sendto(sock1, DETECT_DISCOVER_MSG, (int)strlen(DETECT_DISCOVER_MSG), 0,
-            (struct sockaddr *)&broadcast_addr, sizeof(broadcast_addr));
+        now = SDL_GetTicks();
+        c->now = now;
+        uint32_t mask = (uint32_t)SDL_AtomicGet(&strategy_mask);
+        if ((int32_t)(now - next_probe) >= 0) {
+            read_subnet(c);
+            c->round = now;
+            // Fast rounds come before the grace period is over; re-probe
+            // halfway to the next one so every round reaches every unit
+            c->reprobe_at = now + (interval / 2 < DETECT_REPLY_GRACE_MS ? interval / 2 : DETECT_REPLY_GRACE_MS);
+            probe_seq = telemetry_probe_sent();
+            round_sent_us[probe_seq % DETECT_ROUND_HISTORY] = stamp_us();
+            for (int s = 0; s < DETECT_STRATEGY_COUNT; ++s)
+                if ((mask & (1u << s)) && strategies[s].round) strategies[s].round(c);
+            prev_probe = last_probe;
+            last_probe = now;
+            checked = false;
+            next_probe = now + interval;
+            interval = (interval * 2 > DETECT_PROBE_MAX_MS) ? DETECT_PROBE_MAX_MS : interval * 2;
+        }
+
+        // Unicast probes share one token bucket, handed out in strategy order
+        int pps = SDL_AtomicGet(&unicast_pps);
+        uint32_t elapsed = now - refilled;
+        refilled = now;
+        if (elapsed > 1000) elapsed = 1000;
+        c->tokens += (int)elapsed * pps;
+        if (c->tokens > DETECT_UNICAST_BURST * 1000) c->tokens = DETECT_UNICAST_BURST * 1000;
+        bool more = false;
+        for (int s = 0; pps > 0 && s < DETECT_STRATEGY_COUNT; ++s)
+            if ((mask & (1u << s)) && strategies[s].pump) more |= strategies[s].pump(c);
 
-        // Listen for replies/announcements (50501 and 50502) with short timeout
-        struct timeval tv = {0, 500 * 1000}; // 500ms
+        // Re-probed units get their own grace period before they count as
+        // missing, from the last re-probe the budget let out
+        bool reprobing = (mask & (1u << DETECT_UNICAST_REPROBE)) && pps > 0;
+        uint32_t check_at = last_probe + DETECT_REPLY_GRACE_MS;
+        if (reprobing) {
+            check_at += DETECT_REPLY_GRACE_MS;
+            if (c->reprobe_pos < 0 && (int32_t)(c->reprobe_done + DETECT_REPLY_GRACE_MS - check_at) > 0)
+                check_at = c->reprobe_done + DETECT_REPLY_GRACE_MS;
+        }
+
+        // Sleep until a datagram arrives, the next probe, the reply window
+        // closes or there is budget for the next unicast probe
+        uint32_t wake_at = next_probe;
+        if (!checked && (int32_t)(check_at - wake_at) < 0)
+            wake_at = check_at;
+        if (reprobing && c->reprobe_pos >= 0 && (int32_t)(c->reprobe_at - now) > 0 &&
+            (int32_t)(c->reprobe_at - wake_at) < 0)
+            wake_at = c->reprobe_at;
+        if (more) {
+            int need = 1000 - c->tokens;
+            uint32_t token_at = now + (uint32_t)(need > 0 ? (need + pps - 1) / pps : 0);
+            if ((int32_t)(token_at - wake_at) < 0) wake_at = token_at;
+        }
+        int32_t wait_ms = (int32_t)(wake_at - now);
+        if (wait_ms < 0) wait_ms = 0;
+        if (wait_ms > DETECT_WAIT_MAX_MS) wait_ms = DETECT_WAIT_MAX_MS;   // Notice detect_stop()
+
+        struct timeval tv = {0, wait_ms * 1000};
         fd_set readfds;
         FD_ZERO(&readfds);
         FD_SET(sock1, &readfds);
         FD_SET(sock2, &readfds);
         int maxfd = (sock1 > sock2) ? sock1 : sock2;
 
-        int rv = select(maxfd+1, &readfds, NULL, NULL, &tv);
-        if (rv > 0) {
-            for (int s = 0; s < 2; ++s) {
-                int sock = (s == 0) ? sock1 : sock2;
-                if (FD_ISSET(sock, &readfds)) {
-                    struct sockaddr_in from;
-                    socklen_t fromlen = sizeof(from);
-                    char buf[64];
-                    int len = recvfrom(sock, buf, sizeof(buf)-1, 0, (struct sockaddr*)&from, &fromlen);
-                    if (len > 0) {
-                        buf[len] = 0;
-                        if (strncmp(buf, DETECT_REPLY_PREFIX, strlen(DETECT_REPLY_PREFIX)) == 0) {
-                            uint8_t id = (uint8_t)atoi(buf + strlen(DETECT_REPLY_PREFIX));
-                            add_or_update_unit(ntohl(from.sin_addr.s_addr), id);
-                        }
-                    }
-                }
+        bool seen = false, changed = false, announced = false;
+        if (select(maxfd+1, &readfds, NULL, NULL, &tv) > 0) {
+            // Drain both ports: several units answer each broadcast at once
+            if (FD_ISSET(sock1, &readfds))
+                seen |= drain_socket(c, sock1, true, &changed);
+            if (FD_ISSET(sock2, &readfds)) {
+                announced = drain_socket(c, sock2, false, &changed);
+                seen |= announced;
             }
         }
-        //prune_units();
-        SDL_Delay(1000); // Repeat every second
+
+        now = SDL_GetTicks();
+        bool missing = false;
+        if (!checked && (int32_t)(now - check_at) >= 0 && !(reprobing && c->reprobe_pos >= 0)) {
+            missing = reprobing ? reprobe_unanswered(c) : unit_missing(prev_probe, last_probe);
+            checked = true;
+        }
+        if (prune_units(now)) {
+            changed = true;
+            seen = true;
+        }
+        if (seen) publish(changed);
+
+        // Something moved: go back to the fast cadence, probing right away
+        // (but never closer together than DETECT_PROBE_MIN_MS)
+        if (changed || announced || missing) {
+            interval = DETECT_PROBE_MIN_MS;
+            uint32_t soonest = last_probe + DETECT_PROBE_MIN_MS;
+            if ((int32_t)(next_probe - soonest) > 0)
+                next_probe = soonest;
+        }
     }
     closesocket(sock1);
     closesocket(sock2);
@@ -125,6 +741,15 @@ void detect_start(void) {
     if (running) return;
     running = 1;
     unit_count = 0;
+    for (int s = 0; s < DETECT_STRATEGY_COUNT; ++s)
+        SDL_AtomicSet(&strategy_sent[s], 0);
+    SDL_AtomicSet(&sweep_passes, 0);
+    if (!event_type) {
+        event_type = SDL_RegisterEvents(1);
+        if (event_type == (Uint32)-1) event_type = 0;
+    }
+    registry_reindex(0);
+    publish(true);
     detect_thread = SDL_CreateThread(detect_thread_func, "detect_thread", NULL);
 }
 
@@ -134,12 +759,114 @@ void detect_stop(void) {
         SDL_WaitThread(detect_thread, NULL);
         detect_thread = NULL;
     }
+    // Readers keep the last snapshot; only the working copy goes
+    registry_free();
 }
 
-int detect_get_units(type_d_unit_t *out, int max) {
-    //prune_units();
-    int n = (unit_count < max) ? unit_count : max;
-    for (int i = 0; i < n; ++i)
-        out[i] = units[i];
+void detect_replay(const type_d_unit_t *list, int count) {
+    if (running) return;
+    if (!event_type) {
+        event_type = SDL_RegisterEvents(1);
+        if (event_type == (Uint32)-1) event_type = 0;
+    }
+    if (count > DETECT_UNITS_LIMIT) count = DETECT_UNITS_LIMIT;
+    if (count > unit_cap) {
+        type_d_unit_t *grown = (type_d_unit_t *)mem_realloc(MEM_DETECT, units, sizeof(type_d_unit_t) * count);
+        if (!grown) return;
+        units = grown;
+        unit_cap = count;
+    }
+    if (count) memcpy(units, list, sizeof(type_d_unit_t) * count);
+    unit_count = count;
+    if (!registry_reindex(unit_count)) return;
+    publish(true);
+}
+
+const detect_snapshot_t *detect_snapshot_acquire(void) {
+    SDL_AtomicLock(&snap_lock);
+    detect_snapshot_t *snap = current;
+    if (snap) SDL_AtomicIncRef(&snap->refs);
+    SDL_AtomicUnlock(&snap_lock);
+    return snap;
+}
+
+void detect_snapshot_release(const detect_snapshot_t *snap) {
+    snapshot_release((detect_snapshot_t *)snap);
+}
+
+uint32_t detect_snapshot_generation(const detect_snapshot_t *snap) {
+    return snap ? snap->generation : 0;
+}
+
+const type_d_unit_t *detect_snapshot_units(const detect_snapshot_t *snap, int *count) {
+    *count = snap ? snap->count : 0;
+    return snap ? snap->units : NULL;
+}
+
+const type_d_unit_t *detect_snapshot_by_id(const detect_snapshot_t *snap, uint8_t id, int *count) {
+    *count = snap ? snap->id_start[id + 1] - snap->id_start[id] : 0;
+    return *count ? &snap->units[snap->id_start[id]] : NULL;
+}
+
+const type_d_unit_t *detect_snapshot_find(const detect_snapshot_t *snap, uint32_t ip) {
+    int pos = snap ? index_find(&snap->index, snap->units, ip) : -1;
+    return pos >= 0 ? &snap->units[pos] : NULL;
+}
+
+int detect_get_units_page(type_d_unit_t *out, int offset, int max, int *total) {
+    const detect_snapshot_t *snap = detect_snapshot_acquire();
+    int count;
+    const type_d_unit_t *list = detect_snapshot_units(snap, &count);
+    int n = 0;
+    if (offset >= 0 && offset < count) {
+        n = (count - offset < max) ? count - offset : max;
+        memcpy(out, list + offset, sizeof(type_d_unit_t) * n);
+    }
+    if (total) *total = count;
+    detect_snapshot_release(snap);
     return n;
 }
+
+int detect_get_units(type_d_unit_t *out, int max) {
+    return detect_get_units_page(out, 0, max, NULL);
+}
+
+uint32_t detect_generation(void) {
+    return (uint32_t)SDL_AtomicGet(&generation);
+}
+
+int detect_get_units_since(type_d_unit_t *out, int max, uint32_t *gen) {
+    // Read the generation first: a bump racing the copy just means one extra copy next time
+    uint32_t now = detect_generation();
+    if (now == *gen) return -1;
+    *gen = now;
+    return detect_get_units(out, max);
+}
+
+Uint32 detect_event_type(void) {
+    return event_type;
+}
+
+void detect_set_strategies(uint32_t mask) {
+    SDL_AtomicSet(&strategy_mask, (int)(mask & DETECT_STRATEGIES_ALL));
+}
+
+uint32_t detect_strategies(void) {
+    return (uint32_t)SDL_AtomicGet(&strategy_mask);
+}
+
+void detect_set_unicast_rate(int per_second) {
+    SDL_AtomicSet(&unicast_pps, per_second < 0 ? 0 : per_second);
+}
+
+void detect_strategy_stats(detect_strategy_stats_t out[DETECT_STRATEGY_COUNT]) {
+    for (int s = 0; s < DETECT_STRATEGY_COUNT; ++s) {
+        out[s].sent = (uint32_t)SDL_AtomicGet(&strategy_sent[s]);
+        out[s].passes = 0;
+    }
+    out[DETECT_UNICAST_SWEEP].passes = (uint32_t)SDL_AtomicGet(&sweep_passes);
+}
+
+const char *detect_strategy_name(detect_strategy_t s) {
+    return ((unsigned)s < DETECT_STRATEGY_COUNT) ? strategy_names[s] : "?";
+}
@@ -1,23 +1,174 @@
 #pragma once
+#include <stdbool.h>
 #include <stdint.h>
+#include <SDL.h>
 
-#define TYPE_D_MAX_UNITS 6
+#define DETECT_UNITS_LIMIT 1024   // Sanity cap on the registry, not a display limit
+#define DETECT_REPLY_MAX   128    // Longest discovery reply read; the rest is cut off
+#define DETECT_UNICAST_PPS 100    // Default unicast probe budget: a full /24 sweep in about 2.5 s
+
+// Discovery reply. Every firmware answers the probe with
+//
+//   TYPE_D_ID:<id>
+//
+// Version 2 firmware appends its status, so one broadcast fills in every
+// unit without a status query each:
+//
+//   TYPE_D_ID:<id>;v=2&fw=<major.minor.patch>&display=<0|1>&img=<n>&mode=<n>&cap=<flags>
+//
+// Consoles that only know version 1 read the ID with atoi() and stop at the
+// ';'. Keys may come in any order; unknown ones are skipped and missing ones
+// stay unknown. cap is a decimal DETECT_CAP_* mask.
+enum {
+    DETECT_CAP_XL  = 1 << 0,
+    DETECT_CAP_EXP = 1 << 1
+};
+
+typedef struct {
+    uint8_t  id;
+    uint8_t  version;    // 1: ID only; 2 and up: the status below was reported
+    uint8_t  caps;       // DETECT_CAP_*; for version 1 derived from the ID
+    int8_t   display;    // 1 on, 0 off, -1 unknown
+    int8_t   mode;       // -1 if unknown
+    int16_t  image;      // -1 if unknown
+    uint32_t firmware;   // major << 16 | minor << 8 | patch, 0 if unknown
+} detect_reply_t;
+
+// Ways of reaching units, tried side by side. Some access points and managed
+// switches drop or rate-limit the limited broadcast, so the probe also goes
+// to the interface's own subnet broadcast, and unicast probes (paced by
+// detect_set_unicast_rate()) cover every host of the /24 and keep units
+// that only answer unicast from timing out.
+typedef enum {
+    DETECT_LIMITED_BROADCAST = 0,     // 255.255.255.255, every probe round
+    DETECT_SUBNET_BROADCAST,          // Directed broadcast of the lwIP interface, every probe round
+    DETECT_UNICAST_REPROBE,           // Known units that did not answer a round's broadcasts
+    DETECT_UNICAST_SWEEP,             // Every host of the interface's /24, once at start and then periodically
+    DETECT_STRATEGY_COUNT
+} detect_strategy_t;
+
+#define DETECT_STRATEGIES_ALL ((1u << DETECT_STRATEGY_COUNT) - 1)
+
+typedef struct {
+    uint32_t sent;       // Probes since detect_start()
+    uint32_t passes;     // DETECT_UNICAST_SWEEP only: sweeps completed
+} detect_strategy_stats_t;
 
 typedef struct {
-    uint32_t ip;         // IPv4 address (network byte order)
+    uint32_t ip;         // IPv4 address (host byte order)
     uint8_t  id;         // Device ID
     uint32_t last_seen;  // SDL_GetTicks() or similar timestamp
+    detect_reply_t info; // Latest reply; status fields only from version 2
+    uint32_t status_seen; // last_seen of the latest reply that carried status, 0 if none
+    uint32_t found;      // last_seen of the reply that added the unit; a unit pruned and found again gets a new one
+    uint32_t reprobed;   // Detect thread only: last_seen-style time of the latest re-probe, 0 if none
+    uint32_t unicast_us; // Detect thread only: the same in low bits of telemetry_now_us(), for the round trip
+    uint32_t unicast_seq; // Detect thread only: probe round the re-probe belongs to
+    uint32_t answered;   // Detect thread only: latest probe round a reply was credited to, 0 if none
 } type_d_unit_t;
 
+// Immutable, reference-counted view of the registry. Units are ordered by ID,
+// then IP, so several units sharing an ID sit next to each other.
+typedef struct detect_snapshot detect_snapshot_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void detect_start(void);
 void detect_stop(void);
-int  detect_get_units(type_d_unit_t *out, int max);
+uint32_t detect_generation(void);  // Bumped whenever a unit appears, disappears or changes ID
+Uint32 detect_event_type(void);    // SDL event pushed on every generation bump (0 before detect_start)
 const char *detect_ipstr(uint32_t ip); // For debug/menu display
 
+/**
+ * Publishes list as the registry, in place of the detect thread: for the
+ * host replay, with the thread stopped (ignored while it runs). Bumps the
+ * generation and pushes detect_event_type() like a real change.
+ */
+void detect_replay(const type_d_unit_t *list, int count);
+
+/**
+ * Chooses the discovery strategies; takes effect at the next probe round.
+ *
+ * @param mask 1 << detect_strategy_t for each one wanted (DETECT_STRATEGIES_ALL by default)
+ */
+void detect_set_strategies(uint32_t mask);
+uint32_t detect_strategies(void);
+
+/**
+ * Caps unicast probes, re-probes and sweep together, with re-probes served
+ * first. Short bursts of a few probes are allowed after an idle spell.
+ *
+ * @param per_second DETECT_UNICAST_PPS by default; 0 stops unicast probing
+ */
+void detect_set_unicast_rate(int per_second);
+
+/**
+ * @param out One entry per detect_strategy_t
+ */
+void detect_strategy_stats(detect_strategy_stats_t out[DETECT_STRATEGY_COUNT]);
+const char *detect_strategy_name(detect_strategy_t s);
+
+/**
+ * Takes a reference to the latest published snapshot. Cheap: no units are
+ * copied. Hold it as long as needed and drop it with detect_snapshot_release().
+ *
+ * @return Snapshot, or NULL before detect_start()
+ */
+const detect_snapshot_t *detect_snapshot_acquire(void);
+
+/**
+ * Drops a reference from detect_snapshot_acquire(). NULL is ignored.
+ */
+void detect_snapshot_release(const detect_snapshot_t *snap);
+
+/**
+ * @return Generation the snapshot was published at (compare with detect_generation())
+ */
+uint32_t detect_snapshot_generation(const detect_snapshot_t *snap);
+
+/**
+ * All units in the snapshot; index them directly to page or iterate.
+ *
+ * @param count Set to the number of units
+ */
+const type_d_unit_t *detect_snapshot_units(const detect_snapshot_t *snap, int *count);
+
+/**
+ * Units reporting a given ID, lowest IP first.
+ *
+ * @param count Set to the number of matching units (0 if none)
+ */
+const type_d_unit_t *detect_snapshot_by_id(const detect_snapshot_t *snap, uint8_t id, int *count);
+
+/**
+ * @return The unit at ip, or NULL
+ */
+const type_d_unit_t *detect_snapshot_find(const detect_snapshot_t *snap, uint32_t ip);
+
+/**
+ * Parses a discovery reply in place: buf need not be NUL-terminated and
+ * nothing is copied or allocated.
+ *
+ * @return false if buf is not a Type D reply
+ */
+bool detect_parse_reply(const char *buf, int len, detect_reply_t *out);
+
+/**
+ * Reads display, img, mode, fw and cap from key=value fields separated by
+ * '&', as found after the ';' of a version 2 reply and in a GET /status
+ * body. Fields that are not present are left as they are.
+ */
+void detect_parse_status(const char *buf, int len, detect_reply_t *out);
+
+// Copying helpers for callers that want their own array
+int  detect_get_units(type_d_unit_t *out, int max);
+int  detect_get_units_page(type_d_unit_t *out, int offset, int max, int *total);
+// Copies the units only if the table changed since *gen; returns -1 (and
+// leaves out untouched) when it did not. *gen is updated on copy.
+int  detect_get_units_since(type_d_unit_t *out, int max, uint32_t *gen);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,418 @@
+#include "devconfig.h"
+#include "detect.h"
+#include "send_cmd.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+
+#define DEVCONFIG_WAIT_MAX_MS  250    // Longest sleep so devconfig_stop() is noticed
+#define DEVCONFIG_LINE_MAX     128
+#define DEVCONFIG_PATH_MAX     128
+
+typedef struct {
+    devconfig_unit_t        want;
+    devconfig_unit_status_t st;
+    bool                    sync;       // Sync wanted; runs while the unit is present
+    bool                    present;    // Matched in the latest snapshot
+    uint32_t                since;      // When the unit was found or the sync asked for
+    uint32_t                sent_at;    // Latest batch, 0 if its result was seen
+    uint32_t                found;      // type_d_unit_t.found of the unit synced
+    int                     mode_steps;
+} devconfig_slot_t;
+
+// A slot's sync as the thread works on it outside the lock
+typedef struct {
+    int              slot;
+    devconfig_unit_t want;
+    uint32_t         ip;
+    uint32_t         since;
+    uint32_t         sent_at;
+    uint32_t         found;
+    int              commands;
+    int              mode_steps;
+} devconfig_job_t;
+
+static devconfig_slot_t slots[DEVCONFIG_UNITS];
+static int slot_count = 0;
+static uint32_t batches = 0;
+static SDL_SpinLock lock = 0;         // Guards slots[], slot_count and batches
+static char profile_path[DEVCONFIG_PATH_MAX];
+static SDL_atomic_t running;
+static SDL_sem* wake = NULL;
+static SDL_Thread* thread = NULL;
+static Uint32 event_type = 0;
+
+static void ip_to_str(uint32_t ip, char* out, size_t size) {
+    snprintf(out, size, "%u.%u.%u.%u",
+             (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+}
+
+bool devconfig_load(const char* path, devconfig_profile_t* out) {
+    memset(out, 0, sizeof(*out));
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[DEVCONFIG_LINE_MAX];
+    while (out->count < DEVCONFIG_UNITS && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\r' || line[0] == '\n') continue;
+        unsigned id, a, b, c, d;
+        int fields = 0;
+        if (sscanf(line, "%u %u.%u.%u.%u %n", &id, &a, &b, &c, &d, &fields) < 5 || fields == 0 ||
+            id > 255 || a > 255 || b > 255 || c > 255 || d > 255) {
+            debugPrint("[devconfig] Skipped line: %s", line);
+            continue;
+        }
+        detect_reply_t r;
+        memset(&r, 0, sizeof(r));
+        r.display = DEVSTATE_UNKNOWN;
+        r.mode = -1;
+        r.image = -1;
+        detect_parse_status(line + fields, (int)strcspn(line + fields, "\r\n"), &r);
+        devconfig_unit_t* u = &out->units[out->count++];
+        u->id = (uint8_t)id;
+        u->ip = a << 24 | b << 16 | c << 8 | d;
+        u->display = r.display;
+        u->mode = r.mode;
+        u->image = r.image;
+    }
+    fclose(f);
+    return out->count > 0;
+}
+
+bool devconfig_save(const char* path, const devconfig_profile_t* p) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# Type D rig profile: <id> <ip> <settings>\n");
+    for (int i = 0; i < p->count; ++i) {
+        const devconfig_unit_t* u = &p->units[i];
+        char ip[16], fields[64] = "";
+        size_t len = 0;
+        ip_to_str(u->ip, ip, sizeof(ip));
+        if (u->display >= 0)
+            len += snprintf(fields + len, sizeof(fields) - len, "&display=%d", u->display);
+        if (u->mode >= 0)
+            len += snprintf(fields + len, sizeof(fields) - len, "&mode=%d", u->mode);
+        if (u->image >= 0)
+            len += snprintf(fields + len, sizeof(fields) - len, "&img=%d", u->image);
+        fprintf(f, "%u %s %s\n", (unsigned)u->id, ip, len ? fields + 1 : "");
+    }
+    bool ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+int devconfig_plan(const devconfig_unit_t* want, const devstate_t* have, const char** cmds, int max) {
+    int n = 0;
+    if (want->display == DEVSTATE_ON && have->display != DEVSTATE_ON && n < max)
+        cmds[n++] = DEVSTATE_CMD_DISPLAY_ON;
+    if (want->mode >= 0 && have->mode >= 0 && have->mode != want->mode && n < max)
+        cmds[n++] = DEVCONFIG_CMD_MODE;
+    if (want->image >= 0 && have->image >= 0) {
+        int diff = want->image - have->image;
+        const char* step = diff > 0 ? DEVCONFIG_CMD_NEXT_IMAGE : DEVCONFIG_CMD_PREV_IMAGE;
+        int steps = diff > 0 ? diff : -diff;
+        // Room is kept for Display Off so it still goes out last
+        int room = max - (want->display == DEVSTATE_OFF ? 1 : 0);
+        for (int i = 0; i < steps && n < room; ++i)
+            cmds[n++] = step;
+    }
+    if (want->display == DEVSTATE_OFF && have->display != DEVSTATE_OFF && n < max)
+        cmds[n++] = DEVSTATE_CMD_DISPLAY_OFF;
+    return n;
+}
+
+// Sends cmds to the unit SEND_CMD_PIPELINE_MAX at a time; false at the first
+// command that did not go through
+static bool send_batch(uint32_t ip, const char** cmds, int count) {
+    char host[16];
+    ip_to_str(ip, host, sizeof(host));
+    for (int i = 0; i < count; i += SEND_CMD_PIPELINE_MAX) {
+        send_cmd_req_t reqs[SEND_CMD_PIPELINE_MAX];
+        int n = SDL_min(count - i, SEND_CMD_PIPELINE_MAX);
+        memset(reqs, 0, sizeof(reqs));
+        for (int k = 0; k < n; ++k)
+            reqs[k].cmd_hex = cmds[i + k];
+        int ok = send_cmd_pipeline(host, reqs, n, DEVCONFIG_TIMEOUT_MS);
+        SDL_AtomicLock(&lock);
+        batches++;
+        SDL_AtomicUnlock(&lock);
+        for (int k = 0; k < n; ++k)
+            devstate_note_command(ip, reqs[k].cmd_hex, reqs[k].ok);
+        if (ok < n) {
+            debugPrint("[devconfig] %s: %d/%d commands failed\n", host, n - ok, n);
+            return false;
+        }
+    }
+    return true;
+}
+
+// One step of a unit's sync: waits for fresh state, then sends what is still
+// missing. Returns the state the slot is left in.
+static devconfig_state_t sync_step(devconfig_job_t* j, uint32_t now) {
+    devstate_t have;
+    bool known = devstate_get(j->ip, &have);
+    // State checked before the unit came back is what it had before a power
+    // cut, not the defaults it booted with
+    if (known && (int32_t)(have.checked - j->found) < 0) known = false;
+    if (j->sent_at) {
+        // The batch is judged by the re-check devstate_note_command() asked
+        // for, DEVSTATE_SETTLE_MS after it; an answer much sooner than that
+        // may be to a query that left before the batch went through
+        if (known && (int32_t)(have.checked - j->sent_at) > DEVSTATE_SETTLE_MS / 2)
+            j->sent_at = 0;
+        else if (now - j->sent_at < DEVCONFIG_STATE_WAIT_MS)
+            return DEVCONFIG_SYNCING;
+        else
+            return DEVCONFIG_FAILED;
+    }
+
+    const char* cmds[DEVCONFIG_STEPS_MAX];
+    if (!known) {
+        // Firmware without a status page gets the display command once
+        if (now - j->since < DEVCONFIG_STATE_WAIT_MS) return DEVCONFIG_SYNCING;
+        have.display = DEVSTATE_UNKNOWN;
+        have.mode = -1;
+        have.image = -1;
+        int n = devconfig_plan(&j->want, &have, cmds, DEVCONFIG_STEPS_MAX);
+        j->commands += n;
+        return (n == 0 || send_batch(j->ip, cmds, n)) ? DEVCONFIG_BLIND : DEVCONFIG_FAILED;
+    }
+
+    int n = devconfig_plan(&j->want, &have, cmds, DEVCONFIG_STEPS_MAX);
+    if (n == 0) return DEVCONFIG_DONE;
+    for (int i = 0; i < n; ++i)
+        if (strcmp(cmds[i], DEVCONFIG_CMD_MODE) == 0) j->mode_steps++;
+    if (j->commands + n > DEVCONFIG_STEPS_MAX || j->mode_steps > DEVCONFIG_MODE_STEPS) {
+        debugPrint("[devconfig] Unit %u does not converge\n", (unsigned)j->want.id);
+        return DEVCONFIG_FAILED;
+    }
+    j->commands += n;
+    bool ok = send_batch(j->ip, cmds, n);
+    j->sent_at = SDL_GetTicks();
+    return ok ? DEVCONFIG_SYNCING : DEVCONFIG_FAILED;
+}
+
+// Profile units in the snapshot: by IP first, then by ID among the units no
+// other slot claimed by IP; lock must be held
+static void match_units(const type_d_unit_t* units, int n, uint32_t* found) {
+    for (int i = 0; i < slot_count; ++i) {
+        found[i] = 0;
+        for (int k = 0; k < n && !found[i]; ++k)
+            if (units[k].ip == slots[i].want.ip) found[i] = units[k].ip;
+    }
+    for (int i = 0; i < slot_count; ++i) {
+        for (int k = 0; k < n && !found[i]; ++k) {
+            if (units[k].id != slots[i].want.id) continue;
+            bool taken = false;
+            for (int s = 0; s < slot_count && !taken; ++s)
+                taken = found[s] == units[k].ip || slots[s].want.ip == units[k].ip;
+            if (!taken) found[i] = units[k].ip;
+        }
+    }
+}
+
+static bool any_syncing(void) {
+    for (int i = 0; i < slot_count; ++i)
+        if (slots[i].sync && slots[i].present) return true;
+    return false;
+}
+
+static void publish(void) {
+    if (!event_type) return;
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = event_type;
+    SDL_PushEvent(&e);
+}
+
+static int devconfig_thread_func(void* data) {
+    const detect_snapshot_t* snap = NULL;
+    devconfig_job_t jobs[DEVCONFIG_UNITS];
+    uint32_t found[DEVCONFIG_UNITS];
+    bool was_active = false;
+
+    while (SDL_AtomicGet(&running)) {
+        detect_snapshot_release(snap);
+        snap = detect_snapshot_acquire();
+        int n = 0;
+        const type_d_unit_t* units = snap ? detect_snapshot_units(snap, &n) : NULL;
+        uint32_t now = SDL_GetTicks();
+
+        // A unit that turns up again after a power cut or a DHCP change is
+        // synced without being asked
+        int job_count = 0;
+        SDL_AtomicLock(&lock);
+        match_units(units, n, found);
+        for (int i = 0; i < slot_count; ++i) {
+            devconfig_slot_t* s = &slots[i];
+            // A unit pruned and found again between two passes is only told
+            // apart by its new registry entry
+            const type_d_unit_t* u = found[i] ? detect_snapshot_find(snap, found[i]) : NULL;
+            if (u && (!s->present || u->ip != s->st.ip || u->found != s->found)) {
+                s->present = true;
+                s->sync = true;
+                s->since = now;
+                s->sent_at = 0;
+                s->found = u->found;
+                s->mode_steps = 0;
+                s->st.commands = 0;
+            } else if (!found[i]) {
+                s->present = false;
+            }
+            s->st.ip = found[i];
+            if (!s->sync) continue;
+            if (!s->present) {
+                s->st.state = DEVCONFIG_WAITING;
+                continue;
+            }
+            s->st.state = DEVCONFIG_SYNCING;
+            devconfig_job_t* j = &jobs[job_count++];
+            j->slot = i;
+            j->want = s->want;
+            j->ip = s->st.ip;
+            j->since = s->since;
+            j->sent_at = s->sent_at;
+            j->found = s->found;
+            j->commands = s->st.commands;
+            j->mode_steps = s->mode_steps;
+        }
+        SDL_AtomicUnlock(&lock);
+
+        // Network calls outside the lock; the slot is written back only if
+        // it still syncs the same unit
+        for (int i = 0; i < job_count && SDL_AtomicGet(&running); ++i) {
+            devconfig_job_t* j = &jobs[i];
+            devconfig_state_t st = sync_step(j, SDL_GetTicks());
+            SDL_AtomicLock(&lock);
+            devconfig_slot_t* s = &slots[j->slot];
+            if (j->slot < slot_count && s->sync && s->present && s->st.ip == j->ip && s->since == j->since) {
+                s->sent_at = j->sent_at;
+                s->mode_steps = j->mode_steps;
+                s->st.commands = j->commands;
+                s->st.state = st;
+                s->sync = st == DEVCONFIG_SYNCING;
+            }
+            SDL_AtomicUnlock(&lock);
+        }
+
+        SDL_AtomicLock(&lock);
+        bool active = any_syncing();
+        SDL_AtomicUnlock(&lock);
+        // A sync can start and finish within one pass
+        if ((was_active || job_count > 0) && !active) publish();
+        was_active = active;
+        // Batches wait on a status answer DEVSTATE_SETTLE_MS away; poll for it
+        SDL_SemWaitTimeout(wake, active ? DEVSTATE_SETTLE_MS / 5 : DEVCONFIG_WAIT_MAX_MS);
+    }
+    detect_snapshot_release(snap);
+    return 0;
+}
+
+// Replaces the slots; lock must be held
+static void set_profile(const devconfig_profile_t* p) {
+    memset(slots, 0, sizeof(slots));
+    slot_count = p->count;
+    for (int i = 0; i < slot_count; ++i) {
+        slots[i].want = p->units[i];
+        slots[i].st.id = p->units[i].id;
+    }
+}
+
+void devconfig_start(const char* path) {
+    if (SDL_AtomicGet(&running)) return;
+    if (!event_type) {
+        event_type = SDL_RegisterEvents(1);
+        if (event_type == (Uint32)-1) event_type = 0;
+    }
+    snprintf(profile_path, sizeof(profile_path), "%s", path);
+    static devconfig_profile_t p;     // Main thread only
+    if (devconfig_load(path, &p))
+        debugPrint("[devconfig] Profile with %d units\n", p.count);
+    SDL_AtomicLock(&lock);
+    set_profile(&p);
+    batches = 0;
+    SDL_AtomicUnlock(&lock);
+    if (!wake) wake = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&running, 1);
+    thread = SDL_CreateThread(devconfig_thread_func, "devconfig", NULL);
+    if (!thread) {
+        debugPrint("[devconfig] Thread creation failed\n");
+        SDL_AtomicSet(&running, 0);
+    }
+}
+
+void devconfig_stop(void) {
+    SDL_AtomicSet(&running, 0);
+    if (wake) SDL_SemPost(wake);
+    if (thread) {
+        SDL_WaitThread(thread, NULL);
+        thread = NULL;
+    }
+}
+
+int devconfig_capture(void) {
+    static devconfig_profile_t p;     // Main thread only
+    memset(&p, 0, sizeof(p));
+    const detect_snapshot_t* snap = detect_snapshot_acquire();
+    int n = 0;
+    const type_d_unit_t* units = snap ? detect_snapshot_units(snap, &n) : NULL;
+    for (int i = 0; i < n && p.count < DEVCONFIG_UNITS; ++i) {
+        devstate_t s;
+        if (!devstate_get(units[i].ip, &s)) continue;
+        devconfig_unit_t* u = &p.units[p.count++];
+        u->id = units[i].id;
+        u->ip = units[i].ip;
+        u->display = s.display;
+        u->mode = s.mode;
+        u->image = s.image;
+    }
+    detect_snapshot_release(snap);
+    if (p.count == 0) return 0;
+    if (!devconfig_save(profile_path, &p)) return -1;
+
+    // The units are what the profile says, so there is nothing to sync
+    SDL_AtomicLock(&lock);
+    set_profile(&p);
+    for (int i = 0; i < slot_count; ++i) {
+        slots[i].present = true;
+        slots[i].st.ip = slots[i].want.ip;
+        slots[i].st.state = DEVCONFIG_DONE;
+    }
+    SDL_AtomicUnlock(&lock);
+    return p.count;
+}
+
+bool devconfig_restore(void) {
+    uint32_t now = SDL_GetTicks();
+    SDL_AtomicLock(&lock);
+    for (int i = 0; i < slot_count; ++i) {
+        devconfig_slot_t* s = &slots[i];
+        s->sync = true;
+        s->since = now;
+        s->sent_at = 0;
+        s->mode_steps = 0;
+        s->st.commands = 0;
+        s->st.state = s->present ? DEVCONFIG_SYNCING : DEVCONFIG_WAITING;
+    }
+    batches = 0;
+    int count = slot_count;
+    SDL_AtomicUnlock(&lock);
+    if (wake) SDL_SemPost(wake);
+    return count > 0;
+}
+
+void devconfig_status(devconfig_status_t* out) {
+    memset(out, 0, sizeof(*out));
+    SDL_AtomicLock(&lock);
+    out->active = any_syncing();
+    out->count = slot_count;
+    out->batches = batches;
+    for (int i = 0; i < slot_count; ++i) {
+        out->units[i] = slots[i].st;
+        out->commands += slots[i].st.commands;
+        if (slots[i].st.state == DEVCONFIG_DONE || slots[i].st.state == DEVCONFIG_BLIND) out->done++;
+    }
+    SDL_AtomicUnlock(&lock);
+}
+
+Uint32 devconfig_event_type(void) {
+    return event_type;
+}
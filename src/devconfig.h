@@ -0,0 +1,123 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+#include "devstate.h"
+
+#define DEVCONFIG_PATH          "D:\\typed_rig.cfg"
+#define DEVCONFIG_UNITS         16      // Units one profile can hold
+#define DEVCONFIG_STEPS_MAX     64      // Commands a unit may take to converge before it is given up
+#define DEVCONFIG_MODE_STEPS    8       // Display Mode presses that never reach the wanted mode
+#define DEVCONFIG_STATE_WAIT_MS 3000    // Wait for a unit's state to show the last batch (or at all)
+#define DEVCONFIG_TIMEOUT_MS    1500    // Budget for one pipelined batch
+
+#define DEVCONFIG_CMD_NEXT_IMAGE "0001"
+#define DEVCONFIG_CMD_PREV_IMAGE "0002"
+#define DEVCONFIG_CMD_MODE       "0004"
+
+// A profile is the settings each unit of a rig should have, written to the
+// hard drive as text, one unit per line in the GET /status format:
+//
+//   <id> <ip> display=<0|1>&mode=<n>&img=<n>
+//
+// A field that is missing is left as the unit has it. Only settings a unit
+// reports can be converged; the WiFi commands are actions, not state, and
+// are never part of a profile.
+//
+// Syncing compares each unit's cached state (devstate) with the profile and
+// sends only the difference: Display On first, image steps as one pipelined
+// burst of Next or Previous Image, Display Mode one press at a time since
+// the number of modes is not reported, Display Off last. A batch is checked
+// against the unit's next status answer and the rest is planned from there.
+
+typedef struct {
+    uint8_t  id;
+    uint32_t ip;                      // Host order; matched first, then the ID
+    int8_t   display;                 // DEVSTATE_ON, DEVSTATE_OFF or DEVSTATE_UNKNOWN to leave it
+    int8_t   mode;                    // -1 to leave it
+    int16_t  image;                   // -1 to leave it
+} devconfig_unit_t;
+
+typedef struct {
+    int              count;
+    devconfig_unit_t units[DEVCONFIG_UNITS];
+} devconfig_profile_t;
+
+typedef enum {
+    DEVCONFIG_IDLE = 0,               // Not synced since the profile was loaded
+    DEVCONFIG_WAITING,                // In the profile, not on the network
+    DEVCONFIG_SYNCING,
+    DEVCONFIG_DONE,                   // Reports what the profile asks for
+    DEVCONFIG_BLIND,                  // No status page: display command sent without a check
+    DEVCONFIG_FAILED                  // A batch failed, or the unit did not converge
+} devconfig_state_t;
+
+typedef struct {
+    uint8_t           id;
+    uint32_t          ip;             // Unit synced, 0 while none matches
+    devconfig_state_t state;
+    int               commands;       // Sent by the current or latest sync
+} devconfig_unit_status_t;
+
+typedef struct {
+    bool                    active;   // A unit is still syncing
+    int                     count;    // Units in the profile
+    int                     done;     // DEVCONFIG_DONE or DEVCONFIG_BLIND
+    int                     commands; // Sent by the current or latest sync, all units
+    uint32_t                batches;  // Pipelined batches those commands went out in
+    devconfig_unit_status_t units[DEVCONFIG_UNITS];
+} devconfig_status_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Loads the profile at path, if there is one, and starts the sync thread.
+ * devstate_start() must have been called. A unit of the profile that
+ * (re)appears on the network is synced as soon as its state is known, so a
+ * rig converges by itself after a power cut.
+ */
+void devconfig_start(const char* path);
+void devconfig_stop(void);
+
+/**
+ * Makes the current settings of every discovered unit with known state the
+ * profile and writes it to the path given to devconfig_start().
+ *
+ * @return Units captured, -1 if the file could not be written
+ */
+int devconfig_capture(void);
+
+/**
+ * Syncs every unit of the profile now.
+ *
+ * @return false if there is no profile
+ */
+bool devconfig_restore(void);
+
+void devconfig_status(devconfig_status_t* out);
+
+/**
+ * @return SDL event pushed when a sync finishes (0 before devconfig_start)
+ */
+Uint32 devconfig_event_type(void);
+
+bool devconfig_load(const char* path, devconfig_profile_t* out);
+bool devconfig_save(const char* path, const devconfig_profile_t* p);
+
+/**
+ * Commands that take a unit from have to want, in sending order. Mode gets a
+ * single step; plan again once the unit reports the result.
+ *
+ * Fields the unit does not report are left alone, except the display: On
+ * and Off are safe to repeat, so they go out even when its state is unknown.
+ *
+ * @param cmds Filled with at most max command codes
+ * @return     Number of commands, 0 once the unit matches
+ */
+int devconfig_plan(const devconfig_unit_t* want, const devstate_t* have, const char** cmds, int max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,298 @@
+#include "devstate.h"
+#include "detect.h"
+#include "send_cmd.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+
+#define DEVSTATE_WAIT_MAX_MS  250     // Longest sleep so devstate_stop() is noticed
+
+typedef struct {
+    devstate_t s;                     // s.ip == 0: free slot
+    char       etag[SEND_CMD_ETAG_MAX];
+    uint32_t   next_poll;
+    uint32_t   last_listed;           // Poll round that last saw the unit in the registry
+    uint32_t   fed;                   // status_seen of the discovery reply applied last
+    uint32_t   found;                 // type_d_unit_t.found of the unit polled
+    uint8_t    misses;
+    bool       unsupported;           // Answered 404 or similar: firmware without a status page
+} devstate_entry_t;
+
+static devstate_entry_t entries[DEVSTATE_UNITS];
+static SDL_SpinLock lock = 0;         // Guards entries[]
+static SDL_atomic_t generation;
+static SDL_atomic_t running;
+static SDL_sem* wake = NULL;
+static SDL_Thread* thread = NULL;
+static Uint32 event_type = 0;
+static uint32_t round_no = 0;         // Poll thread only
+
+// Entry for ip, or NULL; lock must be held
+static devstate_entry_t* entry_find(uint32_t ip) {
+    for (int i = 0; i < DEVSTATE_UNITS; ++i) {
+        if (entries[i].s.ip == ip) return &entries[i];
+    }
+    return NULL;
+}
+
+// Finds or claims the entry for ip, recycling one whose unit has left the
+// registry; lock must be held
+static devstate_entry_t* entry_claim(uint32_t ip, uint32_t now) {
+    devstate_entry_t* e = entry_find(ip);
+    if (e) return e;
+    for (int i = 0; i < DEVSTATE_UNITS && !e; ++i) {
+        if (entries[i].s.ip == 0 || entries[i].last_listed != round_no) e = &entries[i];
+    }
+    if (!e) return NULL;
+    memset(e, 0, sizeof(*e));
+    e->s.ip = ip;
+    e->s.display = DEVSTATE_UNKNOWN;
+    e->s.mode = -1;
+    e->s.image = -1;
+    e->next_poll = now;
+    return e;
+}
+
+// The unit left the registry and is back, usually after a power cut: what
+// the entry holds is from before, and the unit has booted with its
+// defaults. Polled now, without the old ETag. Lock must be held; returns
+// true if the state changed.
+static bool entry_reset(devstate_entry_t* e, uint32_t now) {
+    bool changed = e->s.known;
+    e->s.known = false;
+    e->etag[0] = 0;
+    e->misses = 0;
+    e->next_poll = now;
+    return changed;
+}
+
+static void publish(void) {
+    SDL_AtomicAdd(&generation, 1);
+    if (event_type) {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = event_type;
+        SDL_PushEvent(&e);
+    }
+}
+
+// Same fields as a version 2 discovery reply; those not present keep their
+// old value
+static void parse_status(const char* body, int len, devstate_t* s) {
+    detect_reply_t r;
+    memset(&r, 0, sizeof(r));
+    r.display = s->display;
+    r.mode = s->mode;
+    r.image = s->image;
+    detect_parse_status(body, len, &r);
+    s->display = r.display;
+    s->mode = r.mode;
+    s->image = r.image;
+}
+
+static bool state_differs(const devstate_t* a, const devstate_t* b) {
+    return a->known != b->known || a->display != b->display ||
+           a->mode != b->mode || a->image != b->image;
+}
+
+// Status from a version 2 discovery reply counts as a poll answer, so the
+// next poll is put off; lock must be held. Returns true if the state changed.
+static bool apply_discovery(devstate_entry_t* e, const type_d_unit_t* u) {
+    devstate_t before = e->s;
+    e->fed = u->status_seen;
+    e->misses = 0;
+    e->s.known = true;
+    e->s.display = u->info.display;
+    e->s.mode = u->info.mode;
+    e->s.image = u->info.image;
+    e->s.checked = u->status_seen;
+    uint32_t next = u->status_seen + DEVSTATE_FED_POLL_MS;
+    if ((int32_t)(next - e->next_poll) > 0) e->next_poll = next;
+    return state_differs(&before, &e->s);
+}
+
+static void poll_unit(uint32_t ip) {
+    char etag[SEND_CMD_ETAG_MAX];
+    SDL_AtomicLock(&lock);
+    devstate_entry_t* e = entry_find(ip);
+    snprintf(etag, sizeof(etag), "%s", e ? e->etag : "");
+    SDL_AtomicUnlock(&lock);
+    if (!e) return;
+
+    // detect_ipstr() belongs to the main thread
+    char host[16];
+    snprintf(host, sizeof(host), "%u.%u.%u.%u",
+             (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+    static send_cmd_response_t resp;  // Poll thread only
+    bool got = send_cmd_get(host, DEVSTATE_PATH, etag[0] ? etag : NULL,
+                            &resp, DEVSTATE_TIMEOUT_MS);
+    uint32_t now = SDL_GetTicks();
+
+    bool changed = false;
+    SDL_AtomicLock(&lock);
+    e = entry_find(ip);
+    if (e) {
+        devstate_t before = e->s;
+        e->next_poll = now + DEVSTATE_POLL_MS;
+        if (!got) {
+            // Quiet for a while: whatever we knew may be stale now
+            if (++e->misses >= DEVSTATE_MISSES) {
+                e->s.known = false;
+                e->etag[0] = 0;
+            }
+        } else if (resp.status == 304) {
+            e->misses = 0;
+            e->s.checked = now;
+        } else if (resp.status >= 200 && resp.status < 300) {
+            e->misses = 0;
+            e->unsupported = false;
+            e->s.known = true;
+            e->s.checked = now;
+            parse_status(resp.body, resp.body_len, &e->s);
+            snprintf(e->etag, sizeof(e->etag), "%s", resp.etag);
+        } else {
+            // Older firmware: the menu still works, there is just nothing to show
+            if (!e->unsupported)
+                debugPrint("[devstate] %s has no status page (%d)\n", host, resp.status);
+            e->unsupported = true;
+            e->s.known = false;
+            e->etag[0] = 0;
+            e->next_poll = now + DEVSTATE_UNSUPPORTED_MS;
+        }
+        changed = state_differs(&before, &e->s);
+    }
+    SDL_AtomicUnlock(&lock);
+    if (changed) publish();
+}
+
+static int devstate_thread_func(void* data) {
+    const detect_snapshot_t* snap = NULL;
+    uint32_t due[DEVSTATE_UNITS];
+
+    while (SDL_AtomicGet(&running)) {
+        // Every round, not just on a generation bump: discovery replies carry
+        // status without changing the set of units
+        detect_snapshot_release(snap);
+        snap = detect_snapshot_acquire();
+        int n = 0;
+        const type_d_unit_t* units = snap ? detect_snapshot_units(snap, &n) : NULL;
+        if (n > DEVSTATE_UNITS) n = DEVSTATE_UNITS;
+
+        // Collect the units due now; the network calls happen outside the lock
+        uint32_t now = SDL_GetTicks();
+        uint32_t wait = DEVSTATE_WAIT_MAX_MS;
+        int due_count = 0;
+        bool changed = false;
+        round_no++;
+        SDL_AtomicLock(&lock);
+        for (int i = 0; i < n; ++i) {
+            devstate_entry_t* e = entry_find(units[i].ip);
+            if (e) e->last_listed = round_no;
+        }
+        for (int i = 0; i < n; ++i) {
+            devstate_entry_t* e = entry_claim(units[i].ip, now);
+            if (!e) continue;
+            e->last_listed = round_no;
+            if (e->found != units[i].found) {
+                if (e->found) changed |= entry_reset(e, now);
+                e->found = units[i].found;
+            }
+            if (units[i].status_seen && units[i].status_seen != e->fed)
+                changed |= apply_discovery(e, &units[i]);
+            int32_t left = (int32_t)(e->next_poll - now);
+            if (left <= 0)
+                due[due_count++] = e->s.ip;
+            else if ((uint32_t)left < wait)
+                wait = (uint32_t)left;
+        }
+        SDL_AtomicUnlock(&lock);
+        if (changed) publish();
+
+        for (int i = 0; i < due_count && SDL_AtomicGet(&running); ++i)
+            poll_unit(due[i]);
+        if (due_count == 0)
+            SDL_SemWaitTimeout(wake, wait);
+    }
+    detect_snapshot_release(snap);
+    return 0;
+}
+
+void devstate_start(void) {
+    if (SDL_AtomicGet(&running)) return;
+    if (!event_type) {
+        event_type = SDL_RegisterEvents(1);
+        if (event_type == (Uint32)-1) event_type = 0;
+    }
+    memset(entries, 0, sizeof(entries));
+    if (!wake) wake = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&running, 1);
+    thread = SDL_CreateThread(devstate_thread_func, "devstate", NULL);
+    if (!thread) {
+        debugPrint("[devstate] Thread creation failed\n");
+        SDL_AtomicSet(&running, 0);
+    }
+}
+
+void devstate_stop(void) {
+    SDL_AtomicSet(&running, 0);
+    if (wake) SDL_SemPost(wake);
+    if (thread) {
+        SDL_WaitThread(thread, NULL);
+        thread = NULL;
+    }
+}
+
+uint32_t devstate_generation(void) {
+    return (uint32_t)SDL_AtomicGet(&generation);
+}
+
+Uint32 devstate_event_type(void) {
+    return event_type;
+}
+
+bool devstate_get(uint32_t ip, devstate_t* out) {
+    SDL_AtomicLock(&lock);
+    devstate_entry_t* e = entry_find(ip);
+    if (e) *out = e->s;
+    SDL_AtomicUnlock(&lock);
+    if (!e) {
+        memset(out, 0, sizeof(*out));
+        out->ip = ip;
+        out->display = DEVSTATE_UNKNOWN;
+        out->mode = -1;
+        out->image = -1;
+    }
+    return out->known;
+}
+
+bool devstate_redundant(uint32_t ip, const char* cmd) {
+    if (!cmd) return false;
+    devstate_t s;
+    if (!devstate_get(ip, &s) || SDL_GetTicks() - s.checked > DEVSTATE_FRESH_MS) return false;
+    if (strcmp(cmd, DEVSTATE_CMD_DISPLAY_ON) == 0) return s.display == DEVSTATE_ON;
+    if (strcmp(cmd, DEVSTATE_CMD_DISPLAY_OFF) == 0) return s.display == DEVSTATE_OFF;
+    return false;
+}
+
+void devstate_note_command(uint32_t ip, const char* cmd, bool ok) {
+    if (!ok || !cmd) return;
+    bool changed = false;
+    SDL_AtomicLock(&lock);
+    devstate_entry_t* e = entry_find(ip);
+    if (e && !e->unsupported) {
+        // Shown straight away; the re-check has the final word. It goes out
+        // without the ETag, or a unit that did not bump its version would
+        // answer 304 and leave the guess standing.
+        int8_t display = e->s.display;
+        if (strcmp(cmd, DEVSTATE_CMD_DISPLAY_ON) == 0) display = DEVSTATE_ON;
+        else if (strcmp(cmd, DEVSTATE_CMD_DISPLAY_OFF) == 0) display = DEVSTATE_OFF;
+        changed = e->s.known && display != e->s.display;
+        if (e->s.known) e->s.display = display;
+        e->etag[0] = 0;
+        e->next_poll = SDL_GetTicks() + DEVSTATE_SETTLE_MS;
+    }
+    SDL_AtomicUnlock(&lock);
+    // The poll thread never sleeps longer than DEVSTATE_WAIT_MAX_MS, so it
+    // picks up the new deadline without a wake-up
+    if (changed) publish();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+
+#define DEVSTATE_UNITS          32      // Units polled, in detect snapshot order (numbered units first)
+#define DEVSTATE_PATH           "/status"
+#define DEVSTATE_POLL_MS        2000    // Conditional re-check of each unit
+#define DEVSTATE_SETTLE_MS      250     // Re-check this soon after a command went through
+#define DEVSTATE_TIMEOUT_MS     500     // Budget for one status query
+#define DEVSTATE_MISSES         3       // Unanswered polls in a row before the state is forgotten
+#define DEVSTATE_UNSUPPORTED_MS 30000   // Re-check of a unit whose firmware has no status page
+#define DEVSTATE_FRESH_MS       (DEVSTATE_POLL_MS * 3)   // Older state is not trusted to skip a command
+#define DEVSTATE_FED_POLL_MS    10000   // Backstop poll of a unit whose discovery replies carry its state
+
+#define DEVSTATE_CMD_DISPLAY_ON  "0060"
+#define DEVSTATE_CMD_DISPLAY_OFF "0061"
+
+// Status query: GET /status with If-None-Match set to the last ETag. The unit
+// answers 304 with no body while nothing changed, else 200, a new ETag and
+//
+//   img=<index>&display=<0|1>&mode=<n>
+//
+// Unknown keys are ignored and missing ones stay unknown. Units with version 2
+// firmware report the same fields in every discovery reply (see detect.h);
+// their state comes from there and they are only polled after a command and
+// every DEVSTATE_FED_POLL_MS.
+
+enum {
+    DEVSTATE_UNKNOWN = -1,
+    DEVSTATE_OFF     = 0,
+    DEVSTATE_ON      = 1
+};
+
+typedef struct {
+    uint32_t ip;                      // Host order, as in type_d_unit_t
+    bool     known;                   // Answered a status query and has not gone quiet since
+    int8_t   display;                 // DEVSTATE_ON, DEVSTATE_OFF or DEVSTATE_UNKNOWN
+    int8_t   mode;                    // Display mode, -1 if not reported
+    int16_t  image;                   // Image on the panel, -1 if not reported
+    uint32_t checked;                 // SDL_GetTicks() of the latest answer, 200 or 304
+} devstate_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts polling the units in the detect registry. detect_start() must have
+ * been called.
+ */
+void devstate_start(void);
+void devstate_stop(void);
+
+/**
+ * Bumped whenever a unit's display, mode or image changes or it is forgotten.
+ */
+uint32_t devstate_generation(void);
+
+/**
+ * @return SDL event pushed on every generation bump (0 before devstate_start)
+ */
+Uint32 devstate_event_type(void);
+
+/**
+ * Copies the cached state of a unit. Never waits on the network.
+ *
+ * @return false if the unit has never answered (out->known is false too)
+ */
+bool devstate_get(uint32_t ip, devstate_t* out);
+
+/**
+ * @return true if cmd would leave the unit as it is, going by fresh state
+ *         (Display On to a panel that is already on)
+ */
+bool devstate_redundant(uint32_t ip, const char* cmd);
+
+/**
+ * Applies the known effect of a command that went through and re-checks the
+ * unit shortly after.
+ */
+void devstate_note_command(uint32_t ip, const char* cmd, bool ok);
+
+#ifdef __cplusplus
+}
+#endif
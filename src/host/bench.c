@@ -0,0 +1,1044 @@
+// Host benchmarks for the hot paths that do not need console hardware:
+// frame rendering, discovery, command round trips, input latency, status
+// queries, uploads, the compositor and music decoding. Every case runs a
+// fixed number of iterations after a warm-up and prints one line of
+// percentiles in microseconds, so two runs can be diffed directly.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include "detect.h"
+#include "send_cmd.h"
+#include "cmd_queue.h"
+#include "telemetry.h"
+#include "text_cache.h"
+#include "octagon.h"
+#include "damage.h"
+#include "ui.h"
+#include "assets.h"
+#include "upload.h"
+#include "devstate.h"
+#include "devconfig.h"
+#include "compose.h"
+#include "memstat.h"
+#include "wav.h"
+#include "wav_encode.h"
+#include "audio_stream.h"
+#include "mock_unit.h"
+
+#define BENCH_MAX_SAMPLES   1000
+#define RENDER_WARMUP       20
+#define RENDER_FRAMES       300
+#define RENDER_SOAK_FRAMES  1000      // Long enough to cycle the text cache several times
+#define STARTUP_RUNS        10
+#define DETECT_RUNS         20
+#define DETECT_UNITS        3
+#define DETECT_MANY_UNITS   200       // Large installation, well past the old 6-unit table
+#define DETECT_MANY_RUNS    5
+#define DETECT_GIVE_UP_MS   2000
+#define DETECT_SWEEP_RUNS   3
+#define DETECT_SWEEP_GIVE_UP_MS 6000  // A whole /24 at DETECT_UNICAST_PPS, with room to spare
+#define DETECT_SWEEP_HOLD_MS 6000     // Past the 5 s unit timeout
+#define RTT_WARMUP          20
+#define RTT_ITERATIONS      500
+#define RTT_COLD_ITERATIONS 100
+#define STATE_ITERATIONS    500
+#define STATE_STARTUP_RUNS  10
+#define INPUT_ITERATIONS    300
+#define CONFIG_RUNS         5
+#define CONFIG_GIVE_UP_MS   10000
+#define CONFIG_PRUNE_GIVE_UP_MS 8000  // Past the 5 s unit timeout
+#define CONFIG_FILE         "bench_rig.cfg"
+#define COMPOSE_WARMUP      10
+#define COMPOSE_ITERATIONS  200
+#define UPLOAD_BYTES        (4 * 1024 * 1024 + 123)   // Not a whole number of chunks
+#define UPLOAD_RUNS         5
+#define UPLOAD_GIVE_UP_MS   30000
+#define UPLOAD_FILE         "bench_upload.bin"
+#define AUDIO_SECONDS       4
+#define AUDIO_STEP_FRAMES   4096      // One ring refill step on the console (AUDIO_DECODE_CHUNK)
+#define AUDIO_ITERATIONS    200
+#define AUDIO_STREAM_MS     3000      // Playback through the ring at the device's pace
+
+typedef struct {
+    const char* name;
+    double      us[BENCH_MAX_SAMPLES];
+    int         count;
+    int         failures;
+} bench_t;
+
+static Uint64 perf_freq;
+
+static Uint64 now_ticks(void) {
+    return SDL_GetPerformanceCounter();
+}
+
+static double elapsed_us(Uint64 since) {
+    return (double)(SDL_GetPerformanceCounter() - since) * 1e6 / (double)perf_freq;
+}
+
+static void bench_begin(bench_t* b, const char* name) {
+    b->name = name;
+    b->count = 0;
+    b->failures = 0;
+}
+
+static void bench_add(bench_t* b, double us) {
+    if (b->count < BENCH_MAX_SAMPLES) b->us[b->count++] = us;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of the sorted samples
+static double percentile(const bench_t* b, int pct) {
+    int rank = (b->count * pct + 99) / 100;
+    if (rank < 1) rank = 1;
+    return b->us[rank - 1];
+}
+
+static void bench_report(bench_t* b) {
+    if (b->count == 0) {
+        printf("%-24s n=0 failures=%d\n", b->name, b->failures);
+        return;
+    }
+    qsort(b->us, b->count, sizeof(b->us[0]), cmp_double);
+    double sum = 0;
+    for (int i = 0; i < b->count; ++i) sum += b->us[i];
+    printf("%-24s n=%-4d mean=%9.1f p50=%9.1f p95=%9.1f p99=%9.1f max=%9.1f failures=%d\n",
+        b->name, b->count, sum / b->count, percentile(b, 50), percentile(b, 95),
+        percentile(b, 99), b->us[b->count - 1], b->failures);
+}
+
+// ---- Rendering ----------------------------------------------------------
+
+// Draws cur the way the main loop does: only the rects that differ from prev
+static void draw_damaged(SDL_Renderer* r, const ui_state_t* prev, const ui_state_t* cur) {
+    ui_damage(prev, cur);
+    int count = 0;
+    const SDL_Rect* dirty = damage_rects(&count);
+    for (int i = 0; i < count; ++i) {
+        SDL_RenderSetClipRect(r, &dirty[i]);
+        ui_render(cur);
+    }
+    SDL_RenderSetClipRect(r, NULL);
+    SDL_RenderPresent(r);
+    damage_clear();
+}
+
+static void bench_render(const char* media) {
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_RGB888);
+    SDL_Renderer* r = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    if (!r) {
+        fprintf(stderr, "bench: software renderer failed: %s\n", SDL_GetError());
+        if (target) SDL_FreeSurface(target);
+        return;
+    }
+    text_cache_init(r);
+    octagon_init(r);
+    ui_assets_t assets;
+    assets_load_start(media, screen_width, screen_height);
+    assets_load_finish(r, &assets);
+    if (!assets.title_font || !assets.exit_font) {
+        fprintf(stderr, "bench: cannot load fonts from %s\n", media);
+        assets_free(&assets);
+        text_cache_shutdown();
+        octagon_shutdown();
+        SDL_DestroyRenderer(r);
+        SDL_FreeSurface(target);
+        return;
+    }
+    assets.screen_format = target->format->format;
+    ui_init(r, &assets);
+    damage_init(screen_width, screen_height);
+
+    ui_state_t base = {0};
+    base.selected_idx = -1;
+    for (int i = 0; i < 3; ++i) {
+        base.device_present[i] = 1;
+        base.device_ip[i] = mock_unit_ip(i);
+    }
+    bench_t b;
+
+    // Whole screen, menu moving every frame
+    bench_begin(&b, "render.full_menu");
+    for (int i = 0; i < RENDER_WARMUP + RENDER_FRAMES; ++i) {
+        ui_state_t st = base;
+        st.menu_selected = i % MENU_ITEM_COUNT;
+        Uint64 t0 = now_ticks();
+        ui_render(&st);
+        SDL_RenderPresent(r);
+        if (i >= RENDER_WARMUP) bench_add(&b, elapsed_us(t0));
+    }
+    bench_report(&b);
+
+    bench_begin(&b, "render.full_about");
+    for (int i = 0; i < RENDER_WARMUP + RENDER_FRAMES; ++i) {
+        ui_state_t st = base;
+        st.about_visible = true;
+        Uint64 t0 = now_ticks();
+        ui_render(&st);
+        SDL_RenderPresent(r);
+        if (i >= RENDER_WARMUP) bench_add(&b, elapsed_us(t0));
+    }
+    bench_report(&b);
+
+    // One D-pad step per frame, damage rects only
+    bench_begin(&b, "render.damage_nav");
+    ui_state_t prev = base;
+    ui_render(&prev);
+    for (int i = 0; i < RENDER_WARMUP + RENDER_FRAMES; ++i) {
+        ui_state_t st = prev;
+        st.menu_selected = (prev.menu_selected + 1) % MENU_ITEM_COUNT;
+        Uint64 t0 = now_ticks();
+        draw_damaged(r, &prev, &st);
+        if (i >= RENDER_WARMUP) bench_add(&b, elapsed_us(t0));
+        prev = st;
+    }
+    bench_report(&b);
+
+    // Status line text changing every frame
+    bench_begin(&b, "render.damage_status");
+    for (int i = 0; i < RENDER_WARMUP + RENDER_FRAMES; ++i) {
+        ui_state_t st = prev;
+        st.status_kind = (i & 1) ? UI_STATUS_OK : UI_STATUS_PENDING;
+        snprintf(st.status, sizeof(st.status), "Unit %d: %d ms", i % 4 + 1, i);
+        Uint64 t0 = now_ticks();
+        draw_damaged(r, &prev, &st);
+        if (i >= RENDER_WARMUP) bench_add(&b, elapsed_us(t0));
+        prev = st;
+    }
+    bench_report(&b);
+
+    // Diagnostics page open, its numbers refreshed every frame
+    bench_begin(&b, "render.damage_diag");
+    prev = base;
+    prev.diag_visible = true;
+    ui_render(&prev);
+    for (int i = 0; i < RENDER_WARMUP + RENDER_FRAMES; ++i) {
+        ui_state_t st = prev;
+        st.diag_serial++;
+        Uint64 t0 = now_ticks();
+        draw_damaged(r, &prev, &st);
+        if (i >= RENDER_WARMUP) bench_add(&b, elapsed_us(t0));
+        prev = st;
+    }
+    bench_report(&b);
+
+    // Unattended session: a new status string every frame keeps the text cache
+    // evicting, the diagnostics page refreshes from the frame arena. Once the
+    // cache is full, the second half must not grow.
+    bench_begin(&b, "render.soak");
+    prev = base;
+    ui_render(&prev);
+    mem_report_t half, end;
+    telemetry_report_t all;
+    telemetry_get_all(&all);
+    for (int i = 0; i < RENDER_SOAK_FRAMES; ++i) {
+        if (i == RENDER_SOAK_FRAMES / 2) mem_report(&half, false);
+        ui_state_t st = prev;
+        snprintf(st.status, sizeof(st.status), "Unit %d: %d ms", i % 4 + 1, i);
+        st.status_kind = UI_STATUS_OK;
+        Uint64 t0 = now_ticks();
+        mem_frame_reset();
+        if (i % 30 == 0) {
+            ui_diag_row_t* rows = (ui_diag_row_t*)mem_frame_alloc(sizeof(ui_diag_row_t) * TELEMETRY_UNITS);
+            mem_report_t mem;
+            mem_report(&mem, false);
+            audio_stats_t audio;
+            audio_stream_stats(&audio);
+            if (rows) ui_set_diagnostics(rows, 0, 0, &all, &mem, &audio);
+        }
+        draw_damaged(r, &prev, &st);
+        bench_add(&b, elapsed_us(t0));
+        prev = st;
+    }
+    bench_report(&b);
+    mem_report(&end, true);
+    uint32_t tex_half = 0, tex_end = 0, allocs_half = 0, allocs_end = 0;
+    for (int s = 0; s < MEM_SUBSYS_COUNT; ++s) {
+        tex_half += half.sub[s].texture_bytes;
+        tex_end += end.sub[s].texture_bytes;
+        allocs_half += half.sub[s].heap_allocs;
+        allocs_end += end.sub[s].heap_allocs;
+    }
+    printf("%-24s heap %+d bytes, textures %+d bytes over the second half; %.2f allocs per frame; "
+           "arena peak %u, spills %u\n", b.name, (int)(end.heap_bytes - half.heap_bytes),
+           (int)(tex_end - tex_half), (double)(allocs_end - allocs_half) / (RENDER_SOAK_FRAMES / 2),
+           (unsigned)end.frame_peak, (unsigned)end.frame_spills);
+
+    ui_shutdown();
+    assets_free(&assets);
+    text_cache_shutdown();
+    octagon_shutdown();
+    SDL_DestroyRenderer(r);
+    SDL_FreeSurface(target);
+}
+
+// Asset load to the first full frame, as main() does it after the splash.
+// Reported as startup.pack or startup.loose depending on what was found.
+static void bench_startup(const char* media) {
+    bench_t b;
+    bool from_pack = false;
+    bench_begin(&b, "startup.loose");
+    for (int i = 0; i < STARTUP_RUNS; ++i) {
+        SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_RGB888);
+        SDL_Renderer* r = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+        if (!r) {
+            b.failures++;
+            if (target) SDL_FreeSurface(target);
+            continue;
+        }
+        Uint64 t0 = now_ticks();
+        text_cache_init(r);
+        octagon_init(r);
+        assets_load_start(media, screen_width, screen_height);
+        ui_assets_t assets;
+        from_pack = assets_load_finish(r, &assets);
+        assets.screen_format = target->format->format;
+        ui_init(r, &assets);
+        ui_state_t st = {0};
+        st.selected_idx = -1;
+        ui_render(&st);
+        SDL_RenderPresent(r);
+        bench_add(&b, elapsed_us(t0));
+
+        ui_shutdown();
+        assets_free(&assets);
+        text_cache_shutdown();
+        octagon_shutdown();
+        SDL_DestroyRenderer(r);
+        SDL_FreeSurface(target);
+    }
+    if (from_pack) b.name = "startup.pack";
+    bench_report(&b);
+}
+
+// ---- Discovery ----------------------------------------------------------
+
+static int published_units(void) {
+    int count;
+    const detect_snapshot_t* snap = detect_snapshot_acquire();
+    detect_snapshot_units(snap, &count);
+    detect_snapshot_release(snap);
+    return count;
+}
+
+// Waits for the published table to reach want units; microseconds since t0 or -1
+static double wait_units(int want, Uint64 t0, Uint32 give_up_ms) {
+    Uint32 stop = SDL_GetTicks() + give_up_ms;
+    while (!SDL_TICKS_PASSED(SDL_GetTicks(), stop)) {
+        if (published_units() >= want)
+            return elapsed_us(t0);
+        SDL_Event e;
+        SDL_WaitEventTimeout(&e, 1);
+    }
+    return -1;
+}
+
+static void bench_detect(void) {
+    if (!mock_discovery_start(DETECT_UNITS, 1)) {
+        fprintf(stderr, "bench: discovery mock failed\n");
+        return;
+    }
+    bench_t first, all, announce;
+    bench_begin(&first, "detect.first_unit");
+    bench_begin(&all, "detect.all_units");
+    bench_begin(&announce, "detect.announce");
+
+    for (int run = 0; run < DETECT_RUNS; ++run) {
+        mock_discovery_set_count(DETECT_UNITS);
+        Uint64 t0 = now_ticks();
+        detect_start();
+
+        double us = wait_units(1, t0, DETECT_GIVE_UP_MS);
+        if (us < 0) first.failures++; else bench_add(&first, us);
+        us = wait_units(DETECT_UNITS, t0, DETECT_GIVE_UP_MS);
+        if (us < 0) all.failures++; else bench_add(&all, us);
+
+        // A unit that boots later and announces itself
+        mock_discovery_set_count(DETECT_UNITS + 1);
+        t0 = now_ticks();
+        mock_discovery_announce(DETECT_UNITS);
+        us = wait_units(DETECT_UNITS + 1, t0, DETECT_GIVE_UP_MS);
+        if (us < 0) announce.failures++; else bench_add(&announce, us);
+
+        detect_stop();
+    }
+    bench_report(&first);
+    bench_report(&all);
+    bench_report(&announce);
+
+    bench_t many;
+    bench_begin(&many, "detect.many_units");
+    mock_discovery_set_count(DETECT_MANY_UNITS);
+    for (int run = 0; run < DETECT_MANY_RUNS; ++run) {
+        Uint64 t0 = now_ticks();
+        detect_start();
+        double us = wait_units(DETECT_MANY_UNITS, t0, DETECT_GIVE_UP_MS);
+        if (us < 0) many.failures++; else bench_add(&many, us);
+        detect_stop();
+    }
+    bench_report(&many);
+
+    // Broadcasts dropped on the way: the sweep has to find the units and the
+    // re-probes keep them, within the unicast budget
+    bench_t sweep;
+    bench_begin(&sweep, "detect.sweep_units");
+    mock_discovery_set_broadcast(false);
+    int lost = 0;
+    uint32_t unicast = 0;
+    double seconds = 0;
+    for (int run = 0; run < DETECT_SWEEP_RUNS; ++run) {
+        Uint64 t0 = now_ticks();
+        detect_start();
+        double us = wait_units(DETECT_MANY_UNITS, t0, DETECT_SWEEP_GIVE_UP_MS);
+        if (us < 0) sweep.failures++; else bench_add(&sweep, us);
+        Uint32 stop = SDL_GetTicks() + DETECT_SWEEP_HOLD_MS;
+        while (us >= 0 && !SDL_TICKS_PASSED(SDL_GetTicks(), stop)) {
+            if (published_units() < DETECT_MANY_UNITS) {
+                lost++;
+                break;
+            }
+            SDL_Delay(10);
+        }
+        detect_strategy_stats_t st[DETECT_STRATEGY_COUNT];
+        detect_strategy_stats(st);
+        unicast += st[DETECT_UNICAST_REPROBE].sent + st[DETECT_UNICAST_SWEEP].sent;
+        seconds += elapsed_us(t0) / 1e6;
+        detect_stop();
+    }
+    mock_discovery_set_broadcast(true);
+    bench_report(&sweep);
+    printf("%-24s %d runs lost a unit; %.1f unicast probes per second\n", sweep.name, lost, unicast / seconds);
+    mock_discovery_stop();
+}
+
+// ---- Commands -----------------------------------------------------------
+
+static void bench_rtt(void) {
+    if (!mock_http_start()) {
+        fprintf(stderr, "bench: HTTP mock failed\n");
+        return;
+    }
+    const char* ip = MOCK_UNIT_BASE_IP;
+    bench_t b;
+
+    bench_begin(&b, "rtt.keepalive");
+    for (int i = 0; i < RTT_WARMUP + RTT_ITERATIONS; ++i) {
+        Uint64 t0 = now_ticks();
+        bool ok = send_cmd_timeout(ip, "0001", NULL, SEND_CMD_TIMEOUT_MS);
+        double us = elapsed_us(t0);
+        if (i < RTT_WARMUP) continue;
+        if (ok) bench_add(&b, us); else b.failures++;
+    }
+    bench_report(&b);
+
+    // Fresh TCP connection every time, as before the keep-alive pool
+    bench_begin(&b, "rtt.cold_connect");
+    for (int i = 0; i < RTT_COLD_ITERATIONS; ++i) {
+        send_cmd_pool_flush();
+        Uint64 t0 = now_ticks();
+        bool ok = send_cmd_timeout(ip, "0001", "val=50", SEND_CMD_TIMEOUT_MS);
+        double us = elapsed_us(t0);
+        if (ok) bench_add(&b, us); else b.failures++;
+    }
+    bench_report(&b);
+
+    bench_begin(&b, "rtt.pipeline4");
+    for (int i = 0; i < RTT_WARMUP + RTT_ITERATIONS; ++i) {
+        send_cmd_req_t reqs[SEND_CMD_PIPELINE_MAX] = {
+            {.cmd_hex = "0001"}, {.cmd_hex = "0002"},
+            {.cmd_hex = "0003", .hex_arg = "val=50"}, {.cmd_hex = "0004"},
+        };
+        Uint64 t0 = now_ticks();
+        int ok = send_cmd_pipeline(ip, reqs, SEND_CMD_PIPELINE_MAX, SEND_CMD_TIMEOUT_MS);
+        double us = elapsed_us(t0);
+        if (i < RTT_WARMUP) continue;
+        if (ok == SEND_CMD_PIPELINE_MAX) bench_add(&b, us); else b.failures++;
+    }
+    bench_report(&b);
+
+    send_cmd_pool_flush();
+    mock_http_stop();
+}
+
+// ---- Input latency ------------------------------------------------------
+
+// Press to wire and press to ack through the command queue, as main() submits
+// them: the worker threads, the pooled connection and the completion event
+static void bench_input(void) {
+    if (!mock_http_start() || !cmd_queue_start()) {
+        fprintf(stderr, "bench: HTTP mock or command queue failed\n");
+        mock_http_stop();
+        return;
+    }
+    uint32_t ip = mock_unit_ip(0);
+    bench_t wire, ack, event;
+    bench_begin(&wire, "input.wire");
+    bench_begin(&ack, "input.ack");
+    bench_begin(&event, "input.result_event");
+
+    for (int i = 0; i < RTT_WARMUP + INPUT_ITERATIONS; ++i) {
+        uint64_t input_us = telemetry_now_us();
+        if (!cmd_queue_submit(ip, "0001", NULL, SEND_CMD_TIMEOUT_MS, 0, input_us)) {
+            wire.failures++;
+            continue;
+        }
+        const cmd_result_t* res = NULL;
+        SDL_Event e;
+        while (!res && SDL_WaitEventTimeout(&e, SEND_CMD_TIMEOUT_MS * 2))
+            res = cmd_queue_result(&e);
+        if (!res) {
+            ack.failures++;
+            continue;
+        }
+        double done_us = (double)(telemetry_now_us() - input_us);
+        if (i >= RTT_WARMUP) {
+            if (res->ok && res->wire_us) bench_add(&wire, res->wire_us); else wire.failures++;
+            if (res->ok && res->ack_us) bench_add(&ack, res->ack_us); else ack.failures++;
+            bench_add(&event, done_us);
+        }
+        cmd_queue_release(&e);
+    }
+    bench_report(&wire);
+    bench_report(&ack);
+    bench_report(&event);
+
+    cmd_queue_stop();
+    mock_http_stop();
+}
+
+// ---- Status queries -----------------------------------------------------
+
+// Waits for devstate to know the unit at ip; microseconds since t0 or -1
+static double wait_state(uint32_t ip, Uint64 t0, Uint32 give_up_ms) {
+    Uint32 stop = SDL_GetTicks() + give_up_ms;
+    devstate_t st;
+    while (!SDL_TICKS_PASSED(SDL_GetTicks(), stop)) {
+        if (devstate_get(ip, &st))
+            return elapsed_us(t0);
+        SDL_Event e;
+        SDL_WaitEventTimeout(&e, 1);
+    }
+    return -1;
+}
+
+// What a devstate poll costs with and without a matching ETag
+static void bench_state(void) {
+    if (!mock_http_start()) {
+        fprintf(stderr, "bench: HTTP mock failed\n");
+        return;
+    }
+    const char* ip = MOCK_UNIT_BASE_IP;
+    static send_cmd_response_t resp;
+    char etag[SEND_CMD_ETAG_MAX] = "";
+    bench_t b;
+
+    bench_begin(&b, "state.full");
+    for (int i = 0; i < RTT_WARMUP + STATE_ITERATIONS; ++i) {
+        Uint64 t0 = now_ticks();
+        bool ok = send_cmd_get(ip, DEVSTATE_PATH, NULL, &resp, DEVSTATE_TIMEOUT_MS);
+        double us = elapsed_us(t0);
+        ok = ok && resp.status == 200 && resp.body_len > 0;
+        if (ok) snprintf(etag, sizeof(etag), "%s", resp.etag);
+        if (i < RTT_WARMUP) continue;
+        if (ok) bench_add(&b, us); else b.failures++;
+    }
+    bench_report(&b);
+
+    bench_begin(&b, "state.not_modified");
+    for (int i = 0; i < RTT_WARMUP + STATE_ITERATIONS; ++i) {
+        Uint64 t0 = now_ticks();
+        bool ok = send_cmd_get(ip, DEVSTATE_PATH, etag, &resp, DEVSTATE_TIMEOUT_MS);
+        double us = elapsed_us(t0);
+        if (i < RTT_WARMUP) continue;
+        if (ok && resp.status == 304 && resp.body_len == 0) bench_add(&b, us); else b.failures++;
+    }
+    bench_report(&b);
+
+    // A change has to get through the stale ETag
+    mock_http_change_state();
+    bool changed = send_cmd_get(ip, DEVSTATE_PATH, etag, &resp, DEVSTATE_TIMEOUT_MS) &&
+                   resp.status == 200 && strcmp(resp.etag, etag) != 0;
+    if (!changed) fprintf(stderr, "bench: state change not reported\n");
+
+    // Detect start to the unit's state being known: one status query per unit
+    // with version 1 discovery replies, only the broadcast with version 2
+    if (mock_discovery_start(1, 1)) {
+        for (int v = 1; v <= 2; ++v) {
+            mock_discovery_set_version(v);
+            bench_begin(&b, v == 1 ? "state.startup_v1" : "state.startup_v2");
+            uint32_t queries = 0;
+            for (int run = 0; run < STATE_STARTUP_RUNS; ++run) {
+                uint32_t before = mock_http_requests();
+                Uint64 t0 = now_ticks();
+                detect_start();
+                devstate_start();
+                double us = wait_state(mock_unit_ip(0), t0, DETECT_GIVE_UP_MS);
+                devstate_stop();
+                detect_stop();
+                queries += mock_http_requests() - before;
+                if (us < 0) b.failures++; else bench_add(&b, us);
+            }
+            bench_report(&b);
+            printf("%-24s %.1f status queries per start\n", b.name, (double)queries / STATE_STARTUP_RUNS);
+        }
+        mock_discovery_stop();
+    } else {
+        fprintf(stderr, "bench: discovery mock failed\n");
+    }
+
+    send_cmd_pool_flush();
+    mock_http_stop();
+}
+
+// ---- Configuration profiles ---------------------------------------------
+
+// Waits for the profile sync to settle; microseconds since t0 or -1 if it
+// did not, or a unit of the profile was not set
+static double wait_profile(Uint64 t0, Uint32 give_up_ms) {
+    Uint32 stop = SDL_GetTicks() + give_up_ms;
+    devconfig_status_t st;
+    while (!SDL_TICKS_PASSED(SDL_GetTicks(), stop)) {
+        devconfig_status(&st);
+        if (!st.active && st.count > 0 && st.units[0].state != DEVCONFIG_IDLE &&
+            st.units[0].state != DEVCONFIG_WAITING)
+            return st.done == st.count ? elapsed_us(t0) : -1;
+        SDL_Event e;
+        SDL_WaitEventTimeout(&e, 1);
+    }
+    return -1;
+}
+
+// Waits for the mock unit to show the profile with no sync left running;
+// microseconds since t0 or -1. A sync planned from stale state finishes
+// without sending anything, so the unit's own state is what is checked.
+static double wait_rig(const devconfig_unit_t* want, Uint64 t0, Uint32 give_up_ms) {
+    Uint32 stop = SDL_GetTicks() + give_up_ms;
+    while (!SDL_TICKS_PASSED(SDL_GetTicks(), stop)) {
+        int img, disp, md;
+        mock_http_get_state(&img, &disp, &md);
+        devconfig_status_t st;
+        devconfig_status(&st);
+        if (!st.active && img == want->image && disp == want->display && md == want->mode)
+            return elapsed_us(t0);
+        SDL_Event e;
+        SDL_WaitEventTimeout(&e, 1);
+    }
+    return -1;
+}
+
+// A unit left in the wrong state converges from startup with the fewest
+// commands, and syncing it again once it matches sends none. Then the unit
+// drops off the network until it is pruned and comes back with its
+// defaults, as after a power cut, while device state keeps running: it has
+// to converge again from what it reports now, not what was cached.
+static void bench_config(void) {
+    if (!mock_http_start() || !mock_discovery_start(1, 1)) {
+        fprintf(stderr, "bench: mock failed\n");
+        mock_http_stop();
+        return;
+    }
+    devconfig_profile_t p = {1, {{1, mock_unit_ip(0), DEVSTATE_ON, 3, 9}}};
+    const int image = 3, mode = 1;
+    // Display On, two Display Mode presses and six Next Image
+    const int minimum = 1 + (p.units[0].mode - mode + MOCK_MODES) % MOCK_MODES + (p.units[0].image - image);
+    if (!devconfig_save(CONFIG_FILE, &p)) {
+        fprintf(stderr, "bench: cannot write %s\n", CONFIG_FILE);
+        mock_discovery_stop();
+        mock_http_stop();
+        return;
+    }
+
+    bench_t converge, again, reconnect;
+    bench_begin(&converge, "config.converge");
+    bench_begin(&again, "config.in_sync");
+    bench_begin(&reconnect, "config.reconnect");
+    uint32_t commands = 0, batches = 0, repeat_commands = 0, reconnect_commands = 0;
+    for (int run = 0; run < CONFIG_RUNS; ++run) {
+        mock_http_set_state(image, 0, mode);
+        uint32_t before = mock_http_commands();
+        Uint64 t0 = now_ticks();
+        detect_start();
+        devstate_start();
+        devconfig_start(CONFIG_FILE);
+        double us = wait_profile(t0, CONFIG_GIVE_UP_MS);
+        int img, disp, md;
+        mock_http_get_state(&img, &disp, &md);
+        if (us < 0 || img != p.units[0].image || disp != 1 || md != p.units[0].mode)
+            converge.failures++;
+        else
+            bench_add(&converge, us);
+        devconfig_status_t st;
+        devconfig_status(&st);
+        commands += mock_http_commands() - before;
+        batches += st.batches;
+
+        before = mock_http_commands();
+        t0 = now_ticks();
+        devconfig_restore();
+        us = wait_profile(t0, CONFIG_GIVE_UP_MS);
+        if (us < 0) again.failures++; else bench_add(&again, us);
+        repeat_commands += mock_http_commands() - before;
+
+        mock_discovery_set_count(0);
+        Uint32 stop = SDL_GetTicks() + CONFIG_PRUNE_GIVE_UP_MS;
+        while (published_units() > 0 && !SDL_TICKS_PASSED(SDL_GetTicks(), stop)) {
+            SDL_Event e;
+            SDL_WaitEventTimeout(&e, 10);
+        }
+        bool pruned = published_units() == 0;
+        mock_http_set_state(image, 0, mode);
+        before = mock_http_commands();
+        t0 = now_ticks();
+        mock_discovery_set_count(1);
+        us = pruned ? wait_rig(&p.units[0], t0, CONFIG_GIVE_UP_MS) : -1;
+        if (us < 0) reconnect.failures++; else bench_add(&reconnect, us);
+        reconnect_commands += mock_http_commands() - before;
+
+        devconfig_stop();
+        devstate_stop();
+        detect_stop();
+    }
+    bench_report(&converge);
+    printf("%-24s %.1f commands (minimum %d) in %.1f batches\n", converge.name,
+           (double)commands / CONFIG_RUNS, minimum, (double)batches / CONFIG_RUNS);
+    bench_report(&again);
+    printf("%-24s %.1f commands\n", again.name, (double)repeat_commands / CONFIG_RUNS);
+    bench_report(&reconnect);
+    printf("%-24s %.1f commands (minimum %d)\n", reconnect.name,
+           (double)reconnect_commands / CONFIG_RUNS, minimum);
+
+    remove(CONFIG_FILE);
+    send_cmd_pool_flush();
+    mock_discovery_stop();
+    mock_http_stop();
+}
+
+// ---- Compositor ---------------------------------------------------------
+
+static void compose_pattern(SDL_Surface* s) {
+    for (int y = 0; y < s->h; ++y) {
+        uint32_t* row = (uint32_t*)((uint8_t*)s->pixels + y * s->pitch);
+        for (int x = 0; x < s->w; ++x)
+            row[x] = ((uint32_t)(x * 7 + y * 13) * 2654435761u);
+    }
+}
+
+// Screen-sized work for every kernel set the CPU has: the overlay panel's
+// fill, a full-screen premultiplied blit and a blended 2x upscale. SDL's
+// blended fill is timed alongside, as the panel was drawn before.
+static void bench_compose(void) {
+    SDL_Surface* screen = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_RGB888);
+    SDL_Surface* layer = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Surface* half = SDL_CreateRGBSurfaceWithFormat(0, screen_width / 2, screen_height / 2, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* r = screen ? SDL_CreateSoftwareRenderer(screen) : NULL;
+    if (!screen || !layer || !half || !r) {
+        fprintf(stderr, "bench: compositor surfaces failed: %s\n", SDL_GetError());
+        goto done;
+    }
+    compose_pattern(screen);
+    compose_pattern(layer);
+    compose_pattern(half);
+    comp_premultiply(layer);
+    comp_premultiply(half);
+
+    SDL_Color dim = {0, 0, 0, 180};
+    SDL_Rect panel = {screen_width / 16, screen_height / 6, screen_width * 7 / 8, screen_height * 2 / 3};
+    comp_backend_t chosen = comp_backend();
+    bench_t b;
+    char name[40];
+    for (int k = 0; k < COMP_BACKEND_COUNT; ++k) {
+        const char* kname = comp_backend_name((comp_backend_t)k);
+        if (!comp_set_backend((comp_backend_t)k)) {
+            printf("# compose: no %s kernels here\n", kname);
+            continue;
+        }
+        printf("# compose: %s self-check %s\n", kname, comp_self_check() ? "passed" : "FAILED");
+
+        snprintf(name, sizeof(name), "compose.fill.%s", kname);
+        bench_begin(&b, name);
+        for (int i = 0; i < COMPOSE_WARMUP + COMPOSE_ITERATIONS; ++i) {
+            Uint64 t0 = now_ticks();
+            if (!comp_fill(screen, &panel, dim)) b.failures++;
+            if (i >= COMPOSE_WARMUP) bench_add(&b, elapsed_us(t0));
+        }
+        bench_report(&b);
+
+        snprintf(name, sizeof(name), "compose.blit.%s", kname);
+        bench_begin(&b, name);
+        for (int i = 0; i < COMPOSE_WARMUP + COMPOSE_ITERATIONS; ++i) {
+            Uint64 t0 = now_ticks();
+            if (!comp_blit(layer, screen, 0, 0)) b.failures++;
+            if (i >= COMPOSE_WARMUP) bench_add(&b, elapsed_us(t0));
+        }
+        bench_report(&b);
+
+        snprintf(name, sizeof(name), "compose.scaled.%s", kname);
+        bench_begin(&b, name);
+        for (int i = 0; i < COMPOSE_WARMUP + COMPOSE_ITERATIONS; ++i) {
+            Uint64 t0 = now_ticks();
+            if (!comp_blit_scaled(half, screen, NULL, true)) b.failures++;
+            if (i >= COMPOSE_WARMUP) bench_add(&b, elapsed_us(t0));
+        }
+        bench_report(&b);
+    }
+    comp_set_backend(chosen);
+
+    bench_begin(&b, "compose.fill.sdl");
+    SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(r, dim.r, dim.g, dim.b, dim.a);
+    for (int i = 0; i < COMPOSE_WARMUP + COMPOSE_ITERATIONS; ++i) {
+        Uint64 t0 = now_ticks();
+        SDL_RenderFillRect(r, &panel);
+        SDL_RenderPresent(r);
+        if (i >= COMPOSE_WARMUP) bench_add(&b, elapsed_us(t0));
+    }
+    bench_report(&b);
+
+done:
+    if (r) SDL_DestroyRenderer(r);
+    if (half) SDL_FreeSurface(half);
+    if (layer) SDL_FreeSurface(layer);
+    if (screen) SDL_FreeSurface(screen);
+}
+
+// ---- Music --------------------------------------------------------------
+
+// Two tones with a slow sweep, different per channel, at 44.1 kHz stereo
+static int16_t* audio_synth(uint32_t frames) {
+    int16_t* pcm = (int16_t*)malloc((size_t)frames * WAV_OUT_FRAME_BYTES);
+    for (uint32_t i = 0; pcm && i < frames; ++i) {
+        double t = (double)i / WAV_OUT_RATE;
+        pcm[2 * i] = (int16_t)(12000 * SDL_sin(2 * M_PI * (440 + 110 * t) * t));
+        pcm[2 * i + 1] = (int16_t)(9000 * SDL_sin(2 * M_PI * 660 * t) + 3000 * SDL_sin(2 * M_PI * 5000 * t));
+    }
+    return pcm;
+}
+
+// Decoded against the original, in dB
+static double audio_snr(const char* path, const int16_t* ref, uint32_t frames) {
+    static wav_decoder_t dec;
+    static int16_t out[AUDIO_STEP_FRAMES * 2];
+    wav_info_t info;
+    FILE* f = fopen(path, "rb");
+    if (!f || !wav_parse(f, &info)) {
+        if (f) fclose(f);
+        return 0;
+    }
+    wav_decoder_init(&dec, f, &info);
+    double signal = 0, noise = 0;
+    uint32_t at = 0;
+    int got;
+    while (at < frames && (got = wav_decode(&dec, out, AUDIO_STEP_FRAMES, false)) > 0) {
+        for (int i = 0; i < got * 2 && at * 2 + i < frames * 2; ++i) {
+            double s = ref[at * 2 + i], e = out[i] - s;
+            signal += s * s;
+            noise += e * e;
+        }
+        at += (uint32_t)got;
+    }
+    fclose(f);
+    return noise > 0 ? 10 * SDL_log(signal / noise) / SDL_log(10) : 99;
+}
+
+// The console's playback path: reader thread, ring and callback, fed from
+// path on whatever audio device SDL opens (SDL_AUDIODRIVER=dummy without
+// one). Prints the ring's counters as the diagnostics page shows them.
+static void audio_stream_run(const char* path) {
+    if (!audio_stream_start(path, 1.0f)) {
+        printf("%-24s no audio device: %s\n", "audio.stream", SDL_GetError());
+        return;
+    }
+    SDL_Delay(AUDIO_STREAM_MS);
+    audio_stats_t s;
+    audio_stream_stats(&s);
+    audio_stream_stop();
+    printf("%-24s %u ms: underruns %u (%u bytes silent), ring low %u of %u bytes, %u file bytes\n",
+           "audio.stream", AUDIO_STREAM_MS, (unsigned)s.underruns, (unsigned)s.underrun_bytes,
+           (unsigned)s.min_fill_bytes, (unsigned)s.capacity_bytes, (unsigned)s.file_bytes);
+}
+
+// One console refill step per iteration, looping, from each format the
+// music can come in. file_bytes/out_byte is the disk traffic per byte played.
+static void bench_audio(void) {
+    uint32_t frames = AUDIO_SECONDS * WAV_OUT_RATE;
+    int16_t* pcm = audio_synth(frames);
+    int16_t* mono22 = (int16_t*)malloc((size_t)frames / 2 * sizeof(int16_t));
+    if (!pcm || !mono22) {
+        free(pcm);
+        free(mono22);
+        return;
+    }
+    for (uint32_t i = 0; i < frames / 2; ++i)
+        mono22[i] = pcm[4 * i];
+
+    static const struct { const char* name; const char* path; } cases[] = {
+        {"audio.pcm16_44k", "bench_pcm.wav"},
+        {"audio.ima_44k", "bench_ima.wav"},
+        {"audio.ima_mono_22k", "bench_ima22.wav"},
+    };
+    bool ok = wav_write_pcm(cases[0].path, pcm, frames, 2, WAV_OUT_RATE) &&
+              wav_write_ima(cases[1].path, pcm, frames, 2, WAV_OUT_RATE) &&
+              wav_write_ima(cases[2].path, mono22, frames / 2, 1, WAV_OUT_RATE / 2);
+    if (!ok) fprintf(stderr, "bench: cannot write the audio files\n");
+
+    static wav_decoder_t dec;
+    static int16_t out[AUDIO_STEP_FRAMES * 2];
+    for (size_t c = 0; ok && c < SDL_arraysize(cases); ++c) {
+        wav_info_t info;
+        FILE* f = fopen(cases[c].path, "rb");
+        if (!f || !wav_parse(f, &info)) {
+            if (f) fclose(f);
+            continue;
+        }
+        wav_decoder_init(&dec, f, &info);
+        bench_t b;
+        bench_begin(&b, cases[c].name);
+        for (int i = 0; i < AUDIO_ITERATIONS; ++i) {
+            Uint64 t0 = now_ticks();
+            if (wav_decode(&dec, out, AUDIO_STEP_FRAMES, true) != AUDIO_STEP_FRAMES) b.failures++;
+            bench_add(&b, elapsed_us(t0));
+        }
+        bench_report(&b);
+        printf("%-24s %.3f file bytes per output byte\n", b.name,
+               (double)dec.bytes_read / ((double)AUDIO_ITERATIONS * AUDIO_STEP_FRAMES * WAV_OUT_FRAME_BYTES));
+        fclose(f);
+    }
+    if (ok) {
+        printf("# audio: IMA ADPCM round trip %.1f dB SNR\n", audio_snr(cases[1].path, pcm, frames));
+        audio_stream_run(cases[1].path);
+    }
+    for (size_t c = 0; c < SDL_arraysize(cases); ++c)
+        remove(cases[c].path);
+    free(pcm);
+    free(mono22);
+}
+
+// ---- Uploads ------------------------------------------------------------
+
+// One upload to units copies of the mock unit; microseconds or -1
+static double upload_once(int units) {
+    uint32_t ips[UPLOAD_UNITS_MAX];
+    for (int i = 0; i < units; ++i) ips[i] = 0x7F000002;   // MOCK_UNIT_BASE_IP
+    const char* paths[] = {UPLOAD_FILE};
+    uint32_t body_before = mock_http_body_bytes();
+
+    Uint64 t0 = now_ticks();
+    if (!upload_start(ips, units, paths, 1)) return -1;
+    upload_status_t st;
+    Uint32 stop = SDL_GetTicks() + UPLOAD_GIVE_UP_MS;
+    do {
+        SDL_Event e;
+        SDL_WaitEventTimeout(&e, 1);
+        upload_status(&st);
+    } while (st.active && !SDL_TICKS_PASSED(SDL_GetTicks(), stop));
+    double us = elapsed_us(t0);
+    if (st.active) {
+        upload_cancel(true);
+        return -1;
+    }
+    for (int i = 0; i < units; ++i) {
+        if (st.units[i].state != UPLOAD_DONE) return -1;
+    }
+    // Acknowledged is not enough: every byte has to have reached the unit
+    if (mock_http_body_bytes() - body_before != (uint32_t)UPLOAD_BYTES * units) return -1;
+    return us;
+}
+
+static void bench_upload(void) {
+    FILE* f = fopen(UPLOAD_FILE, "wb");
+    for (int i = 0; f && i < UPLOAD_BYTES; ++i) fputc((i * 131) & 0xFF, f);
+    if (!f || fclose(f) != 0) {
+        fprintf(stderr, "bench: cannot write %s\n", UPLOAD_FILE);
+        return;
+    }
+    if (!mock_http_start()) {
+        fprintf(stderr, "bench: HTTP mock failed\n");
+        remove(UPLOAD_FILE);
+        return;
+    }
+    static const struct { const char* name; int units; } cases[] = {
+        {"upload.one_unit", 1},
+        {"upload.parallel4", UPLOAD_PARALLEL},
+        {"upload.rig6", 6},            // Two units wait for a free thread
+    };
+    for (size_t c = 0; c < SDL_arraysize(cases); ++c) {
+        bench_t b;
+        bench_begin(&b, cases[c].name);
+        for (int run = 0; run < UPLOAD_RUNS; ++run) {
+            double us = upload_once(cases[c].units);
+            if (us < 0) b.failures++; else bench_add(&b, us);
+        }
+        bench_report(&b);
+        if (b.count) {
+            double mb = (double)UPLOAD_BYTES * cases[c].units / (1024.0 * 1024.0);
+            printf("%-24s %.1f MB/s at the median\n", cases[c].name, mb / (percentile(&b, 50) / 1e6));
+        }
+    }
+    send_cmd_pool_flush();
+    mock_http_stop();
+    remove(UPLOAD_FILE);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [--media DIR] [startup] [render] [detect] [rtt] [input] [state] [config] [upload] [compose] [audio]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* media = "../../media";
+    bool want_startup = false, want_render = false, want_detect = false, want_rtt = false;
+    bool want_input = false, want_state = false, want_upload = false, want_compose = false;
+    bool want_audio = false, want_config = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--media") == 0 && i + 1 < argc) media = argv[++i];
+        else if (strcmp(argv[i], "startup") == 0) want_startup = true;
+        else if (strcmp(argv[i], "render") == 0) want_render = true;
+        else if (strcmp(argv[i], "detect") == 0) want_detect = true;
+        else if (strcmp(argv[i], "rtt") == 0) want_rtt = true;
+        else if (strcmp(argv[i], "input") == 0) want_input = true;
+        else if (strcmp(argv[i], "state") == 0) want_state = true;
+        else if (strcmp(argv[i], "config") == 0) want_config = true;
+        else if (strcmp(argv[i], "upload") == 0) want_upload = true;
+        else if (strcmp(argv[i], "compose") == 0) want_compose = true;
+        else if (strcmp(argv[i], "audio") == 0) want_audio = true;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!want_startup && !want_render && !want_detect && !want_rtt && !want_input && !want_state &&
+        !want_config && !want_upload && !want_compose && !want_audio)
+        want_startup = want_render = want_detect = want_rtt = want_input = want_state = want_config =
+            want_upload = want_compose = want_audio = true;
+
+    if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0 || TTF_Init() == -1) {
+        fprintf(stderr, "bench: SDL init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+    perf_freq = SDL_GetPerformanceFrequency();
+    comp_init();
+
+    printf("# Type D Setup host bench, %dx%d, times in microseconds\n", screen_width, screen_height);
+    if (want_startup) bench_startup(media);
+    if (want_render) bench_render(media);
+    if (want_detect) bench_detect();
+    if (want_rtt) bench_rtt();
+    if (want_input) bench_input();
+    if (want_state) bench_state();
+    if (want_config) bench_config();
+    if (want_upload) bench_upload();
+    if (want_compose) bench_compose();
+    if (want_audio) bench_audio();
+
+    IMG_Quit();
+    TTF_Quit();
+    SDL_Quit();
+    return 0;
+}
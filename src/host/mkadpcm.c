@@ -0,0 +1,58 @@
+// Converts background music for the console: any WAV it can play in, 44.1 kHz
+// stereo IMA ADPCM out, a quarter of the size of 16-bit PCM. Decodes through
+// the console's own decoder, so other rates are resampled the same way.
+//
+//   mkadpcm IN.wav OUT.wav
+#include <stdio.h>
+#include <stdlib.h>
+#include "wav.h"
+#include "wav_encode.h"
+
+#define GROW_FRAMES (1 << 16)
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s IN.wav OUT.wav\n", argv[0]);
+        return 2;
+    }
+    FILE* f = fopen(argv[1], "rb");
+    wav_info_t info;
+    if (!f || !wav_parse(f, &info)) {
+        fprintf(stderr, "mkadpcm: cannot read %s\n", argv[1]);
+        if (f) fclose(f);
+        return 1;
+    }
+
+    static wav_decoder_t dec;
+    wav_decoder_init(&dec, f, &info);
+    int16_t* pcm = NULL;
+    uint32_t frames = 0, cap = 0;
+    for (;;) {
+        if (frames == cap) {
+            cap += GROW_FRAMES;
+            int16_t* grown = (int16_t*)realloc(pcm, (size_t)cap * WAV_OUT_FRAME_BYTES);
+            if (!grown) {
+                fprintf(stderr, "mkadpcm: out of memory\n");
+                return 1;
+            }
+            pcm = grown;
+        }
+        int want = (int)(cap - frames);
+        int got = wav_decode(&dec, pcm + 2 * frames, want, false);
+        frames += (uint32_t)got;
+        if (got < want) break;
+    }
+    fclose(f);
+
+    if (!wav_write_ima(argv[2], pcm, frames, 2, WAV_OUT_RATE)) {
+        fprintf(stderr, "mkadpcm: cannot write %s\n", argv[2]);
+        free(pcm);
+        return 1;
+    }
+    int block_frames = wav_ima_block_frames(2 * WAV_ENCODE_BLOCK_BYTES, 2);
+    uint32_t out_bytes = (frames + block_frames - 1) / block_frames * 2 * WAV_ENCODE_BLOCK_BYTES;
+    printf("%s: %u frames, %u data bytes in, %u out\n", argv[2], (unsigned)frames,
+           (unsigned)info.data_bytes, (unsigned)out_bytes);
+    free(pcm);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Bakes media/typed.pak: the startup images decoded and scaled, and the
+// static strings rasterized, for every screen mode main() can pick. Uses the
+// same code as the console's loose-file fallback, so the pixels match.
+//
+//   mkpack MEDIA_DIR OUT.pak
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include "asset_pack.h"
+#include "assets.h"
+
+// Keep in step with the modes tried in main()
+static const struct { int w, h; } modes[] = {
+    {640, 480},
+    {720, 480},
+};
+
+#define MODE_COUNT  (int)(sizeof(modes) / sizeof(modes[0]))
+#define ENTRY_MAX   (MODE_COUNT * ASSET_COUNT)
+
+static uint32_t align_up(uint32_t v) {
+    return (v + ASSET_PACK_ALIGN - 1) & ~(uint32_t)(ASSET_PACK_ALIGN - 1);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s MEDIA_DIR OUT.pak\n", argv[0]);
+        return 2;
+    }
+    const char* dir = argv[1];
+    if (SDL_Init(0) != 0 || TTF_Init() == -1) {
+        fprintf(stderr, "mkpack: SDL init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+
+    char font_path[512];
+    snprintf(font_path, sizeof(font_path), "%s" ASSETS_SEP ASSETS_FONT_PATH, dir);
+
+    static asset_pack_entry_t index[ENTRY_MAX];
+    static SDL_Surface* pixels[ENTRY_MAX];
+    int count = 0;
+    uint32_t offset = align_up(sizeof(asset_pack_header_t) + sizeof(index[0]) * ENTRY_MAX);
+    bool ok = true;
+
+    for (int m = 0; m < MODE_COUNT && ok; ++m) {
+        TTF_Font* title_font = TTF_OpenFont(font_path, modes[m].h / 18);
+        TTF_Font* exit_font = TTF_OpenFont(font_path, modes[m].h / 32);
+        if (!title_font || !exit_font) {
+            fprintf(stderr, "mkpack: cannot open %s\n", font_path);
+            ok = false;
+        }
+        SDL_Surface* out[ASSET_COUNT] = {0};
+        if (ok) assets_render_loose(dir, modes[m].w, modes[m].h, title_font, exit_font, out);
+        for (int i = 0; i < ASSET_COUNT && ok; ++i) {
+            if (!out[i]) {
+                fprintf(stderr, "mkpack: %s failed for %dx%d\n", asset_names[i], modes[m].w, modes[m].h);
+                ok = false;
+                break;
+            }
+            asset_pack_entry_t* e = &index[count];
+            snprintf(e->name, sizeof(e->name), "%s", asset_names[i]);
+            e->screen_w = (uint16_t)modes[m].w;
+            e->screen_h = (uint16_t)modes[m].h;
+            e->w = (uint16_t)out[i]->w;
+            e->h = (uint16_t)out[i]->h;
+            e->pitch = (uint32_t)out[i]->w * 4;
+            e->format = ASSET_PACK_FORMAT;
+            e->offset = offset;
+            e->size = e->pitch * e->h;
+            offset = align_up(offset + e->size);
+            pixels[count++] = out[i];
+            out[i] = NULL;
+        }
+        for (int i = 0; i < ASSET_COUNT; ++i) {
+            if (out[i]) SDL_FreeSurface(out[i]);
+        }
+        if (title_font) TTF_CloseFont(title_font);
+        if (exit_font) TTF_CloseFont(exit_font);
+    }
+
+    FILE* f = ok ? fopen(argv[2], "wb") : NULL;
+    if (ok && !f) {
+        fprintf(stderr, "mkpack: cannot write %s\n", argv[2]);
+        ok = false;
+    }
+    if (f) {
+        asset_pack_header_t hdr = {{'T','D','P','K'}, ASSET_PACK_VERSION, (uint32_t)count, offset};
+        static const uint8_t zero[ASSET_PACK_ALIGN] = {0};
+        fwrite(&hdr, sizeof(hdr), 1, f);
+        fwrite(index, sizeof(index[0]), ENTRY_MAX, f);
+        long pos = (long)(sizeof(hdr) + sizeof(index[0]) * ENTRY_MAX);
+        for (int i = 0; i < count; ++i) {
+            fwrite(zero, 1, index[i].offset - pos, f);
+            SDL_Surface* s = pixels[i];
+            SDL_LockSurface(s);
+            for (int y = 0; y < s->h; ++y)
+                fwrite((const uint8_t*)s->pixels + y * s->pitch, 1, index[i].pitch, f);
+            SDL_UnlockSurface(s);
+            pos = index[i].offset + index[i].size;
+        }
+        fwrite(zero, 1, offset - pos, f);
+        ok = (fclose(f) == 0);
+        if (ok) printf("%s: %d entries, %u bytes\n", argv[2], count, (unsigned)offset);
+    }
+
+    for (int i = 0; i < count; ++i) SDL_FreeSurface(pixels[i]);
+    IMG_Quit();
+    TTF_Quit();
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
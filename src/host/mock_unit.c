@@ -0,0 +1,419 @@
+#include "mock_unit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <lwip/sockets.h>
+#include <hal/debug.h>
+#include <SDL.h>
+
+#define MOCK_DISCOVER_PORT  50501
+#define MOCK_ANNOUNCE_PORT  50502
+#define MOCK_HTTP_PORT      8080
+#define MOCK_POLL_MS        50        // select() timeout so stop requests are noticed
+#define MOCK_HTTP_BUF       2048
+
+static const char http_ok[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 2\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "OK";
+
+static SDL_Thread* disc_thread = NULL;
+static int disc_reply[MOCK_UNIT_MAX]; // Bound to each unit's address on the discovery port
+static SDL_atomic_t disc_count;
+static SDL_atomic_t disc_version;     // Reply format; set by mock_discovery_start()
+static SDL_atomic_t disc_broadcast;   // Unit 0 answers for everyone, standing in for a broadcast
+static uint8_t disc_first_id = 1;
+static int disc_running = 0;
+static bool disc_open = false;        // disc_reply[] initialised
+
+typedef struct {
+    int  sock;
+    char buf[MOCK_HTTP_BUF];
+    int  len;
+    long body_left;                   // Request body still to arrive before the reply
+} mock_client_t;
+
+static SDL_Thread* http_thread = NULL;
+static int http_listen = -1;
+static mock_client_t clients[MOCK_HTTP_CLIENTS];
+static SDL_atomic_t http_requests;
+static SDL_atomic_t http_body_bytes;
+static int http_running = 0;
+
+// What GET /status and version 2 replies report; commands change it like a
+// unit would. Every change bumps the version, the ETag of the status page.
+typedef struct {
+    int version;
+    int image;
+    int display;
+    int mode;
+} mock_state_t;
+
+static mock_state_t state = {0, 0, 1, 0};
+static SDL_SpinLock state_lock = 0;
+static SDL_atomic_t http_commands;
+
+static mock_state_t state_get(void) {
+    SDL_AtomicLock(&state_lock);
+    mock_state_t st = state;
+    SDL_AtomicUnlock(&state_lock);
+    return st;
+}
+
+// The effect of GET /cmd?c=<code> on the state
+static void state_command(const char* head) {
+    const char* code = head + 11;     // After "GET /cmd?c="
+    SDL_AtomicLock(&state_lock);
+    mock_state_t before = state;
+    if (strncmp(code, "0001", 4) == 0) state.image++;
+    else if (strncmp(code, "0002", 4) == 0 && state.image > 0) state.image--;
+    else if (strncmp(code, "0004", 4) == 0) state.mode = (state.mode + 1) % MOCK_MODES;
+    else if (strncmp(code, "0060", 4) == 0) state.display = 1;
+    else if (strncmp(code, "0061", 4) == 0) state.display = 0;
+    if (memcmp(&before, &state, sizeof(state)) != 0) state.version++;
+    SDL_AtomicUnlock(&state_lock);
+    SDL_AtomicAdd(&http_commands, 1);
+}
+
+uint32_t mock_unit_ip(int idx) {
+    return ntohl(inet_addr(MOCK_UNIT_BASE_IP)) + (uint32_t)idx;
+}
+
+static int bound_udp(uint32_t ip, int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) return -1;
+    int yes = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(ip);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        debugPrint("[mock] bind %s:%d failed\n", inet_ntoa(addr.sin_addr), port);
+        closesocket(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// IDs cycle through the six real ones, so large setups repeat IDs like real installs.
+// Version 2 replies carry the same state as GET /status.
+static void reply_from(int idx, const struct sockaddr_in* to) {
+    char msg[128];
+    unsigned id = (unsigned)((disc_first_id - 1 + idx) % 6 + 1);
+    int len = snprintf(msg, sizeof(msg), "TYPE_D_ID:%u", id);
+    if (SDL_AtomicGet(&disc_version) >= 2) {
+        mock_state_t st = state_get();
+        unsigned caps = id == 5 ? 1 : id == 6 ? 2 : 0;
+        len += snprintf(msg + len, sizeof(msg) - len, ";v=2&fw=1.5.%d&display=%d&img=%d&mode=%d&cap=%u",
+                        idx % 10, st.display, st.image, st.mode, caps);
+    }
+    sendto(disc_reply[idx], msg, len, 0, (const struct sockaddr*)to, sizeof(*to));
+}
+
+static int disc_func(void* data) {
+    while (disc_running) {
+        struct timeval tv = {0, MOCK_POLL_MS * 1000};
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        int maxfd = -1;
+        for (int i = 0; i < MOCK_UNIT_MAX; ++i) {
+            FD_SET(disc_reply[i], &rfds);
+            if (disc_reply[i] > maxfd) maxfd = disc_reply[i];
+        }
+        if (select(maxfd + 1, &rfds, NULL, NULL, &tv) <= 0) continue;
+
+        int count = SDL_AtomicGet(&disc_count);
+        for (int idx = 0; idx < MOCK_UNIT_MAX; ++idx) {
+            if (!FD_ISSET(disc_reply[idx], &rfds)) continue;
+            struct sockaddr_in from;
+            socklen_t fromlen = sizeof(from);
+            char buf[64];
+            int len = recvfrom(disc_reply[idx], buf, sizeof(buf) - 1, 0, (struct sockaddr*)&from, &fromlen);
+            if (len <= 0) continue;
+            buf[len] = 0;
+            if (strcmp(buf, "TYPE_D_DISCOVER?") != 0) continue;
+
+            if (idx == 0 && SDL_AtomicGet(&disc_broadcast)) {
+                for (int i = 0; i < count; ++i)
+                    reply_from(i, &from);
+            } else if (idx < count) {
+                reply_from(idx, &from);
+            }
+        }
+    }
+    return 0;
+}
+
+bool mock_discovery_start(int count, uint8_t first_id) {
+    if (disc_running) return true;
+    for (int i = 0; i < MOCK_UNIT_MAX; ++i) disc_reply[i] = -1;
+    disc_open = true;
+
+    bool ok = true;
+    for (int i = 0; ok && i < MOCK_UNIT_MAX; ++i) {
+        disc_reply[i] = bound_udp(mock_unit_ip(i), MOCK_DISCOVER_PORT);
+        ok = disc_reply[i] >= 0;
+    }
+    disc_first_id = first_id;
+    mock_discovery_set_count(count);
+    mock_discovery_set_version(2);
+    mock_discovery_set_broadcast(true);
+    disc_running = 1;
+    disc_thread = ok ? SDL_CreateThread(disc_func, "mock_discovery", NULL) : NULL;
+    if (!disc_thread) {
+        mock_discovery_stop();
+        return false;
+    }
+    return true;
+}
+
+void mock_discovery_set_count(int count) {
+    if (count < 0) count = 0;
+    if (count > MOCK_UNIT_MAX) count = MOCK_UNIT_MAX;
+    SDL_AtomicSet(&disc_count, count);
+}
+
+void mock_discovery_set_broadcast(bool on) {
+    SDL_AtomicSet(&disc_broadcast, on ? 1 : 0);
+}
+
+void mock_discovery_set_version(int version) {
+    SDL_AtomicSet(&disc_version, version);
+}
+
+bool mock_discovery_announce(int idx) {
+    if (idx < 0 || idx >= MOCK_UNIT_MAX || disc_reply[idx] < 0) return false;
+    struct sockaddr_in to = {0};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(MOCK_ANNOUNCE_PORT);
+    to.sin_addr.s_addr = inet_addr("127.0.0.1");
+    reply_from(idx, &to);
+    return true;
+}
+
+void mock_discovery_stop(void) {
+    disc_running = 0;
+    if (disc_thread) {
+        SDL_WaitThread(disc_thread, NULL);
+        disc_thread = NULL;
+    }
+    if (!disc_open) return;   // Never started; disc_reply[] is not initialised
+    disc_open = false;
+    for (int i = 0; i < MOCK_UNIT_MAX; ++i) {
+        if (disc_reply[i] >= 0) closesocket(disc_reply[i]);
+        disc_reply[i] = -1;
+    }
+}
+
+static void client_close(mock_client_t* c) {
+    closesocket(c->sock);
+    c->sock = -1;
+    c->len = 0;
+    c->body_left = 0;
+}
+
+static bool client_reply(mock_client_t* c) {
+    if (send(c->sock, http_ok, sizeof(http_ok) - 1, 0) != (int)sizeof(http_ok) - 1) {
+        client_close(c);
+        return false;
+    }
+    SDL_AtomicAdd(&http_requests, 1);
+    return true;
+}
+
+// Value of a header in a request head (name given as "\r\nname:"), or NULL
+static const char* head_header(const char* head, int len, const char* name) {
+    size_t nlen = strlen(name);
+    for (int i = 0; i + (int)nlen < len; ++i) {
+        if (strncasecmp(head + i, name, nlen) != 0) continue;
+        const char* v = head + i + nlen;
+        while (*v == ' ') v++;
+        return v;
+    }
+    return NULL;
+}
+
+// GET /status: 304 while If-None-Match names the current state, else the state
+static bool client_status(mock_client_t* c, const char* head, int len) {
+    mock_state_t st = state_get();
+    char etag[16], body[64], out[256];
+    snprintf(etag, sizeof(etag), "\"v%d\"", st.version);
+    const char* inm = head_header(head, len, "\r\nif-none-match:");
+    int n;
+    if (inm && strncmp(inm, etag, strlen(etag)) == 0) {
+        n = snprintf(out, sizeof(out),
+            "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: keep-alive\r\n\r\n", etag);
+    } else {
+        int blen = snprintf(body, sizeof(body), "img=%d&display=%d&mode=%d", st.image, st.display, st.mode);
+        n = snprintf(out, sizeof(out),
+            "HTTP/1.1 200 OK\r\nETag: %s\r\nContent-Length: %d\r\nConnection: keep-alive\r\n\r\n%s",
+            etag, blen, body);
+    }
+    if (send(c->sock, out, n, 0) != n) {
+        client_close(c);
+        return false;
+    }
+    SDL_AtomicAdd(&http_requests, 1);
+    return true;
+}
+
+// Answers every complete request in the buffer, keeps the remainder. A
+// request with a body is answered once the whole body has arrived.
+static void client_serve(mock_client_t* c) {
+    int n = recv(c->sock, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+    if (n <= 0) {
+        client_close(c);
+        return;
+    }
+    c->len += n;
+
+    int start = 0;
+    while (start < c->len || c->body_left == 0) {
+        if (c->body_left > 0) {
+            long take = SDL_min(c->body_left, (long)(c->len - start));
+            start += (int)take;
+            c->body_left -= take;
+            SDL_AtomicAdd(&http_body_bytes, (int)take);
+            if (c->body_left > 0) break;
+            if (!client_reply(c)) return;
+            continue;
+        }
+        int end = -1;
+        for (int i = start + 3; i < c->len && end < 0; ++i) {
+            if (memcmp(c->buf + i - 3, "\r\n\r\n", 4) == 0) end = i + 1;
+        }
+        if (end < 0) break;
+        const char* head = c->buf + start;
+        int head_len = end - start;
+        const char* cl = head_header(head, head_len, "\r\ncontent-length:");
+        c->body_left = cl ? strtol(cl, NULL, 10) : 0;
+        start = end;
+        if (c->body_left > 0) continue;
+        if (strncmp(head, "GET /cmd?c=", 11) == 0) state_command(head);
+        bool ok = (strncmp(head, "GET /status ", 12) == 0) ? client_status(c, head, head_len) : client_reply(c);
+        if (!ok) return;
+    }
+    memmove(c->buf, c->buf + start, c->len - start);
+    c->len -= start;
+    if (c->len == (int)sizeof(c->buf)) client_close(c);   // Oversized request head
+}
+
+static int http_func(void* data) {
+    while (http_running) {
+        struct timeval tv = {0, MOCK_POLL_MS * 1000};
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(http_listen, &rfds);
+        int maxfd = http_listen;
+        for (int i = 0; i < MOCK_HTTP_CLIENTS; ++i) {
+            if (clients[i].sock < 0) continue;
+            FD_SET(clients[i].sock, &rfds);
+            if (clients[i].sock > maxfd) maxfd = clients[i].sock;
+        }
+        if (select(maxfd + 1, &rfds, NULL, NULL, &tv) <= 0) continue;
+
+        if (FD_ISSET(http_listen, &rfds)) {
+            int sock = accept(http_listen, NULL, NULL);
+            int slot = -1;
+            for (int i = 0; sock >= 0 && i < MOCK_HTTP_CLIENTS && slot < 0; ++i) {
+                if (clients[i].sock < 0) slot = i;
+            }
+            if (slot >= 0) {
+                int nodelay = 1;
+                setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                clients[slot].sock = sock;
+                clients[slot].len = 0;
+                clients[slot].body_left = 0;
+            } else if (sock >= 0) {
+                closesocket(sock);
+            }
+        }
+        for (int i = 0; i < MOCK_HTTP_CLIENTS; ++i) {
+            if (clients[i].sock >= 0 && FD_ISSET(clients[i].sock, &rfds))
+                client_serve(&clients[i]);
+        }
+    }
+    return 0;
+}
+
+bool mock_http_start(void) {
+    if (http_running) return true;
+    for (int i = 0; i < MOCK_HTTP_CLIENTS; ++i) clients[i].sock = -1;
+    SDL_AtomicSet(&http_requests, 0);
+    SDL_AtomicSet(&http_body_bytes, 0);
+
+    http_listen = socket(AF_INET, SOCK_STREAM, 0);
+    if (http_listen < 0) return false;
+    int yes = 1;
+    setsockopt(http_listen, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(MOCK_HTTP_PORT);
+    addr.sin_addr.s_addr = htonl(mock_unit_ip(0));
+    if (bind(http_listen, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(http_listen, 8) != 0) {
+        debugPrint("[mock] HTTP listen on %s:%d failed\n", MOCK_UNIT_BASE_IP, MOCK_HTTP_PORT);
+        mock_http_stop();
+        return false;
+    }
+    http_running = 1;
+    http_thread = SDL_CreateThread(http_func, "mock_http", NULL);
+    if (!http_thread) {
+        mock_http_stop();
+        return false;
+    }
+    return true;
+}
+
+void mock_http_stop(void) {
+    http_running = 0;
+    if (http_thread) {
+        SDL_WaitThread(http_thread, NULL);
+        http_thread = NULL;
+    }
+    if (http_listen < 0) return;
+    for (int i = 0; i < MOCK_HTTP_CLIENTS; ++i) {
+        if (clients[i].sock >= 0) client_close(&clients[i]);
+    }
+    closesocket(http_listen);
+    http_listen = -1;
+}
+
+uint32_t mock_http_requests(void) {
+    return (uint32_t)SDL_AtomicGet(&http_requests);
+}
+
+uint32_t mock_http_body_bytes(void) {
+    return (uint32_t)SDL_AtomicGet(&http_body_bytes);
+}
+
+uint32_t mock_http_commands(void) {
+    return (uint32_t)SDL_AtomicGet(&http_commands);
+}
+
+void mock_http_change_state(void) {
+    SDL_AtomicLock(&state_lock);
+    state.version++;
+    state.image++;
+    state.display = !state.display;
+    SDL_AtomicUnlock(&state_lock);
+}
+
+void mock_http_set_state(int image, int display, int mode) {
+    SDL_AtomicLock(&state_lock);
+    state.version++;
+    state.image = image;
+    state.display = display;
+    state.mode = mode;
+    SDL_AtomicUnlock(&state_lock);
+}
+
+void mock_http_get_state(int* image, int* display, int* mode) {
+    mock_state_t st = state_get();
+    *image = st.image;
+    *display = st.display;
+    *mode = st.mode;
+}
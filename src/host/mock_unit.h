@@ -0,0 +1,98 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOCK_UNIT_MAX       256
+#define MOCK_UNIT_BASE_IP   "127.0.0.2"      // Unit i answers from 127.0.0.2 + i
+#define MOCK_HTTP_CLIENTS   8
+#define MOCK_MODES          4                // Display Mode cycles through this many
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts a thread that plays Type D units on the loopback network. A probe
+ * sent to MOCK_UNIT_BASE_IP:50501 stands in for a broadcast: it is answered
+ * with TYPE_D_ID:<id> by the first `count` units, each from its own 127.0.0.x
+ * address. A probe sent to any other unit's address:50501 is answered by
+ * that unit alone. Replies are in the version 2 format, with the state
+ * GET /status reports.
+ *
+ * @param count    Units answering probes (at most MOCK_UNIT_MAX)
+ * @param first_id ID of unit 0 (1-6); the others count up from it, wrapping after 6
+ * @return         true if the responder is listening
+ */
+bool mock_discovery_start(int count, uint8_t first_id);
+
+/**
+ * Changes how many units answer probes. Takes effect on the next probe.
+ */
+void mock_discovery_set_count(int count);
+
+/**
+ * Off plays a network that drops broadcasts: unit 0 then answers only for
+ * itself and the other units only to probes sent to their own address.
+ * On after mock_discovery_start().
+ */
+void mock_discovery_set_broadcast(bool on);
+
+/**
+ * Switches replies between the version 1 (ID only) and version 2 formats.
+ */
+void mock_discovery_set_version(int version);
+
+/**
+ * Sends an unsolicited TYPE_D_ID:<id> from unit idx to 127.0.0.1:50502.
+ */
+bool mock_discovery_announce(int idx);
+
+void mock_discovery_stop(void);
+
+/**
+ * Starts an HTTP/1.1 keep-alive server on MOCK_UNIT_BASE_IP:8080 that
+ * answers every request with 200 OK, pipelined requests included. Request
+ * bodies (Content-Length) are read and counted before the reply. GET /status
+ * returns an ETag and answers 304 to If-None-Match until the state changes.
+ * Next/Previous Image, Display Mode (MOCK_MODES of them) and Display On/Off
+ * change the state like a unit would; version 2 discovery replies report it
+ * too.
+ */
+bool mock_http_start(void);
+
+void mock_http_stop(void);
+
+/**
+ * @return Requests answered by the HTTP mock since it started
+ */
+uint32_t mock_http_requests(void);
+
+/**
+ * @return Request body bytes received by the HTTP mock since it started
+ */
+uint32_t mock_http_body_bytes(void);
+
+/**
+ * @return GET /cmd requests answered by the HTTP mock since it started
+ */
+uint32_t mock_http_commands(void);
+
+/**
+ * Changes what GET /status reports, so the next conditional query gets a 200.
+ */
+void mock_http_change_state(void);
+
+/**
+ * Sets the state as if the unit had been left that way; also a change.
+ */
+void mock_http_set_state(int image, int display, int mode);
+void mock_http_get_state(int* image, int* display, int* mode);
+
+/**
+ * @return Address of unit idx (host order, as in type_d_unit_t)
+ */
+uint32_t mock_unit_ip(int idx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,226 @@
+// Replays a session trace (session.h) through the setup screen's own code
+// (app.c) on a software renderer, headless and as fast as it will go. The
+// clock is virtual: it jumps straight to the next record or timer whenever
+// the screen is idle, so a long session replays in moments. Nothing goes to
+// the network; discovery snapshots and command outcomes come from the trace.
+// Figures that depend on the host (unit state, the memory line, the profiler
+// HUD) are left blank, so two runs of the same trace draw the same frames.
+//
+//   replay TRACE [--media DIR] [--csv OUT]
+//
+// Prints the cost of every frame drawn, and of the frames that handled a
+// press from the press to the present, in the bench's format. --csv writes
+// one line per frame.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include "app.h"
+#include "session.h"
+#include "detect.h"
+#include "cmd_queue.h"
+#include "text_cache.h"
+#include "octagon.h"
+#include "damage.h"
+#include "ui.h"
+#include "assets.h"
+#include "compose.h"
+#include "memstat.h"
+
+typedef struct {
+    const char* name;
+    double*     us;
+    int         count;
+    int         cap;
+} series_t;
+
+static Uint64 perf_freq;
+
+static double elapsed_us(Uint64 since) {
+    return (double)(SDL_GetPerformanceCounter() - since) * 1e6 / (double)perf_freq;
+}
+
+static void series_add(series_t* s, double us) {
+    if (s->count == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 1024;
+        double* grown = (double*)realloc(s->us, sizeof(double) * cap);
+        if (!grown) return;
+        s->us = grown;
+        s->cap = cap;
+    }
+    s->us[s->count++] = us;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of the sorted samples
+static double percentile(const series_t* s, int pct) {
+    int rank = (s->count * pct + 99) / 100;
+    if (rank < 1) rank = 1;
+    return s->us[rank - 1];
+}
+
+static void series_report(series_t* s) {
+    if (s->count == 0) {
+        printf("%-24s n=0\n", s->name);
+        return;
+    }
+    qsort(s->us, s->count, sizeof(s->us[0]), cmp_double);
+    double sum = 0;
+    for (int i = 0; i < s->count; ++i) sum += s->us[i];
+    printf("%-24s n=%-4d mean=%9.1f p50=%9.1f p95=%9.1f p99=%9.1f max=%9.1f\n",
+        s->name, s->count, sum / s->count, percentile(s, 50), percentile(s, 95),
+        percentile(s, 99), s->us[s->count - 1]);
+}
+
+// Hands one record to the screen the way the console gets it: a press as a
+// controller event, discovery and command outcomes through their modules
+static void deliver(const session_event_t* ev) {
+    switch (ev->kind) {
+    case SESSION_BUTTON: {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = SDL_CONTROLLERBUTTONDOWN;
+        e.cbutton.timestamp = SDL_GetTicks();
+        e.cbutton.button = ev->button;
+        e.cbutton.state = SDL_PRESSED;
+        SDL_PushEvent(&e);
+        break;
+    }
+    case SESSION_UNITS:
+        detect_replay(ev->units, ev->unit_count);
+        break;
+    case SESSION_RESULT:
+        cmd_queue_post(&ev->result);
+        break;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* trace = NULL;
+    const char* media = "../../media";
+    const char* csv_path = NULL;
+    bool bad = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--media") == 0 && i + 1 < argc) media = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csv_path = argv[++i];
+        else if (!trace && argv[i][0] != '-') trace = argv[i];
+        else bad = true;
+    }
+    if (!trace || bad) {
+        fprintf(stderr, "usage: %s TRACE [--media DIR] [--csv OUT]\n", argv[0]);
+        return 2;
+    }
+    session_reader_t* reader = session_open(trace);
+    if (!reader) {
+        fprintf(stderr, "replay: cannot read %s\n", trace);
+        return 1;
+    }
+    FILE* csv = NULL;
+    if (csv_path && !(csv = fopen(csv_path, "w"))) {
+        fprintf(stderr, "replay: cannot write %s\n", csv_path);
+        session_close(reader);
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0 || TTF_Init() == -1) {
+        fprintf(stderr, "replay: SDL init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+    perf_freq = SDL_GetPerformanceFrequency();
+    comp_init();
+
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_RGB888);
+    SDL_Renderer* r = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    if (!r) {
+        fprintf(stderr, "replay: software renderer failed: %s\n", SDL_GetError());
+        return 1;
+    }
+    text_cache_init(r);
+    octagon_init(r);
+    ui_assets_t assets;
+    assets_load_start(media, screen_width, screen_height);
+    assets_load_finish(r, &assets);
+    if (!assets.title_font || !assets.exit_font) {
+        fprintf(stderr, "replay: cannot load fonts from %s\n", media);
+        return 1;
+    }
+    assets.screen_format = target->format->format;
+
+    uint32_t clock = 0;
+    app_config_t config = { NULL, true };
+    app_init(r, &assets, &config, clock);
+    damage_init(screen_width, screen_height);
+
+    series_t frames = { "replay.frame", NULL, 0, 0 };
+    series_t inputs = { "replay.input", NULL, 0, 0 };
+    if (csv) fprintf(csv, "frame,ms,us,rects,input\n");
+    session_event_t ev;
+    bool have = session_next(reader, &ev);
+    int records = 0;
+    while (app_running()) {
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        mem_frame_reset();
+        app_update(clock);
+        int wait = app_idle_ms(clock);
+        if (wait >= 0) {
+            // Idle: skip ahead to whatever comes first, the next record or a
+            // timer. Past the last record nothing is left to draw.
+            if (!have) break;
+            if ((int32_t)(ev.ms - clock) < wait)
+                clock = (int32_t)(ev.ms - clock) > 0 ? ev.ms : clock;
+            else
+                clock += wait;
+            // The console sleeps here; that is not frame cost
+            t0 = SDL_GetPerformanceCounter();
+            app_update(clock);
+        }
+
+        bool pressed = false;
+        while (have && (int32_t)(ev.ms - clock) <= 0) {
+            pressed |= (ev.kind == SESSION_BUTTON);
+            deliver(&ev);
+            records++;
+            have = session_next(reader, &ev);
+        }
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+            app_handle_event(&event, clock);
+
+        int count;
+        app_render(&count);
+        if (count == 0) continue;
+        SDL_RenderPresent(r);
+        app_frame_done();
+        double us = elapsed_us(t0);
+        series_add(&frames, us);
+        if (pressed) series_add(&inputs, us);
+        if (csv) fprintf(csv, "%d,%u,%.1f,%d,%d\n", frames.count, (unsigned)clock, us, count, pressed);
+    }
+
+    printf("# Type D session replay of %s: %d records, %u ms, %dx%d, times in microseconds\n",
+           trace, records, (unsigned)clock, screen_width, screen_height);
+    series_report(&frames);
+    series_report(&inputs);
+
+    free(frames.us);
+    free(inputs.us);
+    if (csv) fclose(csv);
+    session_close(reader);
+    app_shutdown();
+    text_cache_shutdown();
+    octagon_shutdown();
+    assets_free(&assets);
+    SDL_DestroyRenderer(r);
+    SDL_FreeSurface(target);
+    IMG_Quit();
+    TTF_Quit();
+    SDL_Quit();
+    return 0;
+}
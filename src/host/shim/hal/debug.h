@@ -0,0 +1,11 @@
+#pragma once
+// Host build: debugPrint goes to stderr so it stays out of benchmark output
+#include <stdio.h>
+#include <stdarg.h>
+
+static inline void debugPrint(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
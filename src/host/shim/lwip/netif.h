@@ -0,0 +1,23 @@
+#pragma once
+// Host build: the console's default interface as seen by detect.c. Reports
+// 127.0.0.1/24 so the subnet broadcast and the unicast sweep land on the
+// loopback block the mock units answer from.
+#include <stdint.h>
+#include <arpa/inet.h>
+
+typedef struct {
+    uint32_t host;                    // Host order; lwIP keeps network order, hence ip4_addr_get_u32()
+} ip4_addr_t;
+
+struct netif {
+    ip4_addr_t ip_addr;
+    ip4_addr_t netmask;
+};
+
+static struct netif host_netif = {{0x7F000001u}, {0xFFFFFF00u}};
+static struct netif* const netif_default = &host_netif;
+
+#define netif_is_up(n)        ((n) != NULL)
+#define netif_ip4_addr(n)     (&(n)->ip_addr)
+#define netif_ip4_netmask(n)  (&(n)->netmask)
+#define ip4_addr_get_u32(a)   htonl((a)->host)
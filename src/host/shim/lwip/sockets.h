@@ -0,0 +1,19 @@
+#pragma once
+// Host build: map the lwIP socket API used by detect.c and send_cmd.c onto POSIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <unistd.h>
+
+static inline int closesocket(int s) {
+    return close(s);
+}
+
+static inline int ioctlsocket(int s, long cmd, void* argp) {
+    return ioctl(s, (unsigned long)cmd, argp);
+}
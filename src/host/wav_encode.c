@@ -0,0 +1,144 @@
+// WAV writers for the tools and the bench; the console only decodes
+#include "wav_encode.h"
+#include <stdio.h>
+#include <string.h>
+#include "wav.h"
+
+static void wr16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void wr32(uint8_t* p, uint32_t v) {
+    wr16(p, (uint16_t)v);
+    wr16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void chunk(FILE* f, const char* id, uint32_t size) {
+    uint8_t h[8];
+    memcpy(h, id, 4);
+    wr32(h + 4, size);
+    fwrite(h, 1, sizeof(h), f);
+}
+
+static bool finish(FILE* f) {
+    bool ok = !ferror(f);
+    return (fclose(f) == 0) && ok;
+}
+
+bool wav_write_pcm(const char* path, const int16_t* pcm, uint32_t frames, int channels, uint32_t rate) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    uint32_t data = frames * channels * 2;
+    chunk(f, "RIFF", 4 + 8 + 16 + 8 + data);
+    fwrite("WAVE", 1, 4, f);
+    uint8_t fmt[16];
+    wr16(fmt, WAV_FORMAT_PCM);
+    wr16(fmt + 2, (uint16_t)channels);
+    wr32(fmt + 4, rate);
+    wr32(fmt + 8, rate * channels * 2);
+    wr16(fmt + 12, (uint16_t)(channels * 2));
+    wr16(fmt + 14, 16);
+    chunk(f, "fmt ", sizeof(fmt));
+    fwrite(fmt, 1, sizeof(fmt), f);
+    chunk(f, "data", data);
+    for (uint32_t i = 0; i < frames * channels; ++i) {
+        uint8_t s[2];
+        wr16(s, (uint16_t)pcm[i]);
+        fwrite(s, 1, 2, f);
+    }
+    return finish(f);
+}
+
+// Picks the nibble whose decoded value lands closest, then steps the state
+// exactly as the decoder will
+static int ima_encode(wav_ima_state_t* s, int sample) {
+    int step = wav_ima_step_size(s);
+    int diff = sample - s->predictor;
+    int nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) nibble |= 1;
+    wav_ima_expand(s, nibble);
+    return nibble;
+}
+
+// One block of block_frames frames; the step index carries over between blocks
+static void ima_block(const int16_t* pcm, int channels, int block_frames, int* index, uint8_t* out) {
+    wav_ima_state_t st[2];
+    for (int c = 0; c < channels; ++c) {
+        st[c].predictor = pcm[c];
+        st[c].index = index[c];
+        wr16(out + 4 * c, (uint16_t)pcm[c]);
+        out[4 * c + 2] = (uint8_t)index[c];
+        out[4 * c + 3] = 0;
+    }
+    uint8_t* p = out + 4 * channels;
+    for (int g = 0; g < (block_frames - 1) / 8; ++g) {
+        for (int c = 0; c < channels; ++c) {
+            const int16_t* in = pcm + (1 + g * 8) * channels + c;
+            for (int k = 0; k < 4; ++k) {
+                int lo = ima_encode(&st[c], in[(2 * k) * channels]);
+                int hi = ima_encode(&st[c], in[(2 * k + 1) * channels]);
+                *p++ = (uint8_t)(lo | hi << 4);
+            }
+        }
+    }
+    for (int c = 0; c < channels; ++c)
+        index[c] = st[c].index;
+}
+
+bool wav_write_ima(const char* path, const int16_t* pcm, uint32_t frames, int channels, uint32_t rate) {
+    int block_align = WAV_ENCODE_BLOCK_BYTES * channels;
+    int block_frames = wav_ima_block_frames(block_align, channels);
+    uint32_t blocks = (frames + block_frames - 1) / block_frames;
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    uint32_t data = blocks * block_align;
+    chunk(f, "RIFF", 4 + 8 + 20 + 8 + 4 + 8 + data);
+    fwrite("WAVE", 1, 4, f);
+    uint8_t fmt[20];
+    wr16(fmt, WAV_FORMAT_IMA_ADPCM);
+    wr16(fmt + 2, (uint16_t)channels);
+    wr32(fmt + 4, rate);
+    wr32(fmt + 8, (uint32_t)((uint64_t)rate * block_align / block_frames));
+    wr16(fmt + 12, (uint16_t)block_align);
+    wr16(fmt + 14, 4);
+    wr16(fmt + 16, 2);
+    wr16(fmt + 18, (uint16_t)block_frames);
+    chunk(f, "fmt ", sizeof(fmt));
+    fwrite(fmt, 1, sizeof(fmt), f);
+    uint8_t fact[4];
+    wr32(fact, frames);
+    chunk(f, "fact", sizeof(fact));
+    fwrite(fact, 1, sizeof(fact), f);
+    chunk(f, "data", data);
+
+    // The last block repeats its final frame to fill up
+    int16_t in[WAV_SRC_FRAMES * 2];
+    uint8_t out[WAV_BLOCK_MAX];
+    int index[2] = {0, 0};
+    for (uint32_t b = 0; b < blocks; ++b) {
+        uint32_t first = b * block_frames;
+        uint32_t n = frames - first < (uint32_t)block_frames ? frames - first : (uint32_t)block_frames;
+        memcpy(in, pcm + first * channels, n * channels * sizeof(int16_t));
+        for (uint32_t i = n; i < (uint32_t)block_frames; ++i)
+            memcpy(in + i * channels, in + (n - 1) * channels, channels * sizeof(int16_t));
+        ima_block(in, channels, block_frames, index, out);
+        fwrite(out, 1, block_align, f);
+    }
+    return finish(f);
+}
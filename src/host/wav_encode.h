@@ -0,0 +1,24 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WAV_ENCODE_BLOCK_BYTES 1024   // IMA ADPCM block per channel; 2041 frames at any channel count
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Writes interleaved S16 samples as a 16-bit PCM WAV file.
+ */
+bool wav_write_pcm(const char* path, const int16_t* pcm, uint32_t frames, int channels, uint32_t rate);
+
+/**
+ * Writes interleaved S16 samples as an IMA ADPCM WAV file, with a fact chunk
+ * so the padding in the last block is not played.
+ */
+bool wav_write_ima(const char* path, const int16_t* pcm, uint32_t frames, int channels, uint32_t rate);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,237 @@
+#include "memstat.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef NXDK
+#include <xboxkrnl/xboxkrnl.h>
+#endif
+
+#define MEM_PAGE_BYTES 4096
+#define MEM_SIZE_MAX   (0x7FFFFFFF - MEM_ALIGN)   // Counters are signed 32-bit
+
+typedef struct {
+    SDL_atomic_t heap, heap_peak, blocks, allocs;
+    SDL_atomic_t surface, surface_peak;
+    SDL_atomic_t texture, texture_peak;
+    SDL_atomic_t fixed;
+} counters_t;
+
+// In front of every counted block; padded so the block keeps malloc's alignment
+typedef union {
+    struct {
+        uint32_t size;
+        uint32_t sub;
+    } h;
+    uint8_t pad[MEM_ALIGN];
+} block_head_t;
+
+static counters_t counters[MEM_SUBSYS_COUNT];
+static SDL_atomic_t heap_total, heap_total_peak;
+
+// Frame arena, main thread only. One spare MEM_ALIGN so the start can be aligned.
+static uint8_t arena[MEM_FRAME_ARENA_BYTES + MEM_ALIGN];
+static uint32_t arena_used = 0;
+static uint32_t frame_peak = 0;
+static uint32_t frame_spills = 0;
+
+static bool probed = false;
+static Uint32 probe_next = 0;
+static uint32_t largest_block = 0;
+static uint32_t sys_total = 0, sys_free = 0;
+
+static void raise_peak(SDL_atomic_t* peak, int value) {
+    int seen = SDL_AtomicGet(peak);
+    while (value > seen && !SDL_AtomicCAS(peak, seen, value))
+        seen = SDL_AtomicGet(peak);
+}
+
+static void count(SDL_atomic_t* cur, SDL_atomic_t* peak, int delta) {
+    int now = SDL_AtomicAdd(cur, delta) + delta;
+    if (delta > 0) raise_peak(peak, now);
+}
+
+static void heap_count(uint32_t sub, int delta, int blocks) {
+    counters_t* c = &counters[sub];
+    count(&c->heap, &c->heap_peak, delta);
+    count(&heap_total, &heap_total_peak, delta);
+    if (blocks) SDL_AtomicAdd(&c->blocks, blocks);
+    if (blocks > 0) SDL_AtomicIncRef(&c->allocs);
+}
+
+void* mem_alloc(mem_subsys_t sub, size_t size) {
+    if (size > MEM_SIZE_MAX) return NULL;
+    block_head_t* b = (block_head_t*)malloc(sizeof(*b) + size);
+    if (!b) return NULL;
+    b->h.size = (uint32_t)size;
+    b->h.sub = (uint32_t)sub;
+    heap_count(sub, (int)size, 1);
+    return b + 1;
+}
+
+void* mem_calloc(mem_subsys_t sub, size_t count, size_t size) {
+    if (size && count > MEM_SIZE_MAX / size) return NULL;
+    void* p = mem_alloc(sub, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+void* mem_realloc(mem_subsys_t sub, void* p, size_t size) {
+    if (!p) return mem_alloc(sub, size);
+    if (size > MEM_SIZE_MAX) return NULL;
+    block_head_t* b = (block_head_t*)p - 1;
+    uint32_t was = b->h.size;
+    b = (block_head_t*)realloc(b, sizeof(*b) + size);
+    if (!b) return NULL;
+    b->h.size = (uint32_t)size;
+    heap_count(b->h.sub, (int)size - (int)was, 0);
+    return b + 1;
+}
+
+void mem_free(void* p) {
+    if (!p) return;
+    block_head_t* b = (block_head_t*)p - 1;
+    heap_count(b->h.sub, -(int)b->h.size, -1);
+    free(b);
+}
+
+void mem_note_fixed(mem_subsys_t sub, int bytes) {
+    SDL_AtomicAdd(&counters[sub].fixed, bytes);
+}
+
+static int surface_bytes(const SDL_Surface* s) {
+    return s->pitch * s->h;
+}
+
+SDL_Surface* mem_surface_note(mem_subsys_t sub, SDL_Surface* s) {
+    if (s) count(&counters[sub].surface, &counters[sub].surface_peak, surface_bytes(s));
+    return s;
+}
+
+void mem_surface_free(mem_subsys_t sub, SDL_Surface* s) {
+    if (!s) return;
+    count(&counters[sub].surface, &counters[sub].surface_peak, -surface_bytes(s));
+    SDL_FreeSurface(s);
+}
+
+static int texture_bytes(SDL_Texture* t) {
+    Uint32 format;
+    int w, h;
+    if (SDL_QueryTexture(t, &format, NULL, &w, &h) != 0) return 0;
+    return w * h * SDL_BYTESPERPIXEL(format);
+}
+
+static SDL_Texture* texture_note(mem_subsys_t sub, SDL_Texture* t) {
+    if (t) count(&counters[sub].texture, &counters[sub].texture_peak, texture_bytes(t));
+    return t;
+}
+
+SDL_Texture* mem_texture_create(mem_subsys_t sub, SDL_Renderer* r, Uint32 format, int access, int w, int h) {
+    return texture_note(sub, SDL_CreateTexture(r, format, access, w, h));
+}
+
+SDL_Texture* mem_texture_from_surface(mem_subsys_t sub, SDL_Renderer* r, SDL_Surface* s) {
+    return texture_note(sub, SDL_CreateTextureFromSurface(r, s));
+}
+
+void mem_texture_destroy(mem_subsys_t sub, SDL_Texture* t) {
+    if (!t) return;
+    count(&counters[sub].texture, &counters[sub].texture_peak, -texture_bytes(t));
+    SDL_DestroyTexture(t);
+}
+
+void* mem_frame_alloc(size_t size) {
+    uint8_t* base = (uint8_t*)(((uintptr_t)arena + MEM_ALIGN - 1) & ~(uintptr_t)(MEM_ALIGN - 1));
+    if (size > MEM_FRAME_ARENA_BYTES) {
+        frame_spills++;
+        return NULL;
+    }
+    uint32_t need = (uint32_t)(size + MEM_ALIGN - 1) & ~(uint32_t)(MEM_ALIGN - 1);
+    if (need > MEM_FRAME_ARENA_BYTES - arena_used) {
+        frame_spills++;
+        return NULL;
+    }
+    void* p = base + arena_used;
+    arena_used += need;
+    return p;
+}
+
+void mem_frame_reset(void) {
+    if (arena_used > frame_peak) frame_peak = arena_used;
+    arena_used = 0;
+}
+
+// Halves its way down from MEM_PROBE_MAX_BYTES; a fragmented heap has plenty
+// free but no single block as large
+static uint32_t probe_largest(void) {
+    void* p = malloc(MEM_PROBE_MAX_BYTES);
+    if (p) {
+        free(p);
+        return MEM_PROBE_MAX_BYTES;
+    }
+    uint32_t lo = 0, hi = MEM_PROBE_MAX_BYTES;   // lo fits, hi does not
+    while (hi - lo > MEM_PROBE_MIN_BYTES) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        p = malloc(mid);
+        if (p) {
+            free(p);
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void probe_system(void) {
+#ifdef NXDK
+    MM_STATISTICS ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.Length = sizeof(ms);
+    if (NT_SUCCESS(MmQueryStatistics(&ms))) {
+        sys_total = ms.TotalPhysicalPages * MEM_PAGE_BYTES;
+        sys_free = ms.AvailablePages * MEM_PAGE_BYTES;
+    }
+#endif
+    largest_block = probe_largest();
+}
+
+static uint32_t get(SDL_atomic_t* a) {
+    int v = SDL_AtomicGet(a);
+    return v > 0 ? (uint32_t)v : 0;
+}
+
+void mem_report(mem_report_t* out, bool probe) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < MEM_SUBSYS_COUNT; ++i) {
+        counters_t* c = &counters[i];
+        mem_usage_t* u = &out->sub[i];
+        u->heap_bytes = get(&c->heap);
+        u->heap_peak = get(&c->heap_peak);
+        u->heap_blocks = get(&c->blocks);
+        u->heap_allocs = (uint32_t)SDL_AtomicGet(&c->allocs);
+        u->surface_bytes = get(&c->surface);
+        u->surface_peak = get(&c->surface_peak);
+        u->texture_bytes = get(&c->texture);
+        u->texture_peak = get(&c->texture_peak);
+        u->fixed_bytes = get(&c->fixed);
+    }
+    out->heap_bytes = get(&heap_total);
+    out->heap_peak = get(&heap_total_peak);
+    out->frame_used = arena_used;
+    out->frame_peak = arena_used > frame_peak ? arena_used : frame_peak;
+    out->frame_spills = frame_spills;
+
+    Uint32 now = SDL_GetTicks();
+    if (probe && (!probed || SDL_TICKS_PASSED(now, probe_next))) {
+        probe_system();
+        probe_next = now + MEM_PROBE_MS;
+        probed = true;
+    }
+    out->sys_total_bytes = sys_total;
+    out->sys_free_bytes = sys_free;
+    out->largest_block = largest_block;
+}
+
+const char* mem_subsys_name(mem_subsys_t sub) {
+    static const char* names[MEM_SUBSYS_COUNT] = {"ui", "audio", "detect", "net"};
+    return sub < MEM_SUBSYS_COUNT ? names[sub] : "?";
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL.h>
+
+#define MEM_FRAME_ARENA_BYTES (64 * 1024)   // Scratch served by mem_frame_alloc(), reset every frame
+#define MEM_ALIGN             16            // Of every block; also the size of the heap block header
+#define MEM_PROBE_MAX_BYTES   (4u << 20)    // Largest block the fragmentation probe asks for
+#define MEM_PROBE_MIN_BYTES   (64u << 10)   // Probe resolution
+#define MEM_PROBE_MS          5000          // Minimum gap between probes
+
+// Who owns the memory. Each subsystem's heap blocks, surfaces and textures
+// are counted separately so a slow leak points at its owner.
+typedef enum {
+    MEM_UI = 0,                       // Text cache, sprites, layers, assets
+    MEM_AUDIO,
+    MEM_DETECT,                       // Unit registry and snapshots
+    MEM_NET,                          // Connections, command results, upload buffers
+    MEM_SUBSYS_COUNT
+} mem_subsys_t;
+
+typedef struct {
+    uint32_t heap_bytes;              // Live blocks from mem_alloc() and friends, headers excluded
+    uint32_t heap_peak;
+    uint32_t heap_blocks;
+    uint32_t heap_allocs;             // Blocks handed out since start; a rising rate is churn
+    uint32_t surface_bytes;           // Surfaces between mem_surface_note() and mem_surface_free()
+    uint32_t surface_peak;
+    uint32_t texture_bytes;           // Textures made through mem_texture_*()
+    uint32_t texture_peak;
+    uint32_t fixed_bytes;             // Static and driver buffers from mem_note_fixed()
+} mem_usage_t;
+
+typedef struct {
+    mem_usage_t sub[MEM_SUBSYS_COUNT];
+    uint32_t heap_bytes;              // Every subsystem
+    uint32_t heap_peak;               // High-water mark of the sum, not the sum of the marks
+    uint32_t frame_used;              // Arena bytes handed out so far this frame
+    uint32_t frame_peak;              // Most any frame took
+    uint32_t frame_spills;            // Requests the arena could not serve since start
+    uint32_t sys_total_bytes;         // Physical memory per the kernel, 0 where unknown
+    uint32_t sys_free_bytes;
+    uint32_t largest_block;           // Largest block malloc() handed out at the last probe,
+                                      // MEM_PROBE_MAX_BYTES if that much, 0 before the first
+} mem_report_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Counted malloc/calloc/realloc/free. A block remembers its subsystem, so
+ * mem_free() and mem_realloc() need only the pointer. Safe from any thread.
+ */
+void* mem_alloc(mem_subsys_t sub, size_t size);
+void* mem_calloc(mem_subsys_t sub, size_t count, size_t size);
+void* mem_realloc(mem_subsys_t sub, void* p, size_t size);
+void  mem_free(void* p);
+
+/**
+ * Counts memory that is not heap but belongs to a subsystem while it runs,
+ * such as a static ring or a driver's buffer, so it shows next to the heap.
+ *
+ * @param bytes Added, or taken away when negative
+ */
+void mem_note_fixed(mem_subsys_t sub, int bytes);
+
+/**
+ * Counts a surface from SDL, SDL_ttf or SDL_image; release it with
+ * mem_surface_free(). NULL is ignored.
+ *
+ * @return s
+ */
+SDL_Surface* mem_surface_note(mem_subsys_t sub, SDL_Surface* s);
+void mem_surface_free(mem_subsys_t sub, SDL_Surface* s);
+
+/**
+ * SDL_CreateTexture / SDL_CreateTextureFromSurface that count the pixels.
+ * Destroy the result with mem_texture_destroy().
+ */
+SDL_Texture* mem_texture_create(mem_subsys_t sub, SDL_Renderer* r, Uint32 format, int access, int w, int h);
+SDL_Texture* mem_texture_from_surface(mem_subsys_t sub, SDL_Renderer* r, SDL_Surface* s);
+void mem_texture_destroy(mem_subsys_t sub, SDL_Texture* t);
+
+/**
+ * Scratch memory that lives until the end of the frame, MEM_ALIGN aligned.
+ * Main thread only.
+ *
+ * @return NULL if the arena is full; the caller falls back to its own storage
+ */
+void* mem_frame_alloc(size_t size);
+
+/**
+ * Hands the whole arena back. Called once per main loop pass.
+ */
+void mem_frame_reset(void);
+
+/**
+ * Fills in the counters. With probe set, and at most every MEM_PROBE_MS, also
+ * asks the kernel for free memory and finds the largest block malloc() can
+ * still hand out, which falls behind free memory as the heap fragments.
+ */
+void mem_report(mem_report_t* out, bool probe);
+
+const char* mem_subsys_name(mem_subsys_t sub);
+
+#ifdef __cplusplus
+}
+#endif
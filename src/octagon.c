@@ -0,0 +1,179 @@
+#include "octagon.h"
+#include "profiler.h"
+#include "memstat.h"
+#include <string.h>
+#include <hal/debug.h>
+
+#define OCTAGON_MAX_ROWS 512
+
+typedef struct {
+    int          w, h, margin;   // Inner rect size and corner margin
+    SDL_Color    fill, border;
+    bool         has_border;
+    SDL_Texture* tex;
+} octagon_sprite_t;
+
+static SDL_Renderer* renderer = NULL;
+static octagon_sprite_t sprites[OCTAGON_SPRITES];
+static int sprite_count = 0;
+
+// Corner inset of row dy for an octagon of outer height h (45 degree corners).
+// Row h itself is never filled, matching the half-open scanline rule.
+static int row_inset(int dy, int h, int margin) {
+    if (dy < margin) return margin - dy;
+    if (dy >= h - margin) return dy - (h - margin);
+    return 0;
+}
+
+static bool same_color(SDL_Color a, SDL_Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static octagon_sprite_t* find_sprite(int w, int h, int margin, SDL_Color fill, const SDL_Color* border) {
+    for (int i = 0; i < sprite_count; ++i) {
+        octagon_sprite_t* s = &sprites[i];
+        if (s->w == w && s->h == h && s->margin == margin &&
+            same_color(s->fill, fill) && s->has_border == (border != NULL) &&
+            (!border || same_color(s->border, *border)))
+            return s;
+    }
+    return NULL;
+}
+
+static void put_pixel(SDL_Surface* s, int x, int y, Uint32 px) {
+    if (x < 0 || y < 0 || x >= s->w || y >= s->h) return;
+    ((Uint32*)((Uint8*)s->pixels + y * s->pitch))[x] = px;
+}
+
+// Rasterize fill spans plus optional outline into a transparent ARGB surface
+static SDL_Texture* build_sprite(int w, int h, int margin, SDL_Color fill, const SDL_Color* border) {
+    int ow = w + 2 * margin, oh = h + 2 * margin;
+    SDL_Surface* s = mem_surface_note(MEM_UI, SDL_CreateRGBSurfaceWithFormat(0, ow + 1, oh + 1, 32, SDL_PIXELFORMAT_ARGB8888));
+    if (!s) return NULL;
+    SDL_FillRect(s, NULL, 0);
+
+    Uint32 fpx = SDL_MapRGBA(s->format, fill.r, fill.g, fill.b, fill.a);
+    for (int dy = 0; dy < oh; ++dy) {
+        int in = row_inset(dy, oh, margin);
+        SDL_Rect span = {in, dy, ow - 2 * in + 1, 1};
+        SDL_FillRect(s, &span, fpx);
+    }
+
+    if (border) {
+        Uint32 bpx = SDL_MapRGBA(s->format, border->r, border->g, border->b, border->a);
+        if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+        for (int x = margin; x <= ow - margin; ++x) {
+            put_pixel(s, x, 0, bpx);
+            put_pixel(s, x, oh, bpx);
+        }
+        for (int y = margin; y <= oh - margin; ++y) {
+            put_pixel(s, 0, y, bpx);
+            put_pixel(s, ow, y, bpx);
+        }
+        for (int k = 0; k <= margin; ++k) {
+            put_pixel(s, margin - k, k, bpx);               // top-left
+            put_pixel(s, ow - margin + k, k, bpx);          // top-right
+            put_pixel(s, ow - k, oh - margin + k, bpx);     // bottom-right
+            put_pixel(s, k, oh - margin + k, bpx);          // bottom-left
+        }
+        if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
+    }
+
+    SDL_Texture* tex = mem_texture_from_surface(MEM_UI, renderer, s);
+    mem_surface_free(MEM_UI, s);
+    if (tex) SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    return tex;
+}
+
+void octagon_init(SDL_Renderer* r) {
+    renderer = r;
+    memset(sprites, 0, sizeof(sprites));
+    sprite_count = 0;
+}
+
+void octagon_shutdown(void) {
+    for (int i = 0; i < sprite_count; ++i)
+        mem_texture_destroy(MEM_UI, sprites[i].tex);
+    memset(sprites, 0, sizeof(sprites));
+    sprite_count = 0;
+}
+
+bool octagon_prepare(int w, int h, int margin, SDL_Color fill, const SDL_Color* border) {
+    if (!renderer || w <= 0 || h <= 0 || margin < 0) return false;
+    if (find_sprite(w, h, margin, fill, border)) return true;
+    if (sprite_count >= OCTAGON_SPRITES) {
+        debugPrint("[octagon] Sprite cache full\n");
+        return false;
+    }
+
+    SDL_Texture* tex = build_sprite(w, h, margin, fill, border);
+    if (!tex) return false;
+
+    octagon_sprite_t* s = &sprites[sprite_count++];
+    s->w = w;
+    s->h = h;
+    s->margin = margin;
+    s->fill = fill;
+    s->has_border = (border != NULL);
+    if (border) s->border = *border;
+    s->tex = tex;
+    return true;
+}
+
+static void draw(SDL_Rect rc, int margin, SDL_Color fill, const SDL_Color* border) {
+    octagon_sprite_t* s = find_sprite(rc.w, rc.h, margin, fill, border);
+    if (!s && octagon_prepare(rc.w, rc.h, margin, fill, border))
+        s = find_sprite(rc.w, rc.h, margin, fill, border);
+
+    if (s) {
+        SDL_Rect dst = {rc.x - margin, rc.y - margin, rc.w + 2 * margin + 1, rc.h + 2 * margin + 1};
+        SDL_RenderCopy(renderer, s->tex, NULL, &dst);
+        return;
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    octagon_fill_spans(renderer, rc, margin, fill);
+    if (border) octagon_outline(renderer, rc, margin, *border);
+}
+
+void octagon_draw(SDL_Rect rc, int margin, SDL_Color fill, const SDL_Color* border) {
+    if (!renderer) return;
+    uint64_t t0 = profiler_begin();
+    draw(rc, margin, fill, border);
+    profiler_end(PROF_BUTTONS, t0);
+}
+
+void octagon_fill_spans(SDL_Renderer* r, SDL_Rect rc, int margin, SDL_Color c) {
+    int l = rc.x - margin, t = rc.y - margin;
+    int w = rc.w + 2 * margin, h = rc.h + 2 * margin;
+    SDL_Rect spans[OCTAGON_MAX_ROWS];
+    int n = 0;
+    SDL_SetRenderDrawColor(r, c.r, c.g, c.b, c.a);
+    for (int dy = 0; dy < h; ++dy) {
+        int in = row_inset(dy, h, margin);
+        spans[n++] = (SDL_Rect){l + in, t + dy, w - 2 * in + 1, 1};
+        if (n == OCTAGON_MAX_ROWS) {
+            SDL_RenderFillRects(r, spans, n);
+            n = 0;
+        }
+    }
+    if (n > 0) SDL_RenderFillRects(r, spans, n);
+}
+
+void octagon_outline(SDL_Renderer* r, SDL_Rect rc, int margin, SDL_Color c) {
+    int l = rc.x - margin, t = rc.y - margin;
+    int w = rc.w + 2 * margin, h = rc.h + 2 * margin;
+    SDL_Point pts[9] = {
+        {l + margin,     t},
+        {l + w - margin, t},
+        {l + w,     t + margin},
+        {l + w,     t + h - margin},
+        {l + w - margin, t + h},
+        {l + margin,     t + h},
+        {l,         t + h - margin},
+        {l,         t + margin},
+        {l + margin,     t}
+    };
+    SDL_SetRenderDrawColor(r, c.r, c.g, c.b, c.a);
+    SDL_RenderDrawLines(r, pts, 9);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdbool.h>
+#include <SDL.h>
+
+#define OCTAGON_SPRITES 16    // Distinct (size, margin, colors) combinations kept as textures
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binds the sprite cache to a renderer. Must be called before drawing.
+ */
+void octagon_init(SDL_Renderer* r);
+
+/**
+ * Destroys all cached sprites (call on shutdown or before a video mode change).
+ */
+void octagon_shutdown(void);
+
+/**
+ * Pre-renders the sprite for a shape so the first frame does not pay for it.
+ * Arguments match octagon_draw().
+ *
+ * @return true if the sprite is cached
+ */
+bool octagon_prepare(int w, int h, int margin, SDL_Color fill, const SDL_Color* border);
+
+/**
+ * Draws an octagon grown by margin around rc, filled with fill and optionally
+ * outlined with border (NULL for no outline). Alpha in either color is blended.
+ * Uses a cached sprite when possible, otherwise rasterizes spans directly.
+ */
+void octagon_draw(SDL_Rect rc, int margin, SDL_Color fill, const SDL_Color* border);
+
+/**
+ * Span-table fallback: fills the octagon straight through the renderer.
+ */
+void octagon_fill_spans(SDL_Renderer* r, SDL_Rect rc, int margin, SDL_Color c);
+
+/**
+ * Draws just the octagon outline through the renderer.
+ */
+void octagon_outline(SDL_Renderer* r, SDL_Rect rc, int margin, SDL_Color c);
+
+#ifdef __cplusplus
+}
+#endif
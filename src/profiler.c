@@ -0,0 +1,126 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <hal/debug.h>
+#include <SDL.h>
+
+typedef struct {
+    uint64_t start_us;
+    uint32_t dur_us;
+    uint8_t  stage;
+} prof_record_t;
+
+// Overwriting ring: the producer never waits. Readers copy a range, then
+// re-read head and drop whatever the producer may have reused meanwhile.
+static prof_record_t ring[PROFILER_RING];
+static SDL_atomic_t head;             // Records ever written
+
+static const char* stage_names[PROF_STAGE_COUNT] = {
+    "frame", "detect", "events", "background", "buttons", "text", "device_bar", "present"
+};
+
+static uint64_t now_us(void) {
+    static Uint64 freq = 0;
+    static Uint64 origin = 0;
+    if (!freq) {
+        freq = SDL_GetPerformanceFrequency();
+        origin = SDL_GetPerformanceCounter();
+    }
+    return (uint64_t)((SDL_GetPerformanceCounter() - origin) * 1000000.0 / (double)freq);
+}
+
+uint64_t profiler_begin(void) {
+    return now_us();
+}
+
+void profiler_end(prof_stage_t stage, uint64_t start_us) {
+    uint32_t h = (uint32_t)SDL_AtomicGet(&head);
+    prof_record_t* r = &ring[h & (PROFILER_RING - 1)];
+    r->start_us = start_us;
+    r->dur_us = (uint32_t)(now_us() - start_us);
+    r->stage = (uint8_t)stage;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&head, (int)(h + 1));
+}
+
+const char* profiler_stage_name(prof_stage_t stage) {
+    return stage < PROF_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+// Copies the newest records into out (oldest first); returns how many are intact
+static int ring_copy(prof_record_t* out) {
+    uint32_t h = (uint32_t)SDL_AtomicGet(&head);
+    SDL_MemoryBarrierAcquire();
+    uint32_t n = h < PROFILER_RING ? h : PROFILER_RING;
+    uint32_t first = h - n;
+    for (uint32_t i = 0; i < n; ++i)
+        out[i] = ring[(first + i) & (PROFILER_RING - 1)];
+    SDL_MemoryBarrierAcquire();
+
+    // Index i is intact only if the producer has not started on i + PROFILER_RING
+    uint32_t h2 = (uint32_t)SDL_AtomicGet(&head);
+    uint32_t lost = (h2 + 1 > first + PROFILER_RING) ? h2 + 1 - (first + PROFILER_RING) : 0;
+    if (lost >= n) return 0;
+    if (lost) memmove(out, out + lost, sizeof(prof_record_t) * (n - lost));
+    return (int)(n - lost);
+}
+
+void profiler_summarize(profiler_summary_t* out) {
+    static prof_record_t copy[PROFILER_RING];
+    int n = ring_copy(copy);
+    uint64_t stage_sum[PROF_STAGE_COUNT] = {0};
+    uint64_t frame_sum = 0;
+    memset(out, 0, sizeof(*out));
+
+    // Walk back from the newest record; ones after the last frame end belong
+    // to a frame that is still being drawn, and ones that started before a
+    // frame did to a loop pass that drew nothing
+    bool in_frame = false;
+    uint64_t frame_start = 0;
+    for (int i = n - 1; i >= 0; --i) {
+        const prof_record_t* r = &copy[i];
+        if (r->stage == PROF_FRAME) {
+            if (out->frames == PROFILER_WINDOW) break;
+            in_frame = true;
+            frame_start = r->start_us;
+            out->frames++;
+            frame_sum += r->dur_us;
+            if (r->dur_us > out->frame_max_us) out->frame_max_us = r->dur_us;
+            continue;
+        }
+        if (!in_frame || r->start_us < frame_start) continue;
+        stage_sum[r->stage] += r->dur_us;
+        if (r->dur_us > out->stage_max_us[r->stage]) out->stage_max_us[r->stage] = r->dur_us;
+    }
+    if (!out->frames) return;
+    out->frame_avg_us = (uint32_t)(frame_sum / out->frames);
+    out->stage_avg_us[PROF_FRAME] = out->frame_avg_us;
+    out->stage_max_us[PROF_FRAME] = out->frame_max_us;
+    for (int s = 1; s < PROF_STAGE_COUNT; ++s)
+        out->stage_avg_us[s] = (uint32_t)(stage_sum[s] / out->frames);
+}
+
+int profiler_dump(const char* path) {
+    prof_record_t* copy = (prof_record_t*)malloc(sizeof(prof_record_t) * PROFILER_RING);
+    if (!copy) return -1;
+    int n = ring_copy(copy);
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        debugPrint("[profiler] Cannot open %s\n", path);
+        free(copy);
+        return -1;
+    }
+    // Complete ("X") events on one thread; ts and dur are in microseconds
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    for (int i = 0; i < n; ++i) {
+        fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"dur\":%u}",
+                i ? ",\n" : "", profiler_stage_name((prof_stage_t)copy[i].stage),
+                (unsigned long long)copy[i].start_us, (unsigned)copy[i].dur_us);
+    }
+    fputs("\n]}\n", f);
+    bool ok = (fclose(f) == 0);
+    free(copy);
+    return ok ? n : -1;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILER_RING         8192    // Timing records kept (power of two), a few hundred frames
+#define PROFILER_WINDOW       120     // Frames averaged for the HUD
+#define PROFILER_DUMP_PATH    "D:\\typed_trace.json"
+
+// Stages nest (text inside the device bar, everything inside frame), so
+// their times are inclusive
+typedef enum {
+    PROF_FRAME = 0,                   // Loop iteration that drew, minus the idle wait
+    PROF_DETECT,                      // Discovery snapshot swap and device state rebuild
+    PROF_EVENTS,                      // Input and completion event handling
+    PROF_BACKGROUND,                  // Clear and background blit
+    PROF_BUTTONS,                     // octagon_draw
+    PROF_TEXT,                        // text_cache lookups, rasterizing and glyph runs
+    PROF_DEVICE_BAR,
+    PROF_PRESENT,                     // SDL_RenderPresent and the window surface update
+    PROF_STAGE_COUNT
+} prof_stage_t;
+
+typedef struct {
+    uint32_t frames;                  // Frames in the window
+    uint32_t frame_avg_us;
+    uint32_t frame_max_us;
+    uint32_t stage_avg_us[PROF_STAGE_COUNT];   // Per frame
+    uint32_t stage_max_us[PROF_STAGE_COUNT];   // Longest single record
+} profiler_summary_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts a timed scope. Pair with profiler_end() on the same thread.
+ *
+ * @return Start timestamp in microseconds
+ */
+uint64_t profiler_begin(void);
+
+/**
+ * Closes a scope and appends its record to the ring. Single producer: only
+ * the main (render) thread records.
+ */
+void profiler_end(prof_stage_t stage, uint64_t start_us);
+
+/**
+ * @return Printable stage name, also used in the trace
+ */
+const char* profiler_stage_name(prof_stage_t stage);
+
+/**
+ * Averages over the last PROFILER_WINDOW complete frames in the ring.
+ */
+void profiler_summarize(profiler_summary_t* out);
+
+/**
+ * Writes every record still in the ring as Chrome trace JSON
+ * (chrome://tracing, Perfetto). Records written meanwhile are kept out of
+ * the dump rather than torn.
+ *
+ * @return Records written, or -1 if the file could not be written
+ */
+int profiler_dump(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,34 +1,172 @@
 #include "send_cmd.h"
+#include "telemetry.h"
+#include "memstat.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <lwip/sockets.h>
 #include <hal/debug.h>  // For debugPrint()
+#include <SDL.h>
 
 #define TYPE_D_CMD_PORT 8080
+#define HTTP_REQUEST_MAX     512
+#define HTTP_LINE_MAX        256
+#define HTTP_BODY_IDLE_MS    200     // Quiet time that ends a body with no length
 
-// param can be "val=50" or "file=foo" or NULL
-bool send_cmd(const char* ip, const char* cmd_code, const char* param) {
-    if (!ip || !cmd_code) {
-        debugPrint("[send_cmd] Invalid IP or command\n");
+typedef struct {
+    uint32_t addr;       // Peer IPv4 address (network order)
+    int      sock;
+    bool     open;
+    bool     busy;       // Owned by a caller right now
+    bool     pooled;     // false for one-shot connections when the pool is full
+    Uint32   last_used;
+} http_conn_t;
+
+typedef struct {
+    int    sock;
+    Uint32 deadline;
+    char   buf[512];
+    int    len, pos;
+    bool   got_data;     // Any byte received; a stale keep-alive shows up as EOF before this
+} http_reader_t;
+
+struct send_cmd_conn {
+    http_conn_t*  c;
+    http_conn_t   oneshot;   // Backing store when the pool is full
+    http_reader_t rd;        // Persists across responses, which may arrive in one read
+    bool          alive;     // Unit has not asked to close
+};
+
+static http_conn_t pool[SEND_CMD_POOL_SIZE];
+static SDL_SpinLock pool_lock = 0;
+
+// Milliseconds left until deadline, 0 once it has passed
+static unsigned int time_left(Uint32 deadline) {
+    Uint32 now = SDL_GetTicks();
+    return SDL_TICKS_PASSED(now, deadline) ? 0 : (unsigned int)(deadline - now);
+}
+
+// Wait until sock is writable or the deadline passes
+static bool wait_writable(int sock, Uint32 deadline) {
+    unsigned int left = time_left(deadline);
+    if (left == 0) return false;
+    struct timeval tv = { (long)(left / 1000), (long)(left % 1000) * 1000 };
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(sock, &wfds);
+    return select(sock + 1, NULL, &wfds, NULL, &tv) > 0;
+}
+
+static bool wait_readable(int sock, Uint32 deadline) {
+    unsigned int left = time_left(deadline);
+    if (left == 0) return false;
+    struct timeval tv = { (long)(left / 1000), (long)(left % 1000) * 1000 };
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(sock, &rfds);
+    return select(sock + 1, &rfds, NULL, NULL, &tv) > 0;
+}
+
+static bool connect_deadline(int sock, const struct sockaddr_in* addr, Uint32 deadline) {
+    int nonblock = 1;
+    ioctlsocket(sock, FIONBIO, &nonblock);
+
+    if (connect(sock, (const struct sockaddr*)addr, sizeof(*addr)) == 0)
+        return true;
+    if (errno != EINPROGRESS && errno != EWOULDBLOCK)
+        return false;
+    if (!wait_writable(sock, deadline))
+        return false;
+
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0)
+        return false;
+    return err == 0;
+}
+
+static bool send_all(int sock, const char* buf, int len, Uint32 deadline) {
+    int off = 0;
+    while (off < len) {
+        int n = send(sock, buf + off, len - off, 0);
+        if (n > 0) {
+            off += n;
+            continue;
+        }
+        if (n < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+            if (!wait_writable(sock, deadline)) return false;
+            continue;
+        }
         return false;
     }
+    return true;
+}
 
-    char request[512];
-    if (param && param[0] != '\0') {
-        snprintf(request, sizeof(request),
-            "GET /cmd?c=%s&%s HTTP/1.0\r\n"
-            "Host: %s\r\n"
-            "\r\n",
-            cmd_code, param, ip);
-    } else {
-        snprintf(request, sizeof(request),
-            "GET /cmd?c=%s HTTP/1.0\r\n"
-            "Host: %s\r\n"
-            "\r\n",
-            cmd_code, ip);
+static void conn_close(http_conn_t* c) {
+    if (c->open) closesocket(c->sock);
+    c->open = false;
+}
+
+// Close slots idle past SEND_CMD_IDLE_MS; pool_lock must be held
+static void evict_idle_locked(Uint32 now) {
+    for (int i = 0; i < SEND_CMD_POOL_SIZE; ++i) {
+        http_conn_t* c = &pool[i];
+        if (c->open && !c->busy && now - c->last_used > SEND_CMD_IDLE_MS)
+            conn_close(c);
     }
+}
 
+// Takes the idle keep-alive connection to addr, else a slot to open one in.
+// Falls back to the caller's one-shot slot when every entry is busy.
+static http_conn_t* pool_acquire(uint32_t addr, http_conn_t* oneshot) {
+    http_conn_t* pick = NULL;
+    SDL_AtomicLock(&pool_lock);
+    evict_idle_locked(SDL_GetTicks());
+    for (int i = 0; i < SEND_CMD_POOL_SIZE && !pick; ++i) {
+        if (pool[i].open && !pool[i].busy && pool[i].addr == addr)
+            pick = &pool[i];
+    }
+    for (int i = 0; i < SEND_CMD_POOL_SIZE && !pick; ++i) {
+        if (!pool[i].open && !pool[i].busy)
+            pick = &pool[i];
+    }
+    // Recycle the least recently used idle connection to another unit
+    if (!pick) {
+        for (int i = 0; i < SEND_CMD_POOL_SIZE; ++i) {
+            if (!pool[i].busy && (!pick || pool[i].last_used < pick->last_used))
+                pick = &pool[i];
+        }
+    }
+    if (pick) {
+        if (pick->addr != addr) conn_close(pick);
+        pick->addr = addr;
+        pick->busy = true;
+        pick->pooled = true;
+    }
+    SDL_AtomicUnlock(&pool_lock);
+
+    if (!pick) {
+        memset(oneshot, 0, sizeof(*oneshot));
+        oneshot->addr = addr;
+        oneshot->busy = true;
+        pick = oneshot;
+    }
+    return pick;
+}
+
+static void pool_release(http_conn_t* c, bool keep) {
+    if (!c->pooled) {
+        conn_close(c);
+        return;
+    }
+    SDL_AtomicLock(&pool_lock);
+    if (!keep) conn_close(c);
+    c->last_used = SDL_GetTicks();
+    c->busy = false;
+    SDL_AtomicUnlock(&pool_lock);
+}
+
+static bool conn_open(http_conn_t* c, Uint32 deadline) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
         debugPrint("[send_cmd] Socket creation failed\n");
@@ -38,20 +176,383 @@ bool send_cmd(const char* ip, const char* cmd_code, const char* param) {
     struct sockaddr_in addr = {0};
     addr.sin_family = AF_INET;
     addr.sin_port = htons(TYPE_D_CMD_PORT);
-    addr.sin_addr.s_addr = inet_addr(ip);
+    addr.sin_addr.s_addr = c->addr;
 
-    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    uint64_t t0 = telemetry_now_us();
+    if (!connect_deadline(sock, &addr, deadline)) {
         debugPrint("[send_cmd] Connect failed\n");
         closesocket(sock);
         return false;
     }
+    telemetry_record(ntohl(c->addr), TELEM_CONNECT, (uint32_t)(telemetry_now_us() - t0));
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    c->sock = sock;
+    c->open = true;
+    return true;
+}
+
+// 1 = more data buffered, 0 = EOF, -1 = error or deadline
+static int reader_fill(http_reader_t* r) {
+    while (1) {
+        int n = recv(r->sock, r->buf, sizeof(r->buf), 0);
+        if (n > 0) {
+            r->len = n;
+            r->pos = 0;
+            r->got_data = true;
+            return 1;
+        }
+        if (n == 0) return 0;
+        if (errno != EWOULDBLOCK && errno != EAGAIN) return -1;
+        if (!wait_readable(r->sock, r->deadline)) return -1;
+    }
+}
+
+// Reads one CRLF-terminated line without the terminator; -1 on failure
+static int read_line(http_reader_t* r, char* out, int max) {
+    int n = 0;
+    while (1) {
+        if (r->pos == r->len && reader_fill(r) <= 0) return -1;
+        char ch = r->buf[r->pos++];
+        if (ch == '\n') break;
+        if (ch != '\r' && n < max - 1) out[n++] = ch;
+    }
+    out[n] = 0;
+    return n;
+}
 
-    int sent = send(sock, request, strlen(request), 0);
-    closesocket(sock);
+// Consumes n body bytes, appending what fits to out->body when out is set
+static bool skip_bytes(http_reader_t* r, long n, send_cmd_response_t* out) {
+    while (n > 0) {
+        if (r->pos == r->len && reader_fill(r) <= 0) return false;
+        int take = r->len - r->pos;
+        if (take > n) take = (int)n;
+        if (out) {
+            int room = (int)sizeof(out->body) - 1 - out->body_len;
+            int keep = take < room ? take : room;
+            memcpy(out->body + out->body_len, r->buf + r->pos, keep);
+            out->body_len += keep;
+            out->body[out->body_len] = 0;
+        }
+        r->pos += take;
+        n -= take;
+    }
+    return true;
+}
 
-    bool success = (sent == (int)strlen(request));
-    if (!success) {
-        debugPrint("[send_cmd] Send failed\n");
+// Case-insensitive prefix match (header names and tokens)
+static bool prefix_ieq(const char* s, const char* prefix) {
+    for (; *prefix; ++s, ++prefix) {
+        char a = *s, b = *prefix;
+        if (a >= 'A' && a <= 'Z') a += 'a' - 'A';
+        if (b >= 'A' && b <= 'Z') b += 'a' - 'A';
+        if (a != b) return false;
     }
-    return success;
+    return true;
+}
+
+static bool header_is(const char* line, const char* name) {
+    return prefix_ieq(line, name) && line[strlen(name)] == ':';
+}
+
+static const char* header_value(const char* line) {
+    const char* v = strchr(line, ':');
+    if (!v) return "";
+    v++;
+    while (*v == ' ' || *v == '\t') v++;
+    return v;
+}
+
+// Parses one response and consumes its body so the next one can follow. The
+// ETag and the start of the body are kept in out when it is set.
+static bool read_response(http_reader_t* r, int* status, bool* keep_alive, send_cmd_response_t* out) {
+    char line[HTTP_LINE_MAX];
+    *status = 0;
+    if (read_line(r, line, sizeof(line)) < 0) return false;
+
+    int major = 0, minor = 0;
+    if (sscanf(line, "HTTP/%d.%d %d", &major, &minor, status) != 3) {
+        debugPrint("[send_cmd] Bad status line\n");
+        return false;
+    }
+    *keep_alive = (major == 1 && minor >= 1);
+
+    long content_length = -1;
+    bool chunked = false;
+    while (1) {
+        int n = read_line(r, line, sizeof(line));
+        if (n < 0) return false;
+        if (n == 0) break;
+        if (header_is(line, "Content-Length")) {
+            content_length = strtol(header_value(line), NULL, 10);
+        } else if (header_is(line, "Transfer-Encoding")) {
+            chunked = prefix_ieq(header_value(line), "chunked");
+        } else if (out && header_is(line, "ETag")) {
+            snprintf(out->etag, sizeof(out->etag), "%s", header_value(line));
+        } else if (header_is(line, "Connection")) {
+            const char* v = header_value(line);
+            if (prefix_ieq(v, "close")) *keep_alive = false;
+            else if (prefix_ieq(v, "keep-alive")) *keep_alive = true;
+        }
+    }
+
+    if (chunked) {
+        while (1) {
+            if (read_line(r, line, sizeof(line)) < 0) return false;
+            long size = strtol(line, NULL, 16);
+            if (size <= 0) break;
+            if (!skip_bytes(r, size, out) || !skip_bytes(r, 2, NULL)) return false;
+        }
+        // Trailers up to the blank line
+        int n;
+        while ((n = read_line(r, line, sizeof(line))) > 0) {}
+        return n == 0;
+    }
+    // No body whatever the headers say (RFC 9112 section 6.3)
+    if (*status == 204 || *status == 304 || (*status >= 100 && *status < 200))
+        return true;
+    if (content_length >= 0)
+        return skip_bytes(r, content_length, out);
+
+    // No framing: the body runs to EOF and the connection cannot be reused.
+    // Some firmware keeps the socket open instead, so the body also ends once
+    // the unit goes quiet; the status line has already come in either way.
+    *keep_alive = false;
+    Uint32 deadline = r->deadline;
+    skip_bytes(r, r->len - r->pos, out);
+    while (1) {
+        Uint32 idle = SDL_GetTicks() + HTTP_BODY_IDLE_MS;
+        r->deadline = SDL_TICKS_PASSED(idle, deadline) ? deadline : idle;
+        if (reader_fill(r) <= 0) break;
+        skip_bytes(r, r->len - r->pos, out);
+    }
+    r->deadline = deadline;
+    return true;
+}
+
+static int build_request(char* out, int size, const char* ip, const char* cmd_code, const char* param) {
+    int n;
+    // param can be "val=50" or "file=foo" or NULL
+    if (param && param[0] != '\0') {
+        n = snprintf(out, size,
+            "GET /cmd?c=%s&%s HTTP/1.1\r\n"
+            "Host: %s\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n",
+            cmd_code, param, ip);
+    } else {
+        n = snprintf(out, size,
+            "GET /cmd?c=%s HTTP/1.1\r\n"
+            "Host: %s\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n",
+            cmd_code, ip);
+    }
+    return (n > 0 && n < size) ? n : -1;
+}
+
+void ascii_to_hex(const char* ascii, char* hexbuf, int hexbufsize) {
+    static const char digits[] = "0123456789ABCDEF";
+    if (!hexbuf || hexbufsize <= 0) return;
+    int n = 0;
+    // Whole bytes only; a short buffer truncates rather than splitting one
+    for (const unsigned char* p = (const unsigned char*)ascii; p && *p && n + 2 < hexbufsize; ++p) {
+        hexbuf[n++] = digits[*p >> 4];
+        hexbuf[n++] = digits[*p & 0x0F];
+    }
+    hexbuf[n] = 0;
+}
+
+int send_cmd_pipeline(const char* ip, send_cmd_req_t* reqs, int count, unsigned int timeout_ms) {
+    if (!ip || !reqs || count <= 0 || count > SEND_CMD_PIPELINE_MAX) {
+        debugPrint("[send_cmd] Invalid IP or command\n");
+        return 0;
+    }
+    Uint32 deadline = SDL_GetTicks() + timeout_ms;
+
+    char request[HTTP_REQUEST_MAX * SEND_CMD_PIPELINE_MAX];
+    int request_len = 0;
+    for (int i = 0; i < count; ++i) {
+        reqs[i].ok = false;
+        reqs[i].status = 0;
+        reqs[i].sent_us = reqs[i].acked_us = 0;
+        if (!reqs[i].cmd_hex) {
+            debugPrint("[send_cmd] Invalid IP or command\n");
+            return 0;
+        }
+        int n = build_request(request + request_len, HTTP_REQUEST_MAX, ip, reqs[i].cmd_hex, reqs[i].hex_arg);
+        if (n < 0) {
+            debugPrint("[send_cmd] Request too long\n");
+            return 0;
+        }
+        request_len += n;
+    }
+
+    uint32_t addr = inet_addr(ip);
+    int done = 0;
+    // A reused connection may have been closed by the unit while idle; retry
+    // once on a fresh one, but only if nothing at all came back on it
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        http_conn_t oneshot;
+        http_conn_t* c = pool_acquire(addr, &oneshot);
+        bool reused = c->open;
+        if (!reused && !conn_open(c, deadline)) {
+            pool_release(c, false);
+            break;
+        }
+
+        uint64_t sent_us = telemetry_now_us();
+        if (!send_all(c->sock, request, request_len, deadline)) {
+            pool_release(c, false);
+            if (reused) continue;
+            debugPrint("[send_cmd] Send failed\n");
+            break;
+        }
+
+        uint64_t wire_us = telemetry_now_us();
+        for (int i = 0; i < count; ++i) reqs[i].sent_us = wire_us;
+
+        http_reader_t rd = { .sock = c->sock, .deadline = deadline };
+        bool keep = true;
+        for (done = 0; done < count; ++done) {
+            bool alive = false;
+            if (!read_response(&rd, &reqs[done].status, &alive, NULL)) {
+                keep = false;
+                break;
+            }
+            reqs[done].ok = reqs[done].status >= 200 && reqs[done].status < 300;
+            reqs[done].acked_us = telemetry_now_us();
+            telemetry_record(ntohl(addr), TELEM_HTTP_RTT, (uint32_t)(reqs[done].acked_us - sent_us));
+            keep = keep && alive;
+            // Server is closing: later pipelined requests were never read
+            if (!alive) {
+                done++;
+                break;
+            }
+        }
+        pool_release(c, keep);
+
+        if (done == 0 && reused && !rd.got_data) continue;
+        break;
+    }
+
+    // Connect and send failures land here too, so they count as lost commands
+    int ok = 0;
+    for (int i = 0; i < count; ++i) {
+        if (reqs[i].ok) ok++;
+        telemetry_command(ntohl(addr), reqs[i].ok);
+    }
+    if (ok < count)
+        debugPrint("[send_cmd] %d of %d commands failed\n", count - ok, count);
+    return ok;
+}
+
+bool send_cmd_timeout(const char* ip, const char* cmd_code, const char* param, unsigned int timeout_ms) {
+    send_cmd_req_t req = { cmd_code, param, false, 0, 0, 0 };
+    return send_cmd_pipeline(ip, &req, 1, timeout_ms) == 1;
+}
+
+bool send_cmd(const char* ip, const char* cmd_code, const char* param) {
+    return send_cmd_timeout(ip, cmd_code, param, SEND_CMD_TIMEOUT_MS);
+}
+
+bool send_cmd_get(const char* ip, const char* path, const char* if_none_match,
+                  send_cmd_response_t* out, unsigned int timeout_ms) {
+    memset(out, 0, sizeof(*out));
+    if (!ip || !path) return false;
+    Uint32 deadline = SDL_GetTicks() + timeout_ms;
+
+    char request[HTTP_REQUEST_MAX];
+    int n = snprintf(request, sizeof(request),
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "%s%s%s"
+        "Connection: keep-alive\r\n"
+        "\r\n",
+        path, ip,
+        if_none_match ? "If-None-Match: " : "", if_none_match ? if_none_match : "",
+        if_none_match ? "\r\n" : "");
+    if (n <= 0 || n >= (int)sizeof(request)) {
+        debugPrint("[send_cmd] Request too long\n");
+        return false;
+    }
+
+    uint32_t addr = inet_addr(ip);
+    // Same stale keep-alive retry as send_cmd_pipeline()
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        http_conn_t oneshot;
+        http_conn_t* c = pool_acquire(addr, &oneshot);
+        bool reused = c->open;
+        if (!reused && !conn_open(c, deadline)) {
+            pool_release(c, false);
+            return false;
+        }
+        uint64_t sent_us = telemetry_now_us();
+        if (!send_all(c->sock, request, n, deadline)) {
+            pool_release(c, false);
+            if (reused) continue;
+            return false;
+        }
+        http_reader_t rd = { .sock = c->sock, .deadline = deadline };
+        bool alive = false;
+        bool got = read_response(&rd, &out->status, &alive, out);
+        pool_release(c, got && alive);
+        if (got) {
+            telemetry_record(ntohl(addr), TELEM_HTTP_RTT, (uint32_t)(telemetry_now_us() - sent_us));
+            return true;
+        }
+        if (!(reused && !rd.got_data)) break;
+        memset(out, 0, sizeof(*out));
+    }
+    return false;
+}
+
+void send_cmd_pool_evict_idle(void) {
+    SDL_AtomicLock(&pool_lock);
+    evict_idle_locked(SDL_GetTicks());
+    SDL_AtomicUnlock(&pool_lock);
+}
+
+void send_cmd_pool_flush(void) {
+    SDL_AtomicLock(&pool_lock);
+    for (int i = 0; i < SEND_CMD_POOL_SIZE; ++i) {
+        if (!pool[i].busy) conn_close(&pool[i]);
+    }
+    SDL_AtomicUnlock(&pool_lock);
+}
+
+send_cmd_conn_t* send_cmd_conn_acquire(uint32_t ip, unsigned int timeout_ms) {
+    send_cmd_conn_t* sc = (send_cmd_conn_t*)mem_calloc(MEM_NET, 1, sizeof(*sc));
+    if (!sc) return NULL;
+    sc->c = pool_acquire(htonl(ip), &sc->oneshot);
+    if (!sc->c->open && !conn_open(sc->c, SDL_GetTicks() + timeout_ms)) {
+        pool_release(sc->c, false);
+        mem_free(sc);
+        return NULL;
+    }
+    sc->rd.sock = sc->c->sock;
+    sc->alive = true;
+    return sc;
+}
+
+bool send_cmd_conn_send(send_cmd_conn_t* sc, const void* buf, int len, unsigned int timeout_ms) {
+    return send_all(sc->c->sock, (const char*)buf, len, SDL_GetTicks() + timeout_ms);
+}
+
+int send_cmd_conn_response(send_cmd_conn_t* sc, unsigned int timeout_ms) {
+    int status = 0;
+    bool alive = false;
+    sc->rd.deadline = SDL_GetTicks() + timeout_ms;
+    if (!read_response(&sc->rd, &status, &alive, NULL)) {
+        sc->alive = false;
+        return -1;
+    }
+    sc->alive = sc->alive && alive;
+    return status;
+}
+
+void send_cmd_conn_release(send_cmd_conn_t* sc, bool keep) {
+    if (!sc) return;
+    pool_release(sc->c, keep && sc->alive);
+    mem_free(sc);
 }
@@ -1,5 +1,34 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
+
+#define SEND_CMD_TIMEOUT_MS   1500   // Default connect + send + response budget
+#define SEND_CMD_POOL_SIZE    8      // Keep-alive connections, one per unit
+#define SEND_CMD_IDLE_MS      5000   // Idle keep-alive connections are closed after this
+#define SEND_CMD_PIPELINE_MAX 4      // Requests written back to back on one connection
+#define SEND_CMD_BODY_MAX     256    // Response body kept by send_cmd_get()
+#define SEND_CMD_ETAG_MAX     32
+
+// Pooled keep-alive connection lent to a caller that writes its own requests
+typedef struct send_cmd_conn send_cmd_conn_t;
+
+// One request of a pipelined batch
+typedef struct {
+    const char* cmd_hex;   // Command hex string, e.g. "0001"
+    const char* hex_arg;   // Optional argument, or NULL
+    bool        ok;        // Set on return: 2xx response received
+    int         status;    // Set on return: HTTP status, 0 if none was read
+    uint64_t    sent_us;   // Set on return: telemetry_now_us() once written to the socket, else 0
+    uint64_t    acked_us;  // Set on return: telemetry_now_us() once its response was parsed, else 0
+} send_cmd_req_t;
+
+// Response to send_cmd_get()
+typedef struct {
+    int  status;                      // HTTP status, 0 if none was read
+    char etag[SEND_CMD_ETAG_MAX];     // ETag header as sent, quotes included; "" if absent
+    char body[SEND_CMD_BODY_MAX];     // NUL-terminated; a longer body is cut short
+    int  body_len;
+} send_cmd_response_t;
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,14 +41,90 @@ void ascii_to_hex(const char* ascii, char* hexbuf, int hexbufsize);
 
 /**
  * Sends an HTTP GET command to a Type D device at the given IP address and port 8080.
+ * Reuses a pooled HTTP/1.1 keep-alive connection to the unit when one is open.
  *
  * @param ip      Target IPv4 address as string, e.g. "192.168.1.120"
  * @param cmd_hex Command hex string, e.g. "0001"
  * @param hex_arg Optional argument hex string, or NULL/empty
- * @return        true on success, false on failure
+ * @return        true if the unit answered with a 2xx status
  */
 bool send_cmd(const char* ip, const char* cmd_hex, const char* hex_arg);
 
+/**
+ * Same as send_cmd(), but gives up once timeout_ms has elapsed instead of
+ * waiting on lwIP's connect timeout. The connect itself is non-blocking.
+ *
+ * @param timeout_ms Total budget for connect and send, in milliseconds
+ */
+bool send_cmd_timeout(const char* ip, const char* cmd_hex, const char* hex_arg, unsigned int timeout_ms);
+
+/**
+ * Writes up to SEND_CMD_PIPELINE_MAX requests back to back on one pooled
+ * connection, then reads the responses in order.
+ *
+ * @param ip         Target IPv4 address as string
+ * @param reqs       Requests; ok/status are filled in
+ * @param count      Number of requests (at most SEND_CMD_PIPELINE_MAX)
+ * @param timeout_ms Budget for the whole batch
+ * @return           Number of requests that succeeded
+ */
+int send_cmd_pipeline(const char* ip, send_cmd_req_t* reqs, int count, unsigned int timeout_ms);
+
+/**
+ * Fetches a resource from a unit over the pooled keep-alive connection and
+ * keeps the start of the body. With if_none_match set the unit can answer
+ * 304 and skip the body when nothing changed.
+ *
+ * @param ip            Target IPv4 address as string
+ * @param path          Request path, e.g. "/status"
+ * @param if_none_match ETag from an earlier response, or NULL
+ * @param out           Filled in; status is 0 if nothing came back
+ * @return              true if a response was read, whatever its status
+ */
+bool send_cmd_get(const char* ip, const char* path, const char* if_none_match,
+                  send_cmd_response_t* out, unsigned int timeout_ms);
+
+/**
+ * Borrows the keep-alive connection to a unit, opening one if needed, for
+ * requests that do not fit send_cmd_pipeline() (request bodies, long
+ * streams). Uses a one-shot connection when every pool slot is busy.
+ *
+ * @param ip         Target IPv4 address (host order, as in type_d_unit_t)
+ * @param timeout_ms Connect budget
+ * @return           NULL if the unit could not be reached
+ */
+send_cmd_conn_t* send_cmd_conn_acquire(uint32_t ip, unsigned int timeout_ms);
+
+/**
+ * Writes raw request bytes.
+ *
+ * @return false on error or timeout; release the connection with keep = false
+ */
+bool send_cmd_conn_send(send_cmd_conn_t* c, const void* buf, int len, unsigned int timeout_ms);
+
+/**
+ * Reads the next response, in request order, and discards its body.
+ *
+ * @return HTTP status, or -1 on error or timeout
+ */
+int send_cmd_conn_response(send_cmd_conn_t* c, unsigned int timeout_ms);
+
+/**
+ * Returns the connection to the pool. It is closed instead if keep is false
+ * or the unit asked to close it.
+ */
+void send_cmd_conn_release(send_cmd_conn_t* c, bool keep);
+
+/**
+ * Closes pooled connections that have been idle longer than SEND_CMD_IDLE_MS.
+ */
+void send_cmd_pool_evict_idle(void);
+
+/**
+ * Closes every pooled connection.
+ */
+void send_cmd_pool_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
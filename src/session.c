@@ -0,0 +1,242 @@
+#include "session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <hal/debug.h>
+#include "memstat.h"
+
+#define SESSION_HEADER "# Type D session trace 1\n"
+
+struct session_reader {
+    FILE*          f;
+    char           line[SESSION_LINE_MAX];
+    bool           held;              // line was read ahead and belongs to the next record
+    type_d_unit_t* units;
+    int            unit_cap;
+};
+
+// Recording state, main thread only
+static char buf[SESSION_BUF_BYTES];
+static size_t used = 0;
+static int records = 0;
+static bool recording = false;
+static bool full = false;
+static uint32_t start_ms = 0;
+
+// Appends one line; a line that does not fit ends the recording
+static bool append(const char* fmt, ...) {
+    if (full) return false;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + used, sizeof(buf) - used, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(buf) - used) {
+        full = true;
+        debugPrint("[session] Trace full after %d records, recording stopped\n", records);
+        return false;
+    }
+    used += n;
+    return true;
+}
+
+// A record goes in whole or not at all
+static void commit(size_t mark, bool ok) {
+    if (ok)
+        records++;
+    else
+        used = mark;
+}
+
+void session_record_start(uint32_t now) {
+    static bool noted = false;
+    if (!noted) {
+        mem_note_fixed(MEM_UI, (int)sizeof(buf));
+        noted = true;
+    }
+    used = 0;
+    records = 0;
+    full = false;
+    start_ms = now;
+    recording = append(SESSION_HEADER);
+}
+
+void session_record_button(uint32_t now, uint8_t button) {
+    if (!recording) return;
+    size_t mark = used;
+    commit(mark, append("B %u %u\n", (unsigned)(now - start_ms), (unsigned)button));
+}
+
+void session_record_units(uint32_t now, const detect_snapshot_t* snap) {
+    if (!recording) return;
+    int n;
+    const type_d_unit_t* list = detect_snapshot_units(snap, &n);
+    size_t mark = used;
+    bool ok = append("U %u %d\n", (unsigned)(now - start_ms), n);
+    for (int i = 0; ok && i < n; ++i) {
+        const detect_reply_t* r = &list[i].info;
+        ok = append("u %08x %u %u %u %d %d %d %u\n", (unsigned)list[i].ip, (unsigned)list[i].id,
+                    (unsigned)r->version, (unsigned)r->caps, r->display, r->mode, r->image,
+                    (unsigned)r->firmware);
+    }
+    commit(mark, ok);
+}
+
+void session_record_result(uint32_t now, const cmd_result_t* res) {
+    if (!recording) return;
+    size_t mark = used;
+    bool ok = append("R %u %d %s %08x %d %d %u %u %u %d %d\n", (unsigned)(now - start_ms), res->tag,
+                     res->cmd[0] ? res->cmd : "-", (unsigned)res->ip, res->ok, res->timed_out,
+                     (unsigned)res->elapsed_ms, (unsigned)res->wire_us, (unsigned)res->ack_us,
+                     res->unit_count, res->ok_count);
+    for (int i = 0; ok && i < res->unit_count; ++i) {
+        const cmd_unit_result_t* u = &res->units[i];
+        ok = append("r %08x %d %d %u %u %u\n", (unsigned)u->ip, u->ok, u->timed_out,
+                    (unsigned)u->elapsed_ms, (unsigned)u->wire_us, (unsigned)u->ack_us);
+    }
+    commit(mark, ok);
+}
+
+int session_save(const char* path) {
+    if (!recording) return -1;
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        debugPrint("[session] Cannot open %s\n", path);
+        return -1;
+    }
+    bool ok = fwrite(buf, 1, used, f) == used;
+    ok = (fclose(f) == 0) && ok;
+    return ok ? records : -1;
+}
+
+session_reader_t* session_open(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return NULL;
+    session_reader_t* r = (session_reader_t*)mem_calloc(MEM_DETECT, 1, sizeof(session_reader_t));
+    if (!r || !fgets(r->line, sizeof(r->line), f) || strcmp(r->line, SESSION_HEADER) != 0) {
+        debugPrint("[session] %s is not a session trace\n", path);
+        mem_free(r);
+        fclose(f);
+        return NULL;
+    }
+    r->f = f;
+    return r;
+}
+
+static const char* next_line(session_reader_t* r) {
+    if (r->held) {
+        r->held = false;
+        return r->line;
+    }
+    return fgets(r->line, sizeof(r->line), r->f);
+}
+
+// Detail lines ("u", "r") of the record just read; a record line ends them
+static const char* detail_line(session_reader_t* r, char kind) {
+    const char* line = next_line(r);
+    if (line && line[0] != kind) {
+        r->held = true;
+        return NULL;
+    }
+    return line;
+}
+
+static bool read_units(session_reader_t* r, uint32_t ms, int count, session_event_t* out) {
+    if (count < 0 || count > DETECT_UNITS_LIMIT) return false;
+    if (count > r->unit_cap) {
+        type_d_unit_t* grown = (type_d_unit_t*)mem_realloc(MEM_DETECT, r->units, sizeof(type_d_unit_t) * count);
+        if (!grown) return false;
+        r->units = grown;
+        r->unit_cap = count;
+    }
+    int n = 0;
+    const char* line;
+    while (n < count && (line = detail_line(r, 'u'))) {
+        unsigned ip, id, version, caps, firmware;
+        int display, mode, image;
+        if (sscanf(line, "u %x %u %u %u %d %d %d %u", &ip, &id, &version, &caps, &display, &mode, &image,
+                   &firmware) != 8)
+            continue;
+        type_d_unit_t* u = &r->units[n++];
+        memset(u, 0, sizeof(*u));
+        u->ip = ip;
+        u->id = (uint8_t)id;
+        u->last_seen = ms;
+        u->info.id = (uint8_t)id;
+        u->info.version = (uint8_t)version;
+        u->info.caps = (uint8_t)caps;
+        u->info.display = (int8_t)display;
+        u->info.mode = (int8_t)mode;
+        u->info.image = (int16_t)image;
+        u->info.firmware = firmware;
+    }
+    out->unit_count = n;
+    out->units = r->units;
+    return true;
+}
+
+static bool read_result(session_reader_t* r, const char* line, session_event_t* out) {
+    cmd_result_t* res = &out->result;
+    memset(res, 0, sizeof(*res));
+    unsigned ms, ip, elapsed, wire, ack;
+    int ok, timed_out, unit_count, ok_count;
+    if (sscanf(line, "R %u %d %7s %x %d %d %u %u %u %d %d", &ms, &res->tag, res->cmd, &ip, &ok, &timed_out,
+               &elapsed, &wire, &ack, &unit_count, &ok_count) != 11)
+        return false;
+    if (strcmp(res->cmd, "-") == 0) res->cmd[0] = 0;
+    out->ms = ms;
+    res->ip = ip;
+    res->ok = ok;
+    res->timed_out = timed_out;
+    res->elapsed_ms = elapsed;
+    res->wire_us = wire;
+    res->ack_us = ack;
+    res->ok_count = ok_count;
+    if (unit_count > CMD_GROUP_MAX) unit_count = CMD_GROUP_MAX;
+    const char* unit_line;
+    while (res->unit_count < unit_count && (unit_line = detail_line(r, 'r'))) {
+        cmd_unit_result_t* u = &res->units[res->unit_count];
+        if (sscanf(unit_line, "r %x %d %d %u %u %u", &ip, &ok, &timed_out, &elapsed, &wire, &ack) != 6)
+            continue;
+        u->ip = ip;
+        u->ok = ok;
+        u->timed_out = timed_out;
+        u->elapsed_ms = elapsed;
+        u->wire_us = wire;
+        u->ack_us = ack;
+        res->unit_count++;
+    }
+    return true;
+}
+
+bool session_next(session_reader_t* r, session_event_t* out) {
+    const char* line;
+    while ((line = next_line(r))) {
+        unsigned ms, button;
+        int count;
+        if (line[0] == 'B' && sscanf(line, "B %u %u", &ms, &button) == 2) {
+            out->kind = SESSION_BUTTON;
+            out->ms = ms;
+            out->button = (uint8_t)button;
+            return true;
+        }
+        if (line[0] == 'U' && sscanf(line, "U %u %d", &ms, &count) == 2) {
+            out->kind = SESSION_UNITS;
+            out->ms = ms;
+            if (read_units(r, ms, count, out)) return true;
+            continue;
+        }
+        if (line[0] == 'R' && read_result(r, line, out)) {
+            out->kind = SESSION_RESULT;
+            return true;
+        }
+    }
+    return false;
+}
+
+void session_close(session_reader_t* r) {
+    if (!r) return;
+    fclose(r->f);
+    mem_free(r->units);
+    mem_free(r);
+}
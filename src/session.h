@@ -0,0 +1,82 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "detect.h"
+#include "cmd_queue.h"
+
+#define SESSION_PATH      "D:\\typed_session.trc"
+#define SESSION_BUF_BYTES (256 * 1024)   // Trace kept in memory; recording stops once it is full
+#define SESSION_LINE_MAX  160
+
+// A session trace is what the setup screen took in, enough to drive it
+// again on the host (src/host/replay.c): controller presses, the discovery
+// snapshots it switched to and the command outcomes it was handed. Text,
+// one record per line, times in milliseconds since recording started and
+// IPs as 8 hex digits in host order:
+//
+//   # Type D session trace 1
+//   B <ms> <button>
+//   U <ms> <count>
+//   u <ip> <id> <version> <caps> <display> <mode> <image> <firmware>      (count lines)
+//   R <ms> <tag> <cmd> <ip> <ok> <timed_out> <elapsed_ms> <wire_us> <ack_us> <unit_count> <ok_count>
+//   r <ip> <ok> <timed_out> <elapsed_ms> <wire_us> <ack_us>               (unit_count lines)
+//
+// Device state, telemetry, uploads and profile syncs are not recorded; a
+// replay shows them as they are on the machine running it.
+
+typedef enum {
+    SESSION_BUTTON = 0,               // button
+    SESSION_UNITS,                    // unit_count, units
+    SESSION_RESULT                    // result
+} session_kind_t;
+
+typedef struct {
+    session_kind_t kind;
+    uint32_t       ms;
+    uint8_t        button;            // SDL_GameControllerButton
+    int            unit_count;
+    type_d_unit_t* units;             // Owned by the reader, valid until the next session_next()
+    cmd_result_t   result;
+} session_event_t;
+
+typedef struct session_reader session_reader_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts a new trace; earlier records are dropped. The recording calls
+ * below do nothing before this. Main thread only, like all of them.
+ *
+ * @param now Clock the other calls are given, taken as time 0
+ */
+void session_record_start(uint32_t now);
+void session_record_button(uint32_t now, uint8_t button);
+void session_record_units(uint32_t now, const detect_snapshot_t* snap);
+void session_record_result(uint32_t now, const cmd_result_t* res);
+
+/**
+ * Writes the trace so far to path. Recording goes on.
+ *
+ * @return Records written, -1 if the file could not be written
+ */
+int session_save(const char* path);
+
+/**
+ * @return Reader over the trace at path, or NULL if it cannot be opened or
+ *         is not a session trace
+ */
+session_reader_t* session_open(const char* path);
+
+/**
+ * Reads the next record. Lines that do not parse are skipped.
+ *
+ * @return false at the end of the trace
+ */
+bool session_next(session_reader_t* r, session_event_t* out);
+void session_close(session_reader_t* r);
+
+#ifdef __cplusplus
+}
+#endif
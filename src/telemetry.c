@@ -0,0 +1,195 @@
+#include "telemetry.h"
+#include <string.h>
+#include <SDL.h>
+
+#define SUB_BUCKETS (1 << TELEMETRY_SUB_BITS)
+
+typedef struct {
+    uint32_t ip;                      // 0 = free slot
+    uint32_t last_active;             // Value of touch_clock at the latest sample, for recycling
+    uint32_t hist[TELEM_METRIC_COUNT][TELEMETRY_BUCKETS];
+    uint32_t count[TELEM_METRIC_COUNT];
+    uint32_t max_us[TELEM_METRIC_COUNT];
+    uint32_t first_seq;               // First probe this unit answered
+    uint32_t last_seq;                // Latest probe it answered
+    uint32_t replies;
+    uint32_t commands;
+    uint32_t command_failures;
+    uint32_t over_budget;
+} telemetry_unit_t;
+
+static telemetry_unit_t entries[TELEMETRY_UNITS];
+static SDL_SpinLock lock = 0;
+static SDL_atomic_t probe_seq;
+static uint32_t touch_clock = 0;      // Orders samples under lock; ticks tie too often
+
+uint64_t telemetry_now_us(void) {
+    static Uint64 freq = 0;
+    if (!freq) freq = SDL_GetPerformanceFrequency();
+    return (uint64_t)(SDL_GetPerformanceCounter() * 1000000.0 / (double)freq);
+}
+
+// Log-linear bucket: values below SUB_BUCKETS map 1:1, above that each power
+// of two is split into SUB_BUCKETS equal parts
+static int bucket_of(uint32_t us) {
+    if (us < SUB_BUCKETS) return (int)us;
+    int msb = 31 - __builtin_clz(us);
+    int idx = (msb - TELEMETRY_SUB_BITS + 1) * SUB_BUCKETS + (int)((us >> (msb - TELEMETRY_SUB_BITS)) & (SUB_BUCKETS - 1));
+    return idx < TELEMETRY_BUCKETS ? idx : TELEMETRY_BUCKETS - 1;
+}
+
+// Middle of a bucket's range, the value reported for it
+static uint32_t bucket_value(int idx) {
+    if (idx < SUB_BUCKETS) return (uint32_t)idx;
+    int msb = idx / SUB_BUCKETS + TELEMETRY_SUB_BITS - 1;
+    uint32_t width = 1u << (msb - TELEMETRY_SUB_BITS);
+    uint32_t low = (uint32_t)(SUB_BUCKETS + idx % SUB_BUCKETS) * width;
+    return low + width / 2;
+}
+
+// Finds or claims the entry for ip; lock must be held. Slots fill in order
+// and are only ever recycled in place, so a free slot ends the search.
+static telemetry_unit_t* entry_for(uint32_t ip) {
+    telemetry_unit_t* oldest = &entries[0];
+    for (int i = 0; i < TELEMETRY_UNITS; ++i) {
+        if (entries[i].ip == ip) return &entries[i];
+        if (entries[i].ip == 0) {
+            oldest = &entries[i];
+            break;
+        }
+        if ((int32_t)(entries[i].last_active - oldest->last_active) < 0)
+            oldest = &entries[i];
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->ip = ip;
+    return oldest;
+}
+
+static uint32_t percentile(const uint32_t* hist, uint32_t count, int pct) {
+    uint32_t target = (uint32_t)(((uint64_t)count * pct + 99) / 100);
+    uint32_t seen = 0;
+    for (int i = 0; i < TELEMETRY_BUCKETS; ++i) {
+        seen += hist[i];
+        if (seen >= target) return bucket_value(i);
+    }
+    return bucket_value(TELEMETRY_BUCKETS - 1);
+}
+
+void telemetry_record(uint32_t ip, telemetry_metric_t metric, uint32_t us) {
+    if (!ip || metric >= TELEM_METRIC_COUNT) return;
+    SDL_AtomicLock(&lock);
+    telemetry_unit_t* e = entry_for(ip);
+    e->last_active = ++touch_clock;
+    e->hist[metric][bucket_of(us)]++;
+    e->count[metric]++;
+    if (us > e->max_us[metric]) e->max_us[metric] = us;
+    if (metric == TELEM_INPUT_ACK && us > TELEMETRY_ACK_BUDGET_US) e->over_budget++;
+    SDL_AtomicUnlock(&lock);
+}
+
+uint32_t telemetry_probe_sent(void) {
+    return (uint32_t)SDL_AtomicAdd(&probe_seq, 1) + 1;
+}
+
+void telemetry_discovery_reply(uint32_t ip, uint32_t seq, uint32_t rtt_us) {
+    if (!ip) return;
+    SDL_AtomicLock(&lock);
+    telemetry_unit_t* e = entry_for(ip);
+    bool first = (e->replies == 0);
+    if (first) e->first_seq = seq;
+    if (first || e->last_seq != seq) {
+        e->last_seq = seq;
+        e->replies++;
+        e->last_active = ++touch_clock;
+        e->hist[TELEM_DISCOVERY_RTT][bucket_of(rtt_us)]++;
+        e->count[TELEM_DISCOVERY_RTT]++;
+        if (rtt_us > e->max_us[TELEM_DISCOVERY_RTT]) e->max_us[TELEM_DISCOVERY_RTT] = rtt_us;
+    }
+    SDL_AtomicUnlock(&lock);
+}
+
+void telemetry_command(uint32_t ip, bool ok) {
+    if (!ip) return;
+    SDL_AtomicLock(&lock);
+    telemetry_unit_t* e = entry_for(ip);
+    e->last_active = ++touch_clock;
+    e->commands++;
+    if (!ok) e->command_failures++;
+    SDL_AtomicUnlock(&lock);
+}
+
+// Percentiles and counters of one entry; probes and replies are left to the caller
+static void summarize(const telemetry_unit_t* u, telemetry_report_t* out) {
+    for (int m = 0; m < TELEM_METRIC_COUNT; ++m) {
+        telemetry_summary_t* s = &out->metric[m];
+        s->count = u->count[m];
+        s->max_us = u->max_us[m];
+        if (!s->count) continue;
+        // A bucket midpoint can overshoot the largest sample actually seen
+        s->p50_us = SDL_min(percentile(u->hist[m], s->count, 50), s->max_us);
+        s->p95_us = SDL_min(percentile(u->hist[m], s->count, 95), s->max_us);
+        s->p99_us = SDL_min(percentile(u->hist[m], s->count, 99), s->max_us);
+    }
+    out->commands = u->commands;
+    out->command_failures = u->command_failures;
+    out->over_budget = u->over_budget;
+}
+
+bool telemetry_get(uint32_t ip, telemetry_report_t* out) {
+    telemetry_unit_t copy;
+    bool found = false;
+    SDL_AtomicLock(&lock);
+    for (int i = 0; i < TELEMETRY_UNITS && !found; ++i) {
+        if (ip && entries[i].ip == ip) {
+            copy = entries[i];
+            found = true;
+        }
+    }
+    SDL_AtomicUnlock(&lock);
+    if (!found) return false;
+
+    memset(out, 0, sizeof(*out));
+    out->ip = ip;
+    summarize(&copy, out);
+
+    // The newest probe may still be in flight; only count it once answered
+    if (copy.replies) {
+        uint32_t seq = (uint32_t)SDL_AtomicGet(&probe_seq);
+        out->probes = seq - copy.first_seq + (copy.last_seq == seq ? 1 : 0);
+        if (out->probes < copy.replies) out->probes = copy.replies;
+    }
+    out->replies = copy.replies;
+    return true;
+}
+
+void telemetry_get_all(telemetry_report_t* out) {
+    telemetry_unit_t sum;
+    memset(&sum, 0, sizeof(sum));
+    SDL_AtomicLock(&lock);
+    for (int i = 0; i < TELEMETRY_UNITS && entries[i].ip; ++i) {
+        const telemetry_unit_t* e = &entries[i];
+        for (int m = 0; m < TELEM_METRIC_COUNT; ++m) {
+            for (int b = 0; b < TELEMETRY_BUCKETS; ++b) sum.hist[m][b] += e->hist[m][b];
+            sum.count[m] += e->count[m];
+            if (e->max_us[m] > sum.max_us[m]) sum.max_us[m] = e->max_us[m];
+        }
+        sum.commands += e->commands;
+        sum.command_failures += e->command_failures;
+        sum.over_budget += e->over_budget;
+    }
+    SDL_AtomicUnlock(&lock);
+
+    memset(out, 0, sizeof(*out));
+    summarize(&sum, out);
+}
+
+uint32_t telemetry_loss_permille(const telemetry_report_t* r) {
+    if (!r->probes) return 0;
+    return (r->probes - r->replies) * 1000 / r->probes;
+}
+
+void telemetry_clear(void) {
+    SDL_AtomicLock(&lock);
+    memset(entries, 0, sizeof(entries));
+    SDL_AtomicUnlock(&lock);
+}
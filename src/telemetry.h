@@ -0,0 +1,92 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TELEMETRY_UNITS        32     // Units tracked; the least recently active is recycled
+#define TELEMETRY_SUB_BITS     2      // 4 buckets per power of two, ~19% resolution
+#define TELEMETRY_BUCKETS      96     // 1 us up to ~33 s
+#define TELEMETRY_ACK_BUDGET_US 100000 // Button press to unit acknowledgement, the panel reaction budget
+
+typedef enum {
+    TELEM_DISCOVERY_RTT = 0,          // sendto(TYPE_D_DISCOVER?) to recvfrom of the reply
+    TELEM_CONNECT,                    // TCP connect to port 8080
+    TELEM_HTTP_RTT,                   // Request written to response parsed
+    TELEM_INPUT_WIRE,                 // Controller event to command written to the socket
+    TELEM_INPUT_ACK,                  // Controller event to the unit's response parsed
+    TELEM_METRIC_COUNT
+} telemetry_metric_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us, p95_us, p99_us;
+    uint32_t max_us;
+} telemetry_summary_t;
+
+typedef struct {
+    uint32_t ip;                      // Host order, as in type_d_unit_t
+    telemetry_summary_t metric[TELEM_METRIC_COUNT];
+    uint32_t probes;                  // Discovery probes sent since the unit first answered
+    uint32_t replies;                 // Of those, answered
+    uint32_t commands;
+    uint32_t command_failures;
+    uint32_t over_budget;             // TELEM_INPUT_ACK samples above TELEMETRY_ACK_BUDGET_US
+} telemetry_report_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Microsecond timestamp from the performance counter, for measuring intervals.
+ */
+uint64_t telemetry_now_us(void);
+
+/**
+ * Adds one sample to a unit's histogram. Safe from any thread; never allocates.
+ */
+void telemetry_record(uint32_t ip, telemetry_metric_t metric, uint32_t us);
+
+/**
+ * Counts a discovery broadcast.
+ *
+ * @return Sequence number to pass to telemetry_discovery_reply()
+ */
+uint32_t telemetry_probe_sent(void);
+
+/**
+ * Counts a reply to probe seq and records its round trip. Only the first
+ * reply to a probe counts.
+ */
+void telemetry_discovery_reply(uint32_t ip, uint32_t seq, uint32_t rtt_us);
+
+/**
+ * Counts one command outcome for packet-loss and failure rates.
+ */
+void telemetry_command(uint32_t ip, bool ok);
+
+/**
+ * Summarises a unit's histograms and counters.
+ *
+ * @return false if nothing has been recorded for ip
+ */
+bool telemetry_get(uint32_t ip, telemetry_report_t* out);
+
+/**
+ * Summarises every unit's histograms merged into one, for figures that do
+ * not depend on which unit answered. ip, probes and replies are left 0.
+ */
+void telemetry_get_all(telemetry_report_t* out);
+
+/**
+ * @return Discovery loss in permille (0-1000) for a report
+ */
+uint32_t telemetry_loss_permille(const telemetry_report_t* r);
+
+/**
+ * Forgets every unit.
+ */
+void telemetry_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,273 @@
+#include "text_cache.h"
+#include "profiler.h"
+#include "memstat.h"
+#include <string.h>
+#include <hal/debug.h>
+
+#define TEXT_CACHE_BUCKETS  64    // Power of two
+#define TEXT_CACHE_NONE     0xFFFF
+#define GLYPH_FIRST         32
+#define GLYPH_LAST          126
+#define GLYPH_COUNT         (GLYPH_LAST - GLYPH_FIRST + 1)
+
+typedef struct {
+    TTF_Font*    font;
+    char*        text;
+    SDL_Color    color;
+    uint32_t     hash;
+    uint32_t     last_used;
+    uint16_t     next;        // Bucket chain
+    SDL_Texture* tex;
+    int          w, h;
+} text_entry_t;
+
+typedef struct {
+    TTF_Font*    font;
+    SDL_Texture* tex;
+    SDL_Rect     cell[GLYPH_COUNT];   // Glyph position inside the atlas
+    int          advance[GLYPH_COUNT];
+} glyph_atlas_t;
+
+static SDL_Renderer* renderer = NULL;
+static text_entry_t entries[TEXT_CACHE_SLOTS];
+static uint16_t buckets[TEXT_CACHE_BUCKETS];
+static uint32_t use_clock = 0;
+static glyph_atlas_t atlases[TEXT_CACHE_FONTS];
+
+// FNV-1a over font pointer, color and text
+static uint32_t text_hash(TTF_Font* font, const char* text, SDL_Color c) {
+    uint32_t h = 2166136261u;
+    uintptr_t f = (uintptr_t)font;
+    for (size_t i = 0; i < sizeof(f); ++i) {
+        h = (h ^ (uint8_t)(f >> (i * 8))) * 16777619u;
+    }
+    h = (h ^ c.r) * 16777619u;
+    h = (h ^ c.g) * 16777619u;
+    h = (h ^ c.b) * 16777619u;
+    h = (h ^ c.a) * 16777619u;
+    for (const char* p = text; *p; ++p)
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    return h;
+}
+
+static void unlink_entry(int idx) {
+    uint16_t* link = &buckets[entries[idx].hash & (TEXT_CACHE_BUCKETS - 1)];
+    while (*link != TEXT_CACHE_NONE) {
+        if (*link == idx) {
+            *link = entries[idx].next;
+            return;
+        }
+        link = &entries[*link].next;
+    }
+}
+
+static void free_entry(int idx) {
+    text_entry_t* e = &entries[idx];
+    if (!e->tex) return;
+    unlink_entry(idx);
+    mem_texture_destroy(MEM_UI, e->tex);
+    mem_free(e->text);
+    memset(e, 0, sizeof(*e));
+    e->next = TEXT_CACHE_NONE;
+}
+
+// Free slot if any, otherwise the least recently used one
+static int claim_slot(void) {
+    int victim = 0;
+    for (int i = 0; i < TEXT_CACHE_SLOTS; ++i) {
+        if (!entries[i].tex)
+            return i;
+        if (entries[i].last_used < entries[victim].last_used)
+            victim = i;
+    }
+    free_entry(victim);
+    return victim;
+}
+
+void text_cache_init(SDL_Renderer* r) {
+    renderer = r;
+    memset(entries, 0, sizeof(entries));
+    memset(atlases, 0, sizeof(atlases));
+    for (int i = 0; i < TEXT_CACHE_SLOTS; ++i)
+        entries[i].next = TEXT_CACHE_NONE;
+    for (int i = 0; i < TEXT_CACHE_BUCKETS; ++i)
+        buckets[i] = TEXT_CACHE_NONE;
+    use_clock = 0;
+}
+
+void text_cache_shutdown(void) {
+    for (int i = 0; i < TEXT_CACHE_SLOTS; ++i)
+        free_entry(i);
+    for (int i = 0; i < TEXT_CACHE_FONTS; ++i)
+        mem_texture_destroy(MEM_UI, atlases[i].tex);
+    memset(atlases, 0, sizeof(atlases));
+    renderer = NULL;
+}
+
+static SDL_Texture* lookup(TTF_Font* font, const char* text, SDL_Color color, int* w, int* h) {
+    if (!renderer || !font || !text || !text[0]) return NULL;
+
+    uint32_t hash = text_hash(font, text, color);
+    uint16_t idx = buckets[hash & (TEXT_CACHE_BUCKETS - 1)];
+    while (idx != TEXT_CACHE_NONE) {
+        text_entry_t* e = &entries[idx];
+        if (e->hash == hash && e->font == font &&
+            e->color.r == color.r && e->color.g == color.g &&
+            e->color.b == color.b && e->color.a == color.a &&
+            strcmp(e->text, text) == 0) {
+            e->last_used = ++use_clock;
+            if (w) *w = e->w;
+            if (h) *h = e->h;
+            return e->tex;
+        }
+        idx = e->next;
+    }
+
+    // Miss: rasterize once and keep the texture
+    SDL_Surface* surf = mem_surface_note(MEM_UI, TTF_RenderText_Blended(font, text, color));
+    if (!surf) return NULL;
+    SDL_Texture* tex = mem_texture_from_surface(MEM_UI, renderer, surf);
+    int sw = surf->w, sh = surf->h;
+    mem_surface_free(MEM_UI, surf);
+    if (!tex) return NULL;
+
+    size_t len = strlen(text);
+    char* key = (char*)mem_alloc(MEM_UI, len + 1);
+    if (!key) {
+        mem_texture_destroy(MEM_UI, tex);
+        return NULL;
+    }
+    memcpy(key, text, len + 1);
+
+    int slot = claim_slot();
+    text_entry_t* e = &entries[slot];
+    e->font = font;
+    e->text = key;
+    e->color = color;
+    e->hash = hash;
+    e->last_used = ++use_clock;
+    e->tex = tex;
+    e->w = sw;
+    e->h = sh;
+    e->next = buckets[hash & (TEXT_CACHE_BUCKETS - 1)];
+    buckets[hash & (TEXT_CACHE_BUCKETS - 1)] = (uint16_t)slot;
+
+    if (w) *w = sw;
+    if (h) *h = sh;
+    return tex;
+}
+
+SDL_Texture* text_cache_get(TTF_Font* font, const char* text, SDL_Color color, int* w, int* h) {
+    uint64_t t0 = profiler_begin();
+    SDL_Texture* tex = lookup(font, text, color, w, h);
+    profiler_end(PROF_TEXT, t0);
+    return tex;
+}
+
+bool text_cache_draw(TTF_Font* font, const char* text, SDL_Color color, int x, int y, SDL_Rect* out) {
+    int w, h;
+    uint64_t t0 = profiler_begin();
+    SDL_Texture* tex = lookup(font, text, color, &w, &h);
+    if (tex) {
+        SDL_Rect rc = {x, y, w, h};
+        SDL_RenderCopy(renderer, tex, NULL, &rc);
+        if (out) *out = rc;
+    }
+    profiler_end(PROF_TEXT, t0);
+    return tex != NULL;
+}
+
+// Rasterize printable ASCII once, white, into a single-row atlas
+static glyph_atlas_t* get_atlas(TTF_Font* font) {
+    glyph_atlas_t* free_slot = NULL;
+    for (int i = 0; i < TEXT_CACHE_FONTS; ++i) {
+        if (atlases[i].font == font) return &atlases[i];
+        if (!atlases[i].font && !free_slot) free_slot = &atlases[i];
+    }
+    if (!free_slot) {
+        debugPrint("[text_cache] No free glyph atlas slot\n");
+        return NULL;
+    }
+
+    SDL_Surface* glyphs[GLYPH_COUNT] = {0};
+    int atlas_w = 0, atlas_h = 0;
+    SDL_Color white = {255, 255, 255, 255};
+    for (int i = 0; i < GLYPH_COUNT; ++i) {
+        Uint16 ch = (Uint16)(GLYPH_FIRST + i);
+        int adv = 0;
+        TTF_GlyphMetrics(font, ch, NULL, NULL, NULL, NULL, &adv);
+        free_slot->advance[i] = adv;
+        if (ch == ' ') continue;
+        glyphs[i] = TTF_RenderGlyph_Blended(font, ch, white);
+        if (!glyphs[i]) continue;
+        atlas_w += glyphs[i]->w + 1;
+        if (glyphs[i]->h > atlas_h) atlas_h = glyphs[i]->h;
+    }
+
+    SDL_Surface* atlas = NULL;
+    if (atlas_w > 0 && atlas_h > 0)
+        atlas = mem_surface_note(MEM_UI, SDL_CreateRGBSurfaceWithFormat(0, atlas_w, atlas_h, 32, SDL_PIXELFORMAT_ARGB8888));
+    int pen = 0;
+    for (int i = 0; i < GLYPH_COUNT; ++i) {
+        if (!glyphs[i]) continue;
+        SDL_Rect dst = {pen, 0, glyphs[i]->w, glyphs[i]->h};
+        if (atlas) {
+            SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyphs[i], NULL, atlas, &dst);
+        }
+        free_slot->cell[i] = dst;
+        pen += glyphs[i]->w + 1;
+        SDL_FreeSurface(glyphs[i]);
+    }
+    // Claim the slot even on failure so a broken font is not retried every frame
+    free_slot->font = font;
+    if (!atlas) return free_slot;
+
+    free_slot->tex = mem_texture_from_surface(MEM_UI, renderer, atlas);
+    mem_surface_free(MEM_UI, atlas);
+    if (free_slot->tex)
+        SDL_SetTextureBlendMode(free_slot->tex, SDL_BLENDMODE_BLEND);
+    return free_slot;
+}
+
+int text_cache_draw_glyphs(TTF_Font* font, const char* text, SDL_Color color, int x, int y) {
+    if (!renderer || !font || !text) return 0;
+    uint64_t t0 = profiler_begin();
+    glyph_atlas_t* a = get_atlas(font);
+    if (!a || !a->tex) {
+        profiler_end(PROF_TEXT, t0);
+        return 0;
+    }
+
+    SDL_SetTextureColorMod(a->tex, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(a->tex, color.a);
+    int pen = x;
+    Uint16 prev = 0;
+    for (const char* p = text; *p; ++p) {
+        Uint16 ch = (uint8_t)*p;
+        if (ch < GLYPH_FIRST || ch > GLYPH_LAST) continue;
+        if (prev) pen += TTF_GetFontKerningSizeGlyphs(font, prev, ch);
+        int gi = ch - GLYPH_FIRST;
+        if (a->cell[gi].w > 0) {
+            SDL_Rect dst = {pen, y, a->cell[gi].w, a->cell[gi].h};
+            SDL_RenderCopy(renderer, a->tex, &a->cell[gi], &dst);
+        }
+        pen += a->advance[gi];
+        prev = ch;
+    }
+    profiler_end(PROF_TEXT, t0);
+    return pen - x;
+}
+
+void text_cache_forget_font(TTF_Font* font) {
+    for (int i = 0; i < TEXT_CACHE_SLOTS; ++i) {
+        if (entries[i].tex && entries[i].font == font)
+            free_entry(i);
+    }
+    for (int i = 0; i < TEXT_CACHE_FONTS; ++i) {
+        if (atlases[i].font == font) {
+            mem_texture_destroy(MEM_UI, atlases[i].tex);
+            memset(&atlases[i], 0, sizeof(atlases[i]));
+        }
+    }
+}
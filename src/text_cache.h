@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#define TEXT_CACHE_SLOTS    128   // Cached string textures (LRU evicted)
+#define TEXT_CACHE_FONTS    4     // Fonts with a glyph atlas
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binds the cache to a renderer. Must be called before any other text_cache call.
+ */
+void text_cache_init(SDL_Renderer* r);
+
+/**
+ * Destroys every cached string texture and glyph atlas.
+ */
+void text_cache_shutdown(void);
+
+/**
+ * Returns a texture for text rendered with TTF_RenderText_Blended, rasterizing
+ * it only the first time a (font, text, color) key is seen. The texture is
+ * owned by the cache and stays valid until the next text_cache_* call.
+ *
+ * @param font  Font to render with
+ * @param text  String to render
+ * @param color Text color
+ * @param w     Receives texture width (may be NULL)
+ * @param h     Receives texture height (may be NULL)
+ * @return      Cached texture, or NULL on failure/empty text
+ */
+SDL_Texture* text_cache_get(TTF_Font* font, const char* text, SDL_Color color, int* w, int* h);
+
+/**
+ * Draws cached text with its top-left corner at (x, y).
+ *
+ * @param out Receives the destination rect (may be NULL)
+ * @return    true if something was drawn
+ */
+bool text_cache_draw(TTF_Font* font, const char* text, SDL_Color color, int x, int y, SDL_Rect* out);
+
+/**
+ * Draws text glyph by glyph from the font's atlas. Meant for strings that
+ * change often (counters, timings) where caching whole strings would thrash.
+ * Only printable ASCII is supported; other bytes are skipped.
+ *
+ * @return Width in pixels of the drawn text
+ */
+int text_cache_draw_glyphs(TTF_Font* font, const char* text, SDL_Color color, int x, int y);
+
+/**
+ * Drops every cached string and the glyph atlas for a font (call before TTF_CloseFont).
+ */
+void text_cache_forget_font(TTF_Font* font);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,763 @@
+#include "ui.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+#include "detect.h"
+#include "text_cache.h"
+#include "octagon.h"
+#include "damage.h"
+#include "devstate.h"
+#include "compose.h"
+
+int screen_width = SCREEN_WIDTH_DEF, screen_height = SCREEN_HEIGHT_DEF;
+
+const char* menu_items[MENU_ITEM_COUNT] = {
+    "Next Image",
+    "Previous Image",
+    "Random Image",
+    "Display Mode",
+    "",               // Removed Brightness label but keep space
+    "WiFi Restart",
+    "WiFi Forget",
+    "Display On",
+    "Display Off"
+};
+
+const char* menu_cmds[MENU_ITEM_COUNT] = {
+    "0001", "0002", "0003", "0004", NULL,
+    "0030", "0031", "0060", "0061"
+};
+
+#define ABOUT_DIM 180                  // Panel alpha over the background
+#define DIAG_DIM  200
+
+static const SDL_Color btnShadow   = {0,0,0,80};
+static const SDL_Color btnIdle     = {36,36,36,255};
+static const SDL_Color btnSelected = {0,220,0,255};
+static const SDL_Color btnBorder   = {80,255,100,255};
+
+static SDL_Renderer* renderer = NULL;
+static ui_assets_t assets;
+static SDL_Rect mrect[MENU_ITEM_COUNT];
+static SDL_Rect bar_rect;     // Device bar: caption, numbers, IP line
+static SDL_Rect exp_rect;     // "EXP FOUND" corner indicator
+static SDL_Rect status_rect;  // Command feedback, right half above the device numbers
+static ui_diag_row_t diag_rows[UI_DIAG_ROWS];
+static int diag_count = 0, diag_total = 0;
+static telemetry_report_t diag_all;   // Every unit merged
+static mem_report_t diag_mem;
+static audio_stats_t diag_audio;
+static SDL_Rect hud_rect;     // Profiler HUD, top left above everything else
+static SDL_Texture* chrome = NULL;   // Background, logo, title and exit prompt, flattened
+static SDL_Texture* about_layer = NULL;   // Panel of the About page: background, dimmed, and text
+static SDL_Texture* diag_layer = NULL;    // Panel of the diagnostics page: background, dimmed
+static profiler_summary_t profile;
+
+// Everything on the main page that never changes after startup
+static void draw_chrome(void) {
+    if (assets.td) {
+        SDL_Rect logoRect = {SCALEX(24), SCALEY(24), SCALEX(64), SCALEY(64)};
+        SDL_RenderCopy(renderer, assets.td, NULL, &logoRect);
+    }
+    if (assets.title) SDL_RenderCopy(renderer, assets.title, NULL, &assets.title_rect);
+    if (assets.exit_left) SDL_RenderCopy(renderer, assets.exit_left, NULL, &assets.exit_left_rect);
+    if (assets.exit_b) SDL_RenderCopy(renderer, assets.exit_b, NULL, &assets.exit_b_rect);
+    if (assets.exit_right) SDL_RenderCopy(renderer, assets.exit_right, NULL, &assets.exit_right_rect);
+}
+
+static void draw_background(void) {
+    // SDL_RenderClear ignores the clip rect, a fill respects it
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderFillRect(renderer, NULL);
+    if (assets.bg) SDL_RenderCopy(renderer, assets.bg, NULL, NULL);
+}
+
+// One opaque copy per frame instead of a scaled background plus five alpha
+// blits. Without render target support the pieces are drawn every frame.
+static void build_chrome(void) {
+    mem_texture_destroy(MEM_UI, chrome);
+    Uint32 format = assets.screen_format ? assets.screen_format : SDL_PIXELFORMAT_ARGB8888;
+    chrome = mem_texture_create(MEM_UI, renderer, format, SDL_TEXTUREACCESS_TARGET, screen_width, screen_height);
+    if (!chrome || SDL_SetRenderTarget(renderer, chrome) != 0) {
+        debugPrint("[ui] No chrome layer: %s\n", SDL_GetError());
+        mem_texture_destroy(MEM_UI, chrome);
+        chrome = NULL;
+        return;
+    }
+    draw_background();
+    draw_chrome();
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_SetTextureBlendMode(chrome, SDL_BLENDMODE_NONE);
+}
+
+// Panel shared by the About and diagnostics pages
+static SDL_Rect overlay_bounds(void) {
+    return (SDL_Rect){SCALEX(40), SCALEY(80), screen_width - SCALEX(80), screen_height - SCALEY(160)};
+}
+
+static const char* const about_lines[] = {
+    "Type D Setup",
+    "Code By: Darkone83",
+    "Music: Minus Eleven",
+    "By: La Castle Vania",
+    "Press Back to close"
+};
+#define ABOUT_LINE_COUNT ((int)SDL_arraysize(about_lines))
+
+// Space under an About line: wide after the title and credit, wider above
+// the close prompt
+static int about_gap(int i) {
+    if (i == 0 || i == 1) return SCALEY(20);
+    if (i == ABOUT_LINE_COUNT - 2) return SCALEY(30);
+    return SCALEY(10);
+}
+
+// Top of each About line, the block centred vertically in the panel
+static void about_layout(const SDL_Rect* panel, int* y) {
+    int heights[ABOUT_LINE_COUNT];
+    int total = 0;
+    for (int i = 0; i < ABOUT_LINE_COUNT; i++) {
+        int w;
+        TTF_SizeText(assets.title_font, about_lines[i], &w, &heights[i]);
+        total += heights[i] + about_gap(i);
+    }
+    int top = panel->y + (panel->h - total) / 2;
+    for (int i = 0; i < ABOUT_LINE_COUNT; i++) {
+        y[i] = top;
+        top += heights[i] + about_gap(i);
+    }
+}
+
+// About text straight onto the panel surface, which starts at panel's corner
+static void composite_about_text(SDL_Surface* s, const SDL_Rect* panel) {
+    if (!assets.title_font) return;
+    SDL_Color white = {255, 255, 255, 255};
+    int y[ABOUT_LINE_COUNT];
+    about_layout(panel, y);
+    for (int i = 0; i < ABOUT_LINE_COUNT; i++) {
+        SDL_Surface* line = TTF_RenderText_Blended(assets.title_font, about_lines[i], white);
+        if (line && line->format->format != SDL_PIXELFORMAT_ARGB8888) {
+            SDL_Surface* argb = SDL_ConvertSurfaceFormat(line, SDL_PIXELFORMAT_ARGB8888, 0);
+            SDL_FreeSurface(line);
+            line = argb;
+        }
+        if (!line) continue;
+        comp_premultiply(line);
+        comp_blit(line, s, (panel->w - line->w) / 2, y[i] - panel->y);
+        SDL_FreeSurface(line);
+    }
+}
+
+// Dims a copy of the background under the panel, optionally with the About
+// text on top, and makes an opaque texture of it
+static SDL_Texture* make_overlay_layer(SDL_Surface* base, Uint8 dim, bool about) {
+    SDL_Surface* s = mem_surface_note(MEM_UI, SDL_ConvertSurface(base, base->format, 0));
+    if (!s) return NULL;
+    SDL_Rect panel = overlay_bounds();
+    comp_fill(s, NULL, (SDL_Color){0, 0, 0, dim});
+    if (about) composite_about_text(s, &panel);
+    SDL_Texture* t = mem_texture_from_surface(MEM_UI, renderer, s);
+    mem_surface_free(MEM_UI, s);
+    if (t) SDL_SetTextureBlendMode(t, SDL_BLENDMODE_NONE);
+    return t;
+}
+
+static void free_overlay_layers(void) {
+    mem_texture_destroy(MEM_UI, about_layer);
+    mem_texture_destroy(MEM_UI, diag_layer);
+    about_layer = diag_layer = NULL;
+}
+
+// The overlay pages' panels are composited once here, so an overlay frame
+// copies one opaque layer instead of alpha-filling most of the screen. Needs
+// a screen format the compositor handles and render target support; without
+// them the panels are blended every frame.
+static void build_overlay_layers(void) {
+    free_overlay_layers();
+    Uint32 format = assets.screen_format ? assets.screen_format : SDL_PIXELFORMAT_ARGB8888;
+    SDL_Rect panel = overlay_bounds();
+    SDL_Surface* base = mem_surface_note(MEM_UI, SDL_CreateRGBSurfaceWithFormat(0, panel.w, panel.h, 32, format));
+    SDL_Texture* target = NULL;
+    bool ok = base && comp_supported(base);
+    if (ok) {
+        target = mem_texture_create(MEM_UI, renderer, format, SDL_TEXTUREACCESS_TARGET, screen_width, screen_height);
+        ok = target && SDL_SetRenderTarget(renderer, target) == 0;
+    }
+    if (ok) {
+        draw_background();
+        ok = SDL_RenderReadPixels(renderer, &panel, format, base->pixels, base->pitch) == 0;
+        SDL_SetRenderTarget(renderer, NULL);
+    }
+    if (ok) {
+        about_layer = make_overlay_layer(base, ABOUT_DIM, true);
+        diag_layer = make_overlay_layer(base, DIAG_DIM, false);
+    } else {
+        debugPrint("[ui] No overlay layers, panels are blended per frame\n");
+    }
+    mem_texture_destroy(MEM_UI, target);
+    mem_surface_free(MEM_UI, base);
+}
+
+void ui_init(SDL_Renderer* r, const ui_assets_t* a) {
+    renderer = r;
+    assets = *a;
+
+    // Prepare menu rectangles centered vertically
+    int cw = SCALEX(170), ch = SCALEY(56);
+    int total_menu_height = MENU_ROWS * ch + (MENU_ROWS - 1) * SCALEY(20);
+    int menu_start_y = (screen_height - total_menu_height) / 2;
+
+    int cx[MENU_COLS] = {
+        screen_width / 6,
+        screen_width / 2,
+        screen_width * 5 / 6
+    };
+
+    for (int i = 0; i < MENU_ITEM_COUNT; i++) {
+        int col = i % MENU_COLS;
+        int row = i / MENU_COLS;
+        int px = cx[col] - cw / 2;
+        int py = menu_start_y + row * (ch + SCALEY(20));
+        // Center last row if not full
+        if (row == MENU_ROWS - 1 && MENU_ITEM_COUNT % MENU_COLS != 0) {
+            int remain = MENU_ITEM_COUNT % MENU_COLS;
+            if (remain == 1)
+                px = cx[1] - cw / 2;
+            else if (remain == 2 && col == 0)
+                px = cx[0] - cw / 2;
+            else if (remain == 2 && col == 1)
+                px = cx[1] - cw / 2;
+        }
+        mrect[i] = (SDL_Rect){ px, py, cw, ch };
+    }
+
+    // Button sprites: shadow, idle body and selected body share one size
+    octagon_prepare(cw, ch, SCALEY(12), btnShadow, NULL);
+    octagon_prepare(cw, ch, SCALEY(12), btnIdle, &btnBorder);
+    octagon_prepare(cw, ch, SCALEY(12), btnSelected, &btnBorder);
+
+    // Device bar runs from its caption to the bottom of the screen
+    int bar_y = screen_height - SCALEY(70) - 2;
+    bar_rect = (SDL_Rect){0, bar_y, screen_width, screen_height - bar_y};
+
+    int status_h = assets.exit_font ? TTF_FontHeight(assets.exit_font) : SCALEY(20);
+    status_rect = (SDL_Rect){screen_width / 2 - 2, screen_height - SCALEY(70) - 2, screen_width / 2 + 2, status_h + 4};
+
+    int exp_w = SCALEX(160), exp_h = SCALEY(40);
+    if (assets.exit_font) {
+        TTF_SizeText(assets.exit_font, "EXP FOUND", &exp_w, &exp_h);
+        exp_h += SCALEY(16);
+    }
+    exp_rect = (SDL_Rect){screen_width - exp_w - SCALEY(16), 0, exp_w + SCALEY(16), exp_h};
+
+    // Frame line plus one per stage
+    int hud_lh = (assets.exit_font ? TTF_FontHeight(assets.exit_font) : SCALEY(14)) + 1;
+    hud_rect = (SDL_Rect){SCALEX(8), SCALEY(8), SCALEX(280), PROF_STAGE_COUNT * hud_lh + SCALEY(8)};
+
+    build_chrome();
+    build_overlay_layers();
+}
+
+void ui_shutdown(void) {
+    mem_texture_destroy(MEM_UI, chrome);
+    chrome = NULL;
+    free_overlay_layers();
+}
+
+// Button body, outline and drop shadow
+static SDL_Rect button_bounds(int i) {
+    int m = SCALEY(12);
+    SDL_Rect rc = mrect[i];
+    return (SDL_Rect){rc.x - m, rc.y - m, rc.w + 2 * m + SCALEX(8) + 1, rc.h + 2 * m + SCALEY(8) + 1};
+}
+
+static void render_about(void) {
+    SDL_Rect overlayRect = overlay_bounds();
+    if (about_layer) {
+        SDL_RenderCopy(renderer, about_layer, NULL, &overlayRect);
+        return;
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, ABOUT_DIM);
+    SDL_RenderFillRect(renderer, &overlayRect);
+
+    SDL_Color white = {255, 255, 255, 255};
+    int y[ABOUT_LINE_COUNT];
+    about_layout(&overlayRect, y);
+    for (int i = 0; i < ABOUT_LINE_COUNT; i++) {
+        int tw, th;
+        SDL_Texture* tex = text_cache_get(assets.title_font, about_lines[i], white, &tw, &th);
+        if (tex) {
+            SDL_Rect rect = {overlayRect.x + (overlayRect.w - tw) / 2, y[i], tw, th};
+            SDL_RenderCopy(renderer, tex, NULL, &rect);
+        }
+    }
+}
+
+// Milliseconds with one decimal below 10 ms, whole above
+static void format_ms(char* out, size_t size, uint32_t us) {
+    if (us < 10000)
+        snprintf(out, size, "%u.%u", us / 1000, (us % 1000) / 100);
+    else
+        snprintf(out, size, "%u", us / 1000);
+}
+
+// Bytes as 512, 12K or 1.5M
+static void format_bytes(char* out, size_t size, uint32_t bytes) {
+    if (bytes < 1024)
+        snprintf(out, size, "%u", bytes);
+    else if (bytes < (1u << 20))
+        snprintf(out, size, "%uK", (bytes + 512) >> 10);
+    else
+        snprintf(out, size, "%u.%uM", bytes >> 20, ((bytes & 0xFFFFF) * 10) >> 20);
+}
+
+static void format_percentiles(char* out, size_t size, const telemetry_summary_t* s) {
+    if (!s->count) {
+        snprintf(out, size, "-");
+        return;
+    }
+    char p50[12], p95[12], p99[12];
+    format_ms(p50, sizeof(p50), s->p50_us);
+    format_ms(p95, sizeof(p95), s->p95_us);
+    format_ms(p99, sizeof(p99), s->p99_us);
+    snprintf(out, size, "%s/%s/%s", p50, p95, p99);
+}
+
+static const char* diag_label(uint8_t id) {
+    static const char* labels[] = {"?", "1", "2", "3", "4", "XL", "EXP"};
+    return id < sizeof(labels)/sizeof(labels[0]) ? labels[id] : "?";
+}
+
+// Heap per subsystem, pixels, the frame arena and what the kernel has left.
+// Yellow once the arena spilled or malloc() can no longer find a large block.
+// Returns the y below the last line.
+static int render_memory(TTF_Font* font, int x, int y, int lh) {
+    const mem_report_t* m = &diag_mem;
+    char a[12], b[12], c[12], line[96];
+    SDL_Color grey = {170,170,170,255};
+    SDL_Color warn = {255,220,0,255};
+
+    format_bytes(a, sizeof(a), m->heap_bytes);
+    format_bytes(b, sizeof(b), m->heap_peak);
+    int at = snprintf(line, sizeof(line), "heap %s peak %s ", a, b);
+    uint32_t surf = 0, surf_peak = 0, tex = 0, tex_peak = 0, allocs = 0;
+    for (int i = 0; i < MEM_SUBSYS_COUNT; ++i) {
+        const mem_usage_t* u = &m->sub[i];
+        format_bytes(a, sizeof(a), u->heap_bytes + u->fixed_bytes);
+        if (at > 0 && at < (int)sizeof(line))
+            at += snprintf(line + at, sizeof(line) - at, " %s %s", mem_subsys_name((mem_subsys_t)i), a);
+        surf += u->surface_bytes;
+        surf_peak += u->surface_peak;
+        tex += u->texture_bytes;
+        tex_peak += u->texture_peak;
+        allocs += u->heap_allocs;
+    }
+    text_cache_draw_glyphs(font, line, grey, x, y);
+    y += lh;
+
+    format_bytes(a, sizeof(a), tex);
+    format_bytes(b, sizeof(b), tex_peak);
+    format_bytes(c, sizeof(c), surf);
+    at = snprintf(line, sizeof(line), "textures %s peak %s  surfaces %s", a, b, c);
+    format_bytes(a, sizeof(a), surf_peak);
+    if (at > 0 && at < (int)sizeof(line))
+        snprintf(line + at, sizeof(line) - at, " peak %s  allocs %u", a, allocs);
+    text_cache_draw_glyphs(font, line, grey, x, y);
+    y += lh;
+
+    format_bytes(a, sizeof(a), m->frame_peak);
+    format_bytes(b, sizeof(b), MEM_FRAME_ARENA_BYTES);
+    at = snprintf(line, sizeof(line), "frame %s of %s spills %u", a, b, m->frame_spills);
+    if (m->sys_total_bytes && at > 0 && at < (int)sizeof(line)) {
+        format_bytes(a, sizeof(a), m->sys_free_bytes);
+        format_bytes(b, sizeof(b), m->sys_total_bytes);
+        at += snprintf(line + at, sizeof(line) - at, "  free %s of %s", a, b);
+    }
+    bool fragmented = m->largest_block && m->largest_block < MEM_PROBE_MAX_BYTES;
+    if (m->largest_block && at > 0 && at < (int)sizeof(line)) {
+        format_bytes(a, sizeof(a), m->largest_block);
+        snprintf(line + at, sizeof(line) - at, "  block %s%s", a, fragmented ? "" : "+");
+    }
+    text_cache_draw_glyphs(font, line, (m->frame_spills || fragmented) ? warn : grey, x, y);
+    return y + lh;
+}
+
+// Music ring level now and at its lowest, and the underruns that went out as
+// silence. Yellow once there has been one.
+static int render_audio(TTF_Font* font, int x, int y, int lh) {
+    const audio_stats_t* s = &diag_audio;
+    char a[12], b[12], c[12], line[96];
+    SDL_Color grey = {170,170,170,255};
+    SDL_Color warn = {255,220,0,255};
+
+    if (!s->playing) {
+        text_cache_draw_glyphs(font, "music off", grey, x, y);
+        return y + lh;
+    }
+    format_bytes(a, sizeof(a), s->fill_bytes);
+    format_bytes(b, sizeof(b), s->capacity_bytes);
+    format_bytes(c, sizeof(c), s->min_fill_bytes);
+    int at = snprintf(line, sizeof(line), "music ring %s of %s low %s  underruns %u", a, b, c,
+                      (unsigned)s->underruns);
+    if (s->underruns && at > 0 && at < (int)sizeof(line)) {
+        format_bytes(a, sizeof(a), s->underrun_bytes);
+        snprintf(line + at, sizeof(line) - at, " (%s silent)", a);
+    }
+    text_cache_draw_glyphs(font, line, s->underruns ? warn : grey, x, y);
+    return y + lh;
+}
+
+// Two lines per unit; the numbers change every refresh, so everything but the
+// caption comes from the glyph atlas
+static void render_diagnostics(void) {
+    SDL_Rect overlayRect = overlay_bounds();
+    if (diag_layer) {
+        SDL_RenderCopy(renderer, diag_layer, NULL, &overlayRect);
+    } else {
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, DIAG_DIM);
+        SDL_RenderFillRect(renderer, &overlayRect);
+    }
+
+    TTF_Font* font = assets.exit_font;
+    if (!font) return;
+    int lh = TTF_FontHeight(font) + 2;
+    int x = overlayRect.x + SCALEX(12);
+    int y = overlayRect.y + SCALEY(10);
+    SDL_Color white = {255,255,255,255};
+    SDL_Color grey  = {170,170,170,255};
+
+    text_cache_draw(font, "Diagnostics   times in ms: p50/p95/p99", white, x, y, NULL);
+    y += lh;
+
+    // Button press to the command on the wire and to the unit's answer, all units
+    char wire[40], ack[40], line[96];
+    format_percentiles(wire, sizeof(wire), &diag_all.metric[TELEM_INPUT_WIRE]);
+    format_percentiles(ack, sizeof(ack), &diag_all.metric[TELEM_INPUT_ACK]);
+    snprintf(line, sizeof(line), "input>wire %s  input>ack %s  over %u ms: %u",
+             wire, ack, TELEMETRY_ACK_BUDGET_US / 1000, (unsigned)diag_all.over_budget);
+    text_cache_draw_glyphs(font, line, diag_all.over_budget ? (SDL_Color){255,220,0,255} : grey, x, y);
+    y += lh;
+    y = render_memory(font, x, y, lh);
+    y = render_audio(font, x, y, lh) + SCALEY(6);
+
+    if (diag_count == 0)
+        text_cache_draw(font, "No units heard from yet", grey, x, y, NULL);
+
+    for (int i = 0; i < diag_count; ++i) {
+        const telemetry_report_t* t = &diag_rows[i].t;
+        uint32_t loss = telemetry_loss_permille(t);
+        SDL_Color color = white;
+        if (loss >= 50 || t->command_failures)
+            color = (SDL_Color){255,60,60,255};
+        else if (loss > 0)
+            color = (SDL_Color){255,220,0,255};
+
+        int at = snprintf(line, sizeof(line), "%-3s %-15s  loss %u.%u%%  failed %u/%u",
+                          diag_label(diag_rows[i].id), detect_ipstr(t->ip), loss / 10, loss % 10,
+                          (unsigned)t->command_failures, (unsigned)t->commands);
+        uint32_t fw = diag_rows[i].firmware;
+        if (fw && at > 0 && at < (int)sizeof(line))
+            snprintf(line + at, sizeof(line) - at, "  fw %u.%u.%u", fw >> 16, (fw >> 8) & 0xFF, fw & 0xFF);
+        text_cache_draw_glyphs(font, line, color, x, y);
+        y += lh;
+
+        char disc[40], conn[40], http[40];
+        format_percentiles(disc, sizeof(disc), &t->metric[TELEM_DISCOVERY_RTT]);
+        format_percentiles(conn, sizeof(conn), &t->metric[TELEM_CONNECT]);
+        format_percentiles(http, sizeof(http), &t->metric[TELEM_HTTP_RTT]);
+        format_percentiles(ack, sizeof(ack), &t->metric[TELEM_INPUT_ACK]);
+        snprintf(line, sizeof(line), "    disc %s  conn %s  http %s  ack %s", disc, conn, http, ack);
+        text_cache_draw_glyphs(font, line, grey, x, y);
+        y += lh + SCALEY(4);
+    }
+
+    int foot_y = overlayRect.y + overlayRect.h - lh - SCALEY(8);
+    if (diag_total > diag_count) {
+        char more[32];
+        snprintf(more, sizeof(more), "+%d more units", diag_total - diag_count);
+        text_cache_draw_glyphs(font, more, grey, x, foot_y);
+    }
+    text_cache_draw(font, "Press Y to close", grey, overlayRect.x + overlayRect.w / 2, foot_y, NULL);
+}
+
+void ui_set_diagnostics(const ui_diag_row_t* rows, int count, int total, const telemetry_report_t* all,
+                        const mem_report_t* mem, const audio_stats_t* audio) {
+    if (count > UI_DIAG_ROWS) count = UI_DIAG_ROWS;
+    diag_all = *all;
+    diag_mem = *mem;
+    diag_audio = *audio;
+    memcpy(diag_rows, rows, sizeof(rows[0]) * count);
+    diag_count = count;
+    diag_total = total;
+}
+
+void ui_set_profile(const profiler_summary_t* summary) {
+    profile = *summary;
+}
+
+// Per-frame averages and the worst single record, in ms, over the last
+// PROFILER_WINDOW drawn frames
+static void render_hud(void) {
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+    SDL_RenderFillRect(renderer, &hud_rect);
+
+    TTF_Font* font = assets.exit_font;
+    if (!font) return;
+    int lh = TTF_FontHeight(font) + 1;
+    int x = hud_rect.x + SCALEX(6);
+    int y = hud_rect.y + SCALEY(4);
+    SDL_Color white = {255,255,255,255};
+    SDL_Color grey  = {170,170,170,255};
+
+    char avg[12], max[12], line[64];
+    format_ms(avg, sizeof(avg), profile.frame_avg_us);
+    format_ms(max, sizeof(max), profile.frame_max_us);
+    snprintf(line, sizeof(line), "frame %s avg %s max (%u)", avg, max, (unsigned)profile.frames);
+    text_cache_draw_glyphs(font, line, white, x, y);
+    y += lh;
+
+    for (int s = 1; s < PROF_STAGE_COUNT; ++s) {
+        format_ms(avg, sizeof(avg), profile.stage_avg_us[s]);
+        format_ms(max, sizeof(max), profile.stage_max_us[s]);
+        snprintf(line, sizeof(line), "%-10s %6s %6s", profiler_stage_name((prof_stage_t)s), avg, max);
+        text_cache_draw_glyphs(font, line, grey, x, y);
+        y += lh;
+    }
+}
+
+// Menu entry whose effect the target unit already shows (Display On while on)
+static bool menu_active(const ui_state_t* st, int i) {
+    if (!menu_cmds[i] || st->dev_display == DEVSTATE_UNKNOWN) return false;
+    if (strcmp(menu_cmds[i], DEVSTATE_CMD_DISPLAY_ON) == 0) return st->dev_display == DEVSTATE_ON;
+    if (strcmp(menu_cmds[i], DEVSTATE_CMD_DISPLAY_OFF) == 0) return st->dev_display == DEVSTATE_OFF;
+    return false;
+}
+
+static void render_menu(const ui_state_t* st) {
+    TTF_Font* font = assets.exit_font ? assets.exit_font : assets.title_font;
+
+    // Draw menu buttons
+    for (int i = 0; i < MENU_ITEM_COUNT; i++) {
+        SDL_Rect rect = mrect[i];
+        SDL_Rect shadow = rect;
+        shadow.x += SCALEX(8);
+        shadow.y += SCALEY(8);
+
+        octagon_draw(shadow, SCALEY(12), btnShadow, NULL);
+        if (st->focus_row == 0 && i == st->menu_selected)
+            octagon_draw(rect, SCALEY(12), btnSelected, &btnBorder);
+        else
+            octagon_draw(rect, SCALEY(12), btnIdle, &btnBorder);
+
+        // PATCH: XL DETECTED in center menu block
+        if (i == XL_MENU_IDX && st->xl_found) {
+            int tw, th;
+            SDL_Texture* xlTex = text_cache_get(font, "XL DETECTED", (SDL_Color){220,30,180,255}, &tw, &th);
+            if (xlTex) {
+                SDL_Rect textRect = rect;
+                textRect.x += (rect.w - tw) / 2;
+                textRect.y += (rect.h - th) / 2;
+                textRect.w = tw;
+                textRect.h = th;
+                SDL_RenderCopy(renderer, xlTex, NULL, &textRect);
+            }
+            continue;
+        }
+
+        SDL_Color textColor = (st->focus_row == 0 && i == st->menu_selected)
+            ? (SDL_Color){0,0,0,255}
+            : (SDL_Color){255,255,255,255};
+
+        // Current state marker at the left edge
+        if (menu_active(st, i)) {
+            int d = SCALEY(8);
+            SDL_Rect dot = {rect.x + SCALEX(18), rect.y + (rect.h - d) / 2, d, d};
+            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+            SDL_SetRenderDrawColor(renderer, textColor.r, textColor.g, textColor.b, 255);
+            SDL_RenderFillRect(renderer, &dot);
+        }
+        int tw, th;
+        SDL_Texture* tx = text_cache_get(font, menu_items[i], textColor, &tw, &th);
+        if (!tx) continue;
+        SDL_Rect textRect = rect;
+        textRect.x += (rect.w - tw) / 2;
+        textRect.y += (rect.h - th) / 2;
+        textRect.w = tw;
+        textRect.h = th;
+        SDL_RenderCopy(renderer, tx, NULL, &textRect);
+    }
+}
+
+static void render_device_bar(const ui_state_t* st) {
+    TTF_Font* font = assets.exit_font;
+    if (!font) return;
+
+    int x0 = SCALEX(20);
+    int y0 = screen_height - SCALEY(70);
+    text_cache_draw(font, "Available Type D units:", (SDL_Color){200,200,200,255}, x0, y0, NULL);
+
+    int spacing = SCALEX(32);
+    int num_y = y0 + TTF_FontHeight(font) + 4;
+    for (int i = 0; i < DEVICE_BAR_SLOTS; ++i) {
+        SDL_Color color = {128,128,128,255};
+        SDL_Color border = {80,255,100,255};
+        const char* label = NULL;
+        if (i < DEVICE_MAX)
+            label = (const char*[]){"1","2","3","4"}[i];
+        else
+            label = "XL";
+        if (st->device_present[i]) {
+            if (i == st->selected_idx)
+                color = (SDL_Color){0,128,0,255};
+            else if (st->focus_row == 1 && i == st->highlight_idx)
+                color = (SDL_Color){0,255,128,255};
+            else
+                color = (SDL_Color){255,255,255,255};
+        }
+        int tw, th;
+        SDL_Texture* ntex = text_cache_get(font, label, color, &tw, &th);
+        if (ntex) {
+            SDL_Rect nrect = {x0 + i*spacing, num_y, tw, th};
+            if (st->focus_row == 1 && i == st->highlight_idx && st->device_present[i]) {
+                SDL_Rect box = nrect;
+                box.x -= 2; box.y -= 2; box.w += 4; box.h += 4;
+                SDL_SetRenderDrawColor(renderer, border.r, border.g, border.b, border.a);
+                SDL_RenderDrawRect(renderer, &box);
+            }
+            SDL_RenderCopy(renderer, ntex, NULL, &nrect);
+        }
+    }
+
+    int info_y = num_y + TTF_FontHeight(font) + 4;
+    if (st->selected_idx >= 0 && st->device_present[st->selected_idx]) {
+        char ipmsg[96];
+        int len;
+        if (st->selected_idx == 4) {
+            len = snprintf(ipmsg, sizeof(ipmsg), "Type D XL IP: %s", detect_ipstr(st->device_ip[4]));
+        } else {
+            len = snprintf(ipmsg, sizeof(ipmsg), "Type D IP: %s", detect_ipstr(st->device_ip[st->selected_idx]));
+        }
+        // What the panel shows, as far as the last status query knows
+        if (st->dev_image >= 0)
+            len += snprintf(ipmsg + len, sizeof(ipmsg) - len, "  img %d", st->dev_image);
+        if (st->dev_display != DEVSTATE_UNKNOWN)
+            len += snprintf(ipmsg + len, sizeof(ipmsg) - len, "  %s", st->dev_display == DEVSTATE_ON ? "on" : "off");
+        if (st->dev_mode >= 0)
+            snprintf(ipmsg + len, sizeof(ipmsg) - len, "  mode %d", st->dev_mode);
+        // Keyed by the full string, so a new IP is the only thing that re-rasterizes
+        text_cache_draw(font, ipmsg, (SDL_Color){200,200,200,255}, x0, info_y, NULL);
+    }
+
+    // Command feedback changes with every result, so draw it from the glyph atlas
+    if (st->status_kind != UI_STATUS_NONE) {
+        SDL_Color color = {255,220,0,255};
+        if (st->status_kind == UI_STATUS_OK)
+            color = (SDL_Color){0,255,80,255};
+        else if (st->status_kind == UI_STATUS_FAIL)
+            color = (SDL_Color){255,60,60,255};
+        text_cache_draw_glyphs(font, st->status, color, status_rect.x + 2, y0);
+    }
+}
+
+// True while drawing is clipped to somewhere inside r
+static bool clip_within(SDL_Rect r) {
+    if (!SDL_RenderIsClipEnabled(renderer)) return false;
+    SDL_Rect clip, both;
+    SDL_RenderGetClipRect(renderer, &clip);
+    return SDL_IntersectRect(&clip, &r, &both) && SDL_RectEquals(&clip, &both);
+}
+
+static void render_scene(const ui_state_t* st) {
+    // The overlay pages only show the background under their panel
+    bool main_page = !st->about_visible && !st->diag_visible;
+    bool layered = st->about_visible ? about_layer != NULL : diag_layer != NULL;
+    uint64_t t0 = profiler_begin();
+    if (main_page && chrome)
+        SDL_RenderCopy(renderer, chrome, NULL, NULL);
+    else if (main_page || !layered || !clip_within(overlay_bounds()))
+        draw_background();
+    profiler_end(PROF_BACKGROUND, t0);
+
+    if (st->about_visible) {
+        render_about();
+        return;
+    }
+    if (st->diag_visible) {
+        render_diagnostics();
+        return;
+    }
+
+    // Logo, title and exit prompt overlap none of the widgets
+    if (!chrome) draw_chrome();
+    render_menu(st);
+
+    t0 = profiler_begin();
+    render_device_bar(st);
+    profiler_end(PROF_DEVICE_BAR, t0);
+
+    // Draw EXP indicator if ID 6 is detected (unchanged)
+    if (st->exp_found && assets.exit_font) {
+        int tw, th;
+        SDL_Texture* expTex = text_cache_get(assets.exit_font, "EXP FOUND", (SDL_Color){0,255,80,255}, &tw, &th);
+        if (expTex) {
+            int margin = SCALEY(16);
+            SDL_Rect expRect;
+            expRect.w = tw;
+            expRect.h = th;
+            expRect.x = screen_width - expRect.w - margin;
+            expRect.y = margin;
+            SDL_RenderCopy(renderer, expTex, NULL, &expRect);
+        }
+    }
+}
+
+void ui_render(const ui_state_t* st) {
+    render_scene(st);
+    if (st->hud_visible) render_hud();
+}
+
+void ui_damage(const ui_state_t* prev, const ui_state_t* cur) {
+    if (!prev || prev->about_visible != cur->about_visible || prev->diag_visible != cur->diag_visible) {
+        damage_add_all();
+        return;
+    }
+    // Drawn last, so anything damaged below it repaints it too
+    if (prev->hud_visible != cur->hud_visible || (cur->hud_visible && prev->hud_serial != cur->hud_serial))
+        damage_add(hud_rect);
+
+    // The About overlay is static; nothing under it shows through
+    if (cur->about_visible) return;
+    if (cur->diag_visible) {
+        if (prev->diag_serial != cur->diag_serial)
+            damage_add(overlay_bounds());
+        return;
+    }
+
+    for (int i = 0; i < MENU_ITEM_COUNT; i++) {
+        bool was_sel = prev->focus_row == 0 && i == prev->menu_selected;
+        bool is_sel  = cur->focus_row == 0 && i == cur->menu_selected;
+        bool xl_changed = i == XL_MENU_IDX && prev->xl_found != cur->xl_found;
+        bool state_changed = menu_active(prev, i) != menu_active(cur, i);
+        if (was_sel != is_sel || xl_changed || state_changed)
+            damage_add(button_bounds(i));
+    }
+
+    if (prev->focus_row != cur->focus_row ||
+        prev->highlight_idx != cur->highlight_idx ||
+        prev->selected_idx != cur->selected_idx ||
+        memcmp(prev->device_present, cur->device_present, sizeof(cur->device_present)) != 0 ||
+        memcmp(prev->device_ip, cur->device_ip, sizeof(cur->device_ip)) != 0 ||
+        prev->dev_display != cur->dev_display || prev->dev_mode != cur->dev_mode ||
+        prev->dev_image != cur->dev_image)
+        damage_add(bar_rect);
+
+    if (prev->exp_found != cur->exp_found)
+        damage_add(exp_rect);
+
+    if (prev->status_kind != cur->status_kind || strcmp(prev->status, cur->status) != 0)
+        damage_add(status_rect);
+}
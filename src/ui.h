@@ -0,0 +1,132 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "telemetry.h"
+#include "profiler.h"
+#include "memstat.h"
+#include "audio_stream.h"
+
+#define SCREEN_WIDTH_DEF  640
+#define SCREEN_HEIGHT_DEF 480
+#define DEVICE_MAX        4           // Numbered units (1-4)
+#define DEVICE_BAR_SLOTS  5           // 4 normal + XL
+
+#define SCALEY(y) ((int)((float)(y) * screen_height / (float)SCREEN_HEIGHT_DEF))
+#define SCALEX(x) ((int)((float)(x) * screen_width / (float)SCREEN_WIDTH_DEF))
+
+#define MENU_ITEM_COUNT 9
+#define MENU_COLS 3
+#define MENU_ROWS ((MENU_ITEM_COUNT + MENU_COLS - 1) / MENU_COLS)
+#define XL_MENU_IDX 4                 // Center menu block (second row, second column)
+#define UI_STATUS_MAX 48
+#define UI_DIAG_ROWS  5               // Units listed on the diagnostics page, under the memory lines
+
+enum {
+    UI_STATUS_NONE = 0,
+    UI_STATUS_PENDING,
+    UI_STATUS_OK,
+    UI_STATUS_FAIL
+};
+
+// Everything the screen depends on; two of these are diffed to find damage
+typedef struct {
+    int      menu_selected;
+    int      focus_row;               // 0 = menu, 1 = device bar
+    int      highlight_idx;           // device highlight index
+    int      selected_idx;            // selected device
+    bool     about_visible;
+    bool     diag_visible;            // Diagnostics page (Y button)
+    uint32_t diag_serial;             // Bumped by ui_set_diagnostics() so the page is redrawn
+    bool     hud_visible;             // Frame profiler overlay (START button)
+    uint32_t hud_serial;              // Bumped after ui_set_profile() so the HUD is redrawn
+    int      device_present[DEVICE_BAR_SLOTS];
+    uint32_t device_ip[DEVICE_BAR_SLOTS];
+    int8_t   dev_display;             // Target unit's panel per devstate: DEVSTATE_ON/OFF/UNKNOWN
+    int8_t   dev_mode;                // -1 if unknown
+    int16_t  dev_image;               // -1 if unknown
+    bool     xl_found;
+    bool     exp_found;
+    int      status_kind;             // UI_STATUS_*, command feedback line
+    char     status[UI_STATUS_MAX];
+} ui_state_t;
+
+// One unit on the diagnostics page
+typedef struct {
+    uint8_t            id;
+    uint32_t           firmware;      // As in detect_reply_t, 0 if the unit did not say
+    telemetry_report_t t;
+} ui_diag_row_t;
+
+// Startup resources owned by main()
+typedef struct {
+    TTF_Font*    title_font;
+    TTF_Font*    exit_font;
+    SDL_Texture* bg;
+    SDL_Texture* td;
+    SDL_Texture* title;
+    SDL_Rect     title_rect;
+    SDL_Texture* exit_left;
+    SDL_Texture* exit_b;
+    SDL_Texture* exit_right;
+    SDL_Rect     exit_left_rect, exit_b_rect, exit_right_rect;
+    Uint32       screen_format;       // Render target format, for the cached chrome layer
+} ui_assets_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int screen_width, screen_height;
+extern const char* menu_items[MENU_ITEM_COUNT];
+extern const char* menu_cmds[MENU_ITEM_COUNT];
+
+/**
+ * Lays out the menu for the current screen size, pre-renders button sprites
+ * and flattens the static chrome into one screen-sized layer and the About
+ * and diagnostics panels into one layer each. Call again after a video mode
+ * change.
+ */
+void ui_init(SDL_Renderer* r, const ui_assets_t* assets);
+
+/**
+ * Frees the cached layers. The assets themselves stay with the caller.
+ */
+void ui_shutdown(void);
+
+/**
+ * Draws the full scene. Callers limit the work with SDL_RenderSetClipRect.
+ */
+void ui_render(const ui_state_t* st);
+
+/**
+ * Marks the screen regions that differ between two states as damaged.
+ *
+ * @param prev State last drawn, or NULL to damage everything
+ * @param cur  State about to be drawn
+ */
+void ui_damage(const ui_state_t* prev, const ui_state_t* cur);
+
+/**
+ * Replaces the rows shown on the diagnostics page. The caller bumps
+ * ui_state_t.diag_serial afterwards so the page is marked damaged.
+ *
+ * @param rows  Units to list, worst first (at most UI_DIAG_ROWS are kept)
+ * @param total Units known in all, for the "+N more" line
+ * @param all   Every unit merged, for the input latency line
+ * @param mem   Memory counters for the memory lines
+ * @param audio Music stream counters for the music line
+ */
+void ui_set_diagnostics(const ui_diag_row_t* rows, int count, int total, const telemetry_report_t* all,
+                        const mem_report_t* mem, const audio_stats_t* audio);
+
+/**
+ * Replaces the numbers shown on the profiler HUD. The caller bumps
+ * ui_state_t.hud_serial afterwards.
+ */
+void ui_set_profile(const profiler_summary_t* summary);
+
+#ifdef __cplusplus
+}
+#endif
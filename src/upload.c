@@ -0,0 +1,252 @@
+#include "upload.h"
+#include "send_cmd.h"
+#include "memstat.h"
+#include <stdio.h>
+#include <string.h>
+#include <hal/debug.h>
+
+#define UPLOAD_HEAD_MAX   (160 + UPLOAD_PATH_MAX * 2)
+
+typedef struct {
+    char     path[UPLOAD_PATH_MAX];
+    char     name_hex[UPLOAD_PATH_MAX * 2 + 1];   // Base name, as sent in file=
+    uint32_t size;
+} upload_file_t;
+
+typedef enum {
+    STREAM_DONE,
+    STREAM_DROPPED,                   // Connection lost or timed out; worth a reconnect
+    STREAM_REJECTED,                  // Unit answered with an error status
+    STREAM_READ_ERROR
+} stream_result_t;
+
+static upload_file_t files[UPLOAD_FILES_MAX];
+static int file_count = 0;
+static uint64_t bytes_total = 0;
+
+static upload_unit_t units[UPLOAD_UNITS_MAX];
+static SDL_Thread* threads[UPLOAD_PARALLEL];
+static int unit_count = 0;
+static SDL_SpinLock lock = 0;         // Guards units[] and the timing below
+static SDL_atomic_t next_unit;        // Next unit a free thread takes
+static SDL_atomic_t finished;         // Units no longer running
+static SDL_atomic_t cancel;
+static Uint32 start_ticks = 0;
+static Uint32 end_ticks = 0;
+static Uint32 event_type = (Uint32)-1;
+
+static void set_state(int u, upload_state_t state) {
+    SDL_AtomicLock(&lock);
+    units[u].state = state;
+    SDL_AtomicUnlock(&lock);
+}
+
+static void add_acked(int u, uint32_t bytes) {
+    SDL_AtomicLock(&lock);
+    units[u].bytes_acked += bytes;
+    SDL_AtomicUnlock(&lock);
+}
+
+// Sends the file from *acked onwards, keeping up to UPLOAD_WINDOW chunks in
+// flight; *acked advances as responses come back
+static stream_result_t stream_file(send_cmd_conn_t* c, int u, const char* host, FILE* fp,
+                                   const upload_file_t* f, char* buf, uint32_t* acked) {
+    uint32_t ends[UPLOAD_WINDOW];     // End offset of each chunk in flight, oldest first
+    int head = 0, inflight = 0;
+    uint32_t next = *acked;
+    if (fseek(fp, (long)next, SEEK_SET) != 0) return STREAM_READ_ERROR;
+
+    while (*acked < f->size) {
+        while (inflight < UPLOAD_WINDOW && next < f->size && !SDL_AtomicGet(&cancel)) {
+            uint32_t len = SDL_min(f->size - next, (uint32_t)UPLOAD_CHUNK);
+            int hl = snprintf(buf, UPLOAD_HEAD_MAX,
+                "POST /upload?file=%s&off=%u&len=%u HTTP/1.1\r\n"
+                "Host: %s\r\n"
+                "Content-Length: %u\r\n"
+                "Connection: keep-alive\r\n"
+                "\r\n",
+                f->name_hex, (unsigned)next, (unsigned)f->size, host, (unsigned)len);
+            if (hl <= 0 || hl >= UPLOAD_HEAD_MAX) return STREAM_REJECTED;
+            if (fread(buf + hl, 1, len, fp) != len) return STREAM_READ_ERROR;
+            if (!send_cmd_conn_send(c, buf, hl + (int)len, UPLOAD_TIMEOUT_MS)) return STREAM_DROPPED;
+            ends[(head + inflight) % UPLOAD_WINDOW] = next + len;
+            inflight++;
+            next += len;
+        }
+        if (inflight == 0) return STREAM_DROPPED;   // Cancelled before anything was sent
+
+        int status = send_cmd_conn_response(c, UPLOAD_TIMEOUT_MS);
+        if (status < 0) return STREAM_DROPPED;
+        if (status < 200 || status >= 300) {
+            debugPrint("[upload] %s answered %d at offset %u\n", host, status, (unsigned)*acked);
+            return STREAM_REJECTED;
+        }
+        add_acked(u, ends[head] - *acked);
+        *acked = ends[head];
+        head = (head + 1) % UPLOAD_WINDOW;
+        inflight--;
+    }
+    return STREAM_DONE;
+}
+
+// One file to one unit, reconnecting as long as each attempt gets further
+static bool send_file(int u, const char* host, const upload_file_t* f, char* buf) {
+    FILE* fp = fopen(f->path, "rb");
+    if (!fp) {
+        debugPrint("[upload] Cannot open %s\n", f->path);
+        return false;
+    }
+    uint32_t acked = 0;
+    int misses = 0;
+    stream_result_t res = STREAM_DROPPED;
+    while (!SDL_AtomicGet(&cancel)) {
+        uint32_t before = acked;
+        send_cmd_conn_t* c = send_cmd_conn_acquire(units[u].ip, UPLOAD_TIMEOUT_MS);
+        if (c) {
+            res = stream_file(c, u, host, fp, f, buf, &acked);
+            send_cmd_conn_release(c, res == STREAM_DONE);
+            if (res != STREAM_DROPPED) break;
+        }
+        if (acked != before) misses = 0;
+        if (++misses > UPLOAD_RETRIES) break;
+        SDL_AtomicLock(&lock);
+        units[u].reconnects++;
+        SDL_AtomicUnlock(&lock);
+        SDL_Delay(UPLOAD_RETRY_MS);
+    }
+    fclose(fp);
+    return res == STREAM_DONE;
+}
+
+// The last unit to finish stops the clock and wakes the main loop
+static void unit_finished(void) {
+    if (SDL_AtomicAdd(&finished, 1) + 1 != unit_count) return;
+    SDL_AtomicLock(&lock);
+    end_ticks = SDL_GetTicks();
+    SDL_AtomicUnlock(&lock);
+    if (event_type != (Uint32)-1) {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = event_type;
+        SDL_PushEvent(&e);
+    }
+}
+
+// Every file to unit u, over buf; NULL buf fails the unit
+static void send_unit(int u, char* buf) {
+    char host[16];
+    uint32_t ip = units[u].ip;
+    snprintf(host, sizeof(host), "%u.%u.%u.%u",
+             (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+
+    upload_state_t state = buf ? UPLOAD_DONE : UPLOAD_FAILED;
+    for (int f = 0; f < file_count && state == UPLOAD_DONE; ++f) {
+        if (send_file(u, host, &files[f], buf)) {
+            SDL_AtomicLock(&lock);
+            units[u].files_done++;
+            SDL_AtomicUnlock(&lock);
+        } else {
+            state = SDL_AtomicGet(&cancel) ? UPLOAD_CANCELLED : UPLOAD_FAILED;
+        }
+    }
+    set_state(u, state);
+    unit_finished();
+}
+
+// Takes units until none is left; units taken after a cancel end cancelled
+static int worker_func(void* data) {
+    char* buf = (char*)mem_alloc(MEM_NET, UPLOAD_HEAD_MAX + UPLOAD_CHUNK);
+    int u;
+    while ((u = SDL_AtomicAdd(&next_unit, 1)) < unit_count)
+        send_unit(u, buf);
+    mem_free(buf);
+    return 0;
+}
+
+static void join_threads(void) {
+    for (int i = 0; i < UPLOAD_PARALLEL; ++i) {
+        if (threads[i]) SDL_WaitThread(threads[i], NULL);
+        threads[i] = NULL;
+    }
+}
+
+static const char* base_name(const char* path) {
+    const char* name = path;
+    for (const char* p = path; *p; ++p) {
+        if (*p == '\\' || *p == '/' || *p == ':') name = p + 1;
+    }
+    return name;
+}
+
+bool upload_start(const uint32_t* ips, int count, const char* const* paths, int count_files) {
+    if (unit_count && SDL_AtomicGet(&finished) < unit_count) return false;
+    join_threads();
+    if (event_type == (Uint32)-1) event_type = SDL_RegisterEvents(1);
+
+    // Sizes up front: every chunk carries the total, and progress needs it
+    file_count = 0;
+    bytes_total = 0;
+    for (int i = 0; i < count_files && file_count < UPLOAD_FILES_MAX; ++i) {
+        upload_file_t* f = &files[file_count];
+        if (strlen(paths[i]) >= sizeof(f->path)) continue;
+        FILE* fp = fopen(paths[i], "rb");
+        if (!fp) continue;
+        long size = (fseek(fp, 0, SEEK_END) == 0) ? ftell(fp) : -1;
+        fclose(fp);
+        if (size <= 0) continue;
+        strcpy(f->path, paths[i]);
+        ascii_to_hex(base_name(paths[i]), f->name_hex, sizeof(f->name_hex));
+        f->size = (uint32_t)size;
+        bytes_total += f->size;
+        file_count++;
+    }
+    if (file_count == 0 || count <= 0) return false;
+
+    unit_count = SDL_min(count, UPLOAD_UNITS_MAX);
+    memset(units, 0, sizeof(units));
+    SDL_AtomicSet(&next_unit, 0);
+    SDL_AtomicSet(&finished, 0);
+    SDL_AtomicSet(&cancel, 0);
+    start_ticks = SDL_GetTicks();
+    end_ticks = 0;
+    for (int i = 0; i < unit_count; ++i) {
+        units[i].ip = ips[i];
+        units[i].state = UPLOAD_RUNNING;
+    }
+    int started = 0;
+    for (int i = 0; i < SDL_min(unit_count, UPLOAD_PARALLEL); ++i) {
+        threads[i] = SDL_CreateThread(worker_func, "upload", NULL);
+        if (threads[i]) started++;
+    }
+    if (!started) {
+        // Nobody to take the units: fail them here so the event still comes
+        debugPrint("[upload] Thread creation failed\n");
+        int u;
+        while ((u = SDL_AtomicAdd(&next_unit, 1)) < unit_count) {
+            set_state(u, UPLOAD_FAILED);
+            unit_finished();
+        }
+    }
+    return true;
+}
+
+void upload_status(upload_status_t* out) {
+    memset(out, 0, sizeof(*out));
+    SDL_AtomicLock(&lock);
+    out->unit_count = unit_count;
+    out->file_count = file_count;
+    out->bytes_total = bytes_total;
+    memcpy(out->units, units, sizeof(units));
+    out->active = unit_count > 0 && !end_ticks;
+    if (unit_count) out->elapsed_ms = (end_ticks ? end_ticks : SDL_GetTicks()) - start_ticks;
+    SDL_AtomicUnlock(&lock);
+}
+
+Uint32 upload_event_type(void) {
+    return event_type;
+}
+
+void upload_cancel(bool wait) {
+    SDL_AtomicSet(&cancel, 1);
+    if (wait) join_threads();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL.h>
+
+#define UPLOAD_CHUNK          16384   // Request body size; also the only file buffer per unit
+#define UPLOAD_WINDOW         4       // Chunks written ahead of their responses
+#define UPLOAD_PARALLEL       4       // Units receiving at once, one thread each
+#define UPLOAD_UNITS_MAX      16      // Units in one upload; the rest wait for a free thread
+#define UPLOAD_FILES_MAX      64
+#define UPLOAD_PATH_MAX       128
+#define UPLOAD_RETRIES        5       // Reconnects in a row without progress before a unit gives up
+#define UPLOAD_TIMEOUT_MS     5000    // Connect, write or wait for one chunk's response
+#define UPLOAD_RETRY_MS       500     // Pause before reconnecting
+
+// Wire format: one request per chunk on a keep-alive connection to port 8080
+//
+//   POST /upload?file=<file name as hex>&off=<offset>&len=<file size> HTTP/1.1
+//   Content-Length: <chunk size>
+//
+// The unit stores the bytes at off and answers 2xx. Chunks carry their
+// offset, so resending one is harmless: after a dropped connection the
+// sender resumes from the last acknowledged chunk.
+
+typedef enum {
+    UPLOAD_IDLE = 0,
+    UPLOAD_RUNNING,                   // Receiving, or waiting for a free thread
+    UPLOAD_DONE,
+    UPLOAD_FAILED,                    // Unit unreachable, rejected a chunk, or a file could not be read
+    UPLOAD_CANCELLED
+} upload_state_t;
+
+typedef struct {
+    uint32_t       ip;                // Host order, as in type_d_unit_t
+    upload_state_t state;
+    int            files_done;
+    uint64_t       bytes_acked;       // Over all files
+    uint32_t       reconnects;
+} upload_unit_t;
+
+typedef struct {
+    bool          active;             // Started and not every unit has finished
+    int           unit_count;
+    int           file_count;
+    uint64_t      bytes_total;        // Per unit
+    uint32_t      elapsed_ms;         // Since start, frozen when the last unit finishes
+    upload_unit_t units[UPLOAD_UNITS_MAX];
+} upload_status_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts pushing files to units in the background, all files to every unit,
+ * one connection per unit. UPLOAD_PARALLEL threads take the units in turn,
+ * so the rest start as earlier ones finish. Files are streamed a chunk at a
+ * time, never loaded whole. Empty files are skipped.
+ *
+ * @param ips   Units (host order); at most UPLOAD_UNITS_MAX are used
+ * @param paths Files to send; the unit gets each under its base name
+ * @return      false if an upload is still running or no file could be opened
+ */
+bool upload_start(const uint32_t* ips, int count, const char* const* paths, int file_count);
+
+/**
+ * Copies the progress of the current or last upload.
+ */
+void upload_status(upload_status_t* out);
+
+/**
+ * @return SDL event type posted once when every unit has finished
+ */
+Uint32 upload_event_type(void);
+
+/**
+ * Stops every transfer after its current chunk. The completion event still
+ * follows, with the units marked UPLOAD_CANCELLED.
+ *
+ * @param wait Also wait for the threads, e.g. before shutdown
+ */
+void upload_cancel(bool wait);
+
+#ifdef __cplusplus
+}
+#endif
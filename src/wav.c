@@ -0,0 +1,292 @@
+#include "wav.h"
+#include <string.h>
+#include <hal/debug.h>
+
+#define WAV_FMT_MAX 40                // Longest fmt chunk read (WAVE_FORMAT_EXTENSIBLE size)
+
+static const int16_t ima_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t ima_index_step[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static uint16_t rd16(const uint8_t* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t* p) {
+    return rd16(p) | (uint32_t)rd16(p + 2) << 16;
+}
+
+static bool reject(const char* why) {
+    debugPrint("[wav] %s\n", why);
+    return false;
+}
+
+int wav_ima_block_frames(int block_align, int channels) {
+    int head = 4 * channels;
+    return block_align < head ? 0 : 1 + (block_align - head) / head * 8;
+}
+
+static bool check_format(wav_info_t* w) {
+    if (w->channels != 1 && w->channels != 2)
+        return reject("Only mono and stereo are supported");
+    if (w->rate < WAV_RATE_MIN || w->rate > WAV_RATE_MAX)
+        return reject("Sample rate out of range");
+    if (w->format == WAV_FORMAT_PCM) {
+        if (w->bits != 8 && w->bits != 16)
+            return reject("PCM must be 8 or 16 bit");
+        if (w->block_align != w->channels * w->bits / 8)
+            return reject("PCM block size does not match the format");
+        w->block_frames = 1;
+        w->data_bytes -= w->data_bytes % w->block_align;
+        return true;
+    }
+    if (w->format == WAV_FORMAT_IMA_ADPCM) {
+        int head = 4 * w->channels;
+        if (w->bits != 4 || w->block_align <= head || w->block_align > WAV_BLOCK_MAX || w->block_align % head)
+            return reject("Unsupported IMA ADPCM block layout");
+        int frames = wav_ima_block_frames(w->block_align, w->channels);
+        if (w->block_frames && w->block_frames != frames)
+            return reject("IMA ADPCM samples per block do not match the block size");
+        w->block_frames = (uint16_t)frames;
+        return true;
+    }
+    return reject("Only PCM and IMA ADPCM can be played");
+}
+
+bool wav_parse(FILE* f, wav_info_t* out) {
+    memset(out, 0, sizeof(*out));
+    uint8_t head[12];
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) ||
+        memcmp(head, "RIFF", 4) != 0 || memcmp(head + 8, "WAVE", 4) != 0)
+        return reject("Not a RIFF WAVE file");
+
+    bool have_fmt = false, have_data = false;
+    uint32_t pos = sizeof(head);
+    uint8_t ck[8];
+    while (!have_data && fread(ck, 1, sizeof(ck), f) == sizeof(ck)) {
+        uint32_t size = rd32(ck + 4);
+        pos += sizeof(ck);
+        if (memcmp(ck, "fmt ", 4) == 0) {
+            uint8_t fmt[WAV_FMT_MAX];
+            uint32_t want = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || fread(fmt, 1, want, f) != want)
+                return reject("Short fmt chunk");
+            out->format = rd16(fmt);
+            out->channels = rd16(fmt + 2);
+            out->rate = rd32(fmt + 4);
+            out->block_align = rd16(fmt + 12);
+            out->bits = rd16(fmt + 14);
+            if (out->format == WAV_FORMAT_IMA_ADPCM && want >= 20)
+                out->block_frames = rd16(fmt + 18);   // After cbSize
+            have_fmt = true;
+        } else if (memcmp(ck, "fact", 4) == 0 && size >= 4) {
+            uint8_t n[4];
+            if (fread(n, 1, sizeof(n), f) != sizeof(n))
+                return reject("Short fact chunk");
+            out->frames = rd32(n);
+        } else if (memcmp(ck, "data", 4) == 0) {
+            if (!have_fmt)
+                return reject("data chunk before fmt");
+            out->data_offset = pos;
+            out->data_bytes = size;   // Checked against the file as it is read
+            have_data = true;
+            break;
+        }
+        // Chunks are padded to an even size
+        pos += size + (size & 1);
+        if (pos < size || fseek(f, (long)pos, SEEK_SET) != 0)
+            return reject("Truncated chunk");
+    }
+    if (!have_data)
+        return reject("No data chunk");
+    // PCM needs no fact chunk
+    if (out->format == WAV_FORMAT_PCM)
+        out->frames = 0;
+    if (!check_format(out))
+        return false;
+    // ADPCM's is often stale after editing, so it only trims the padding of
+    // the last block; a count that ends anywhere else is ignored
+    if (out->frames) {
+        uint32_t blocks = out->data_bytes / out->block_align + (out->data_bytes % out->block_align ? 1 : 0);
+        uint64_t last = (uint64_t)(blocks ? blocks - 1 : 0) * out->block_frames;
+        if (out->frames < last || out->frames > last + out->block_frames)
+            out->frames = 0;
+    }
+    return fseek(f, (long)out->data_offset, SEEK_SET) == 0 || reject("Cannot seek to the data");
+}
+
+int wav_ima_step_size(const wav_ima_state_t* s) {
+    return ima_steps[s->index];
+}
+
+int16_t wav_ima_expand(wav_ima_state_t* s, int nibble) {
+    int step = ima_steps[s->index];
+    int diff = step >> 3;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 4) diff += step;
+    int p = s->predictor + ((nibble & 8) ? -diff : diff);
+    if (p < -32768) p = -32768;
+    else if (p > 32767) p = 32767;
+    s->predictor = p;
+    int i = s->index + ima_index_step[nibble & 15];
+    s->index = i < 0 ? 0 : (i > 88 ? 88 : i);
+    return (int16_t)p;
+}
+
+// A block starts with each channel's first sample and step index, then
+// alternates 4 bytes (8 samples, low nibble first) per channel
+int wav_ima_decode_block(const uint8_t* in, int bytes, int channels, int16_t* out) {
+    int head = 4 * channels;
+    if (bytes < head) return 0;
+    int groups = (bytes - head) / head;
+    wav_ima_state_t st[2];
+    for (int c = 0; c < channels; ++c) {
+        st[c].predictor = (int16_t)rd16(in + 4 * c);
+        st[c].index = in[4 * c + 2] > 88 ? 88 : in[4 * c + 2];
+        out[c] = (int16_t)st[c].predictor;
+    }
+    const uint8_t* p = in + head;
+    for (int g = 0; g < groups; ++g) {
+        for (int c = 0; c < channels; ++c) {
+            int16_t* o = out + (1 + g * 8) * channels + c;
+            for (int k = 0; k < 4; ++k) {
+                uint8_t b = *p++;
+                o[(2 * k) * channels] = wav_ima_expand(&st[c], b & 15);
+                o[(2 * k + 1) * channels] = wav_ima_expand(&st[c], b >> 4);
+            }
+        }
+    }
+    return 1 + groups * 8;
+}
+
+static void rewind_data(wav_decoder_t* d) {
+    fseek(d->f, (long)d->info.data_offset, SEEK_SET);
+    d->left = d->info.data_bytes;
+    d->frames_left = d->info.frames ? d->info.frames : UINT32_MAX;
+    d->in_len = d->in_pos = 0;
+    d->src_len = d->src_pos = 0;
+}
+
+void wav_decoder_init(wav_decoder_t* d, FILE* f, const wav_info_t* info) {
+    d->f = f;
+    d->info = *info;
+    d->bytes_read = 0;
+    d->step = (uint32_t)(((uint64_t)info->rate << 16) / WAV_OUT_RATE);
+    // Two source frames are loaded before the first output frame
+    d->frac = 2u << 16;
+    memset(d->prev, 0, sizeof(d->prev));
+    memset(d->cur, 0, sizeof(d->cur));
+    rewind_data(d);
+}
+
+// Tops up the read buffer if fewer than need bytes are left in it. A file
+// shorter than its data chunk ends the pass where the file ends.
+static void fill_input(wav_decoder_t* d, int need) {
+    int have = d->in_len - d->in_pos;
+    if (have >= need || d->left == 0) return;
+    memmove(d->in, d->in + d->in_pos, have);
+    d->in_len = have;
+    d->in_pos = 0;
+    uint32_t want = sizeof(d->in) - have;
+    if (want > d->left) want = d->left;
+    size_t got = fread(d->in + have, 1, want, d->f);
+    d->in_len += (int)got;
+    d->left = got < want ? 0 : d->left - (uint32_t)got;
+    d->bytes_read += (uint32_t)got;
+}
+
+// Mono decodes into the front of src; spread it over both channels from the
+// back so nothing is overwritten before it is read
+static void mono_to_stereo(int16_t* s, int frames) {
+    for (int i = frames - 1; i >= 0; --i)
+        s[2 * i] = s[2 * i + 1] = s[i];
+}
+
+// Refills src with the next block (ADPCM) or read buffer's worth (PCM)
+static bool decode_next(wav_decoder_t* d) {
+    const wav_info_t* w = &d->info;
+    int unit = w->format == WAV_FORMAT_IMA_ADPCM ? w->block_align : WAV_SRC_FRAMES * w->block_align;
+    if (unit > WAV_READ_BYTES) unit = WAV_READ_BYTES - WAV_READ_BYTES % w->block_align;
+    fill_input(d, unit);
+    int have = d->in_len - d->in_pos;
+    if (have > unit) have = unit;
+    const uint8_t* p = d->in + d->in_pos;
+
+    int frames;
+    if (w->format == WAV_FORMAT_IMA_ADPCM) {
+        frames = wav_ima_decode_block(p, have, w->channels, d->src);
+        d->in_pos += have;
+    } else {
+        frames = have / w->block_align;
+        int count = frames * w->channels;
+        if (w->bits == 8) {
+            for (int i = 0; i < count; ++i)
+                d->src[i] = (int16_t)((p[i] ^ 0x80) << 8);
+        } else {
+            for (int i = 0; i < count; ++i)
+                d->src[i] = (int16_t)rd16(p + 2 * i);
+        }
+        d->in_pos += frames * w->block_align;
+    }
+    // The last ADPCM block is padded; the fact chunk says where the sound ends
+    if ((uint32_t)frames > d->frames_left) frames = (int)d->frames_left;
+    d->frames_left -= (uint32_t)frames;
+    if (w->channels == 1) mono_to_stereo(d->src, frames);
+    d->src_len = frames;
+    d->src_pos = 0;
+    return frames > 0;
+}
+
+static bool next_source(wav_decoder_t* d, bool loop) {
+    if (d->src_pos < d->src_len) return true;
+    if (decode_next(d)) return true;
+    if (!loop) return false;
+    rewind_data(d);
+    return decode_next(d);
+}
+
+int wav_decode(wav_decoder_t* d, int16_t* out, int frames, bool loop) {
+    int n = 0;
+    if (d->step == 1u << 16) {
+        while (n < frames && next_source(d, loop)) {
+            int take = d->src_len - d->src_pos;
+            if (take > frames - n) take = frames - n;
+            memcpy(out + 2 * n, d->src + 2 * d->src_pos, (size_t)take * WAV_OUT_FRAME_BYTES);
+            d->src_pos += take;
+            n += take;
+        }
+        return n;
+    }
+
+    // Linear interpolation between the two source frames around each output
+    // frame, with the weight in Q15 so the products stay in 32 bits
+    while (n < frames) {
+        while (d->frac >= 1u << 16) {
+            if (!next_source(d, loop)) return n;
+            d->prev[0] = d->cur[0];
+            d->prev[1] = d->cur[1];
+            d->cur[0] = d->src[2 * d->src_pos];
+            d->cur[1] = d->src[2 * d->src_pos + 1];
+            d->src_pos++;
+            d->frac -= 1u << 16;
+        }
+        int32_t t = (int32_t)(d->frac >> 1);
+        out[2 * n] = (int16_t)(d->prev[0] + (((d->cur[0] - d->prev[0]) * t) >> 15));
+        out[2 * n + 1] = (int16_t)(d->prev[1] + (((d->cur[1] - d->prev[1]) * t) >> 15));
+        d->frac += d->step;
+        n++;
+    }
+    return n;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define WAV_FORMAT_PCM        0x0001
+#define WAV_FORMAT_IMA_ADPCM  0x0011
+#define WAV_OUT_RATE          44100         // Decoder output: stereo S16 at this rate
+#define WAV_OUT_FRAME_BYTES   4
+#define WAV_BLOCK_MAX         2048          // Largest ADPCM block accepted, bytes
+#define WAV_READ_BYTES        (16 * 1024)   // File bytes per read
+#define WAV_SRC_FRAMES        4096          // Decoded frames held for the resampler; fits the largest block
+#define WAV_RATE_MIN          8000
+#define WAV_RATE_MAX          96000
+
+// What the RIFF chunks say about a file
+typedef struct {
+    uint16_t format;                  // WAV_FORMAT_*
+    uint16_t channels;                // 1 or 2
+    uint32_t rate;
+    uint16_t bits;                    // 8 or 16 for PCM, 4 for IMA ADPCM
+    uint16_t block_align;             // Bytes per PCM frame or per ADPCM block
+    uint16_t block_frames;            // Frames per ADPCM block, 1 for PCM
+    uint32_t frames;                  // From the fact chunk, 0 if there was none or it did not fit the data
+    uint32_t data_offset;             // Of the data chunk's payload, from the start of the file
+    uint32_t data_bytes;
+} wav_info_t;
+
+// One IMA ADPCM channel between nibbles
+typedef struct {
+    int predictor;
+    int index;                        // Into the step table, 0-88
+} wav_ima_state_t;
+
+// Streams a file as stereo S16 at WAV_OUT_RATE. Large (about 32 KB), so keep
+// it static.
+typedef struct {
+    FILE*      f;
+    wav_info_t info;
+    uint32_t   left;                  // Data chunk bytes not read yet this pass
+    uint32_t   frames_left;           // Frames still to play this pass
+    uint32_t   bytes_read;            // From the file since wav_decoder_init()
+    uint32_t   step;                  // Source frames per output frame, Q16
+    uint32_t   frac;                  // Position between prev and cur, Q16
+    int16_t    prev[2], cur[2];
+    int        in_len, in_pos;
+    int        src_len, src_pos;      // In frames
+    uint8_t    in[WAV_READ_BYTES];
+    int16_t    src[WAV_SRC_FRAMES * 2];
+} wav_decoder_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Walks the RIFF chunks of a WAVE file, skipping any it does not need (LIST,
+ * cue, padding), and checks that the format can be decoded. Leaves f at the
+ * start of the sample data.
+ *
+ * @return false, with the reason logged, for anything but PCM (8 or 16 bit)
+ *         and IMA ADPCM, mono or stereo, WAV_RATE_MIN to WAV_RATE_MAX
+ */
+bool wav_parse(FILE* f, wav_info_t* out);
+
+/**
+ * Starts decoding at the first sample. f stays open and owned by the caller.
+ */
+void wav_decoder_init(wav_decoder_t* d, FILE* f, const wav_info_t* info);
+
+/**
+ * Decodes, converts to stereo and resamples to WAV_OUT_RATE. Sources already
+ * at that rate are copied without interpolation.
+ *
+ * @param out    Interleaved left/right samples
+ * @param frames Stereo frames wanted
+ * @param loop   Start over at the end of the data instead of stopping
+ * @return       Frames written; fewer than asked only at the end of the data
+ *               without loop, or when the file cannot be read
+ */
+int wav_decode(wav_decoder_t* d, int16_t* out, int frames, bool loop);
+
+/**
+ * @return Frames in a full IMA ADPCM block of block_align bytes
+ */
+int wav_ima_block_frames(int block_align, int channels);
+
+/**
+ * Decodes one IMA ADPCM block, or the leading part of one.
+ *
+ * @param out Interleaved samples, room for wav_ima_block_frames() frames
+ * @return    Frames decoded
+ */
+int wav_ima_decode_block(const uint8_t* in, int bytes, int channels, int16_t* out);
+
+/**
+ * One decoder step, for encoders that must track the decoder exactly.
+ *
+ * @return The next sample
+ */
+int16_t wav_ima_expand(wav_ima_state_t* s, int nibble);
+
+/**
+ * @return Quantizer step for the state's current index
+ */
+int wav_ima_step_size(const wav_ima_state_t* s);
+
+#ifdef __cplusplus
+}
+#endif